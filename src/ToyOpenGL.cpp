@@ -3,19 +3,90 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "utils/bvh.hpp"
 #include "utils/camera.hpp"
+#include "utils/frame_constants.hpp"
+#include "utils/frustum.hpp"
+#include "utils/gl_state.hpp"
+#include "utils/gltf.hpp"
+#include "utils/gltf_model.hpp"
+#include "utils/gpu_culling.hpp"
+#include "utils/lod_selector.hpp"
+#include "utils/material_textures.hpp"
+#include "utils/mesh.hpp"
+#include "utils/mesh_optimizer.hpp"
+#include "utils/mesh_simplifier.hpp"
+#include "utils/occlusion_culler.hpp"
+#include "utils/picking.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/texture_atlas.hpp"
+#include "utils/texture_loader.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/transform_hierarchy.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+// vertex buffer binding of the per-instance model matrix (attribute locations 3 to 6)
+static const GLuint INSTANCE_BUFFER_BINDING = 3;
+
+// RGBA disc of size texels with a color picked from seed, small images to fill the atlas with.
+static std::vector<uint8_t> createAtlasIcon(int size, uint32_t seed)
+{
+    const glm::vec3 color = glm::vec3((seed * 97u) % 256u, (seed * 57u) % 256u,
+                                      (seed * 151u) % 256u);
+    std::vector<uint8_t> pixels(size_t(size) * size * 4);
+    const float radius = .5f * size;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const float distance = glm::length(glm::vec2(x + .5f, y + .5f) - glm::vec2(radius));
+            uint8_t *texel = pixels.data() + (size_t(y) * size + x) * 4;
+            texel[0] = uint8_t(color.r);
+            texel[1] = uint8_t(color.g);
+            texel[2] = uint8_t(color.b);
+            texel[3] = uint8_t(255.f * glm::clamp(radius - distance, 0.f, 1.f));
+        }
+    }
+    return pixels;
+}
+
+// The C++ mirror is checked against std140 at compile time, this catches a shader
+// declaring a different block. The reported size may or may not include the std140 tail
+// padding, only a larger block than the mirror is an error.
+static void checkFrameConstantsBlock(const GLProgram &program)
+{
+    for (const auto &block : program.getUniformBlocks())
+    {
+        if (block.name == "FrameConstants" &&
+            (block.binding != GLint(FRAME_CONSTANTS_BINDING) ||
+             block.dataSize > GLint(sizeof(FrameConstants))))
+        {
+            std::cerr << "FrameConstants block mismatch: binding " << block.binding << ", "
+                      << block.dataSize << " bytes for at most " << sizeof(FrameConstants)
+                      << std::endl;
+            throw std::runtime_error("FrameConstants block mismatch");
+        }
+    }
+}
+
 ToyOpenGLApp::ToyOpenGLApp(const fs::path &appPath, uint32_t width,
                            uint32_t height, const std::string &vertexShader,
-                           const std::string &fragmentShader, const fs::path &output)
+                           const std::string &fragmentShader, const fs::path &output,
+                           const fs::path &scene)
     : m_nWindowWidth(width),
       m_nWindowHeight(height),
       m_AppPath{appPath},
       m_AppName{m_AppPath.stem().string()},
       m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
       m_ShaderRootPath{m_AppPath.parent_path() / "shaders"},
-      m_OutputPath{output}
+      m_OutputPath{output},
+      m_ScenePath{scene}
 {
     if (!vertexShader.empty())
     {
@@ -43,24 +114,180 @@ ToyOpenGLApp::ToyOpenGLApp(const fs::path &appPath, uint32_t width,
 
 int ToyOpenGLApp::run()
 {
-    glEnable(GL_DEPTH_TEST);
-    GLuint vao = createTriangleVao();
+    TriangleSoA cubeTriangles, sphereTriangles;
+    Mesh cube = createCubeMesh(cubeTriangles);
+    Mesh sphere = createSphereMesh(sphereTriangles);
     GLProgram program = compileProgram({m_ShaderRootPath / m_VertexShader, m_ShaderRootPath / m_FragmentShader});
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    glm::vec3 cubePositions[] = {
-        glm::vec3(0.0f, 0.0f, 0.0f),
-        glm::vec3(2.0f, 5.0f, -15.0f),
-        glm::vec3(-1.5f, -2.2f, -2.5f),
-        glm::vec3(-3.8f, -2.0f, -12.3f),
-        glm::vec3(2.4f, -0.4f, -3.5f),
-        glm::vec3(-1.7f, 3.0f, -7.5f),
-        glm::vec3(1.3f, -2.0f, -2.5f),
-        glm::vec3(1.5f, 2.0f, -2.5f),
-        glm::vec3(1.5f, 0.2f, -1.5f),
-        glm::vec3(-1.3f, 1.0f, -1.5f)};
+    // instanced paths index their textures by material ID
+    MaterialTextures materials;
+    createMaterials(materials);
+    GLProgram instancedProgram = compileProgram(
+        {m_ShaderRootPath / m_InstancedVertexShader, m_ShaderRootPath / materials.fragmentShader()});
+    GLBuffer instanceBuffer = createInstanceBuffer({cube.vao(), sphere.vao()});
+
+    // images are decoded by the pool and uploaded by the frame loop, a placeholder until then;
+    // the glTF document is declared first as its embedded images are decoded in place
+    GltfDocument gltfDocument;
+    TextureLoader textureLoader;
+    textureLoader.setCacheDirectory(m_AppPath.parent_path() / "cache" / "textures");
+    std::vector<std::pair<std::string, TextureRequest>> textureNameId =
+        createTextures(textureLoader);
+
+    // small images share the pages of an atlas, more are inserted from the GUI
+    TextureAtlas atlas(2048, 4, true);
+    createAtlas(atlas);
+    uint32_t atlasIconSeed = 0;
+    int atlasPreviewPage = 0;
+
+    // uniform handles are resolved once from the reflected program instead of per draw
+    checkFrameConstantsBlock(program);
+    checkFrameConstantsBlock(instancedProgram);
+    const auto uModel = program.getUniformHandle("model");
+    const auto uMixParam = program.getUniformHandle("mixParam");
+    std::vector<GLUniformHandle> uTextures;
+    for (const auto &tex : textureNameId)
+    {
+        uTextures.push_back(program.getUniformHandle(tex.first.c_str()));
+    }
+    const auto uInstancedMixParam = instancedProgram.getUniformHandle("mixParam");
+
+    // glTF scene from the command line, static, drawn after the field
+    GLProgram gltfProgram = compileProgram(
+        {m_ShaderRootPath / "gltf.vs.glsl", m_ShaderRootPath / "gltf.fs.glsl"});
+    checkFrameConstantsBlock(gltfProgram);
+    const auto uGltfModel = gltfProgram.getUniformHandle("model");
+    const auto uGltfBaseColorFactor = gltfProgram.getUniformHandle("baseColorFactor");
+    const auto uGltfAlphaCutoff = gltfProgram.getUniformHandle("alphaCutoff");
+    std::unique_ptr<GltfModel> gltfModel;
+    TransformHierarchy gltfTransforms;
+    std::vector<std::pair<TransformNode, uint32_t>> gltfMeshNodes;
+    if (!m_ScenePath.empty())
+    {
+        gltfDocument.load(m_ScenePath);
+        gltfModel = std::make_unique<GltfModel>(gltfDocument, textureLoader);
+        if (gltfDocument.defaultScene() != GLTF_NONE)
+        {
+            gltfDocument.instantiate(uint32_t(gltfDocument.defaultScene()), gltfTransforms,
+                                     gltfMeshNodes);
+        }
+        gltfTransforms.update();
+        const auto &loadStats = gltfDocument.stats();
+        const auto &modelStats = gltfModel->stats();
+        std::clog << "glTF " << m_ScenePath.filename().string() << ": "
+                  << loadStats.fileBytes / (1024.f * 1024.f) << " MB mapped, parsed in "
+                  << loadStats.parseMilliseconds << " ms, " << modelStats.primitives
+                  << " primitives, " << modelStats.uploadedBytes / (1024.f * 1024.f)
+                  << " MB uploaded in place to " << modelStats.buffers << " buffers in "
+                  << modelStats.uploadMilliseconds << " ms" << std::endl;
+    }
 
-    std::vector<std::pair<std::string, int>> textureNameId = createTextures();
+    enum DrawMode
+    {
+        DrawModePerObject = 0,
+        DrawModeInstanced = 1,
+        DrawModeRenderQueue = 2,
+        DrawModeGPUDriven = 3
+    };
+    int drawMode = DrawModeInstanced;
+    // the field is made of cubes or of spheres, which have levels of detail
+    enum FieldShape
+    {
+        FieldShapeCube = 0,
+        FieldShapeSphere = 1
+    };
+    int fieldShape = FieldShapeCube;
+    const Mesh *fieldMesh = &cube;
+    const TriangleSoA *fieldTriangles = &cubeTriangles;
+    int instanceCount = 10;
+    // every instance is a child of the field root, world matrices are only recomputed for
+    // the nodes that moved
+    TransformHierarchy sceneTransforms;
+    TransformNode fieldRoot = NO_TRANSFORM_NODE;
+    std::vector<TransformNode> instanceNodes;
+    std::vector<Transform> fieldLocals;
+    bool spinCubes = false;
+    bool swayField = false;
+    std::vector<glm::mat4> instanceTransforms;
+    std::vector<InstanceData> instances;
+    bool instancesDirty = true;
+
+    // world boxes of the cubes, culled against the view frustum into a visible index list
+    // that every draw path consumes
+    AABBSoA instanceBounds;
+    std::vector<uint32_t> visibleInstances;
+    bool frustumCulling = true;
+    float cullTimeAverage = 0.f;
+    // the same boxes in a BVH, for hierarchical culling and finding the instances under the
+    // cursor, whose triangles are then tested exactly
+    enum CullMode
+    {
+        CullModeLinear = 0,
+        CullModeBVH = 1
+    };
+    int cullMode = CullModeBVH;
+    std::vector<AABB> instanceBoxes;
+    BVH instanceBVH;
+    float bvhBuildTime = 0.f;
+    PickHit pickHit;
+    float pickTime = 0.f;
+    // the cubes closest to the camera are rasterized as occluders on the CPU, the frustum
+    // visible ones are then tested against them; freezing keeps the last visible set while
+    // the camera moves, to look at what was culled
+    OcclusionCuller occlusionCuller;
+    OccluderMesh fieldOccluder;
+    std::vector<std::pair<float, uint32_t>> occluderCandidates;
+    bool occlusionCulling = true;
+    bool freezeCulling = false;
+    bool showOcclusionBuffer = false;
+    int maxOccluders = 64;
+    float occlusionTimeAverage = 0.f;
+    GLTexture occlusionTexture(GL_TEXTURE_2D);
+    occlusionTexture.storage2D(1, GL_R8, OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT);
+    occlusionTexture.setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    occlusionTexture.setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    occlusionTexture.setParameter(GL_TEXTURE_SWIZZLE_G, GL_RED);
+    occlusionTexture.setParameter(GL_TEXTURE_SWIZZLE_B, GL_RED);
+    std::vector<uint8_t> occlusionPixels(size_t(OcclusionCuller::WIDTH) * OcclusionCuller::HEIGHT);
+    // the GPU driven path only looks for occluders this close, through the BVH
+    const float occluderRange = 10.f;
+    std::vector<uint32_t> nearInstances;
+
+    // each visible instance draws the coarsest LOD whose error stays under a few pixels,
+    // the GPU driven path keeps LOD 0
+    LODSelector lodSelector;
+    bool lodSelection = true;
+    std::vector<uint32_t> visibleLods;
+    std::vector<size_t> lodInstanceCounts;
+    std::vector<uint32_t> lodInstances;
+
+    // culls on the GPU and draws with one glMultiDrawElementsIndirectCount
+    GPUCuller gpuCuller(compileProgram({m_ShaderRootPath / "cull_instances.cs.glsl"}),
+                        compileProgram({m_ShaderRootPath / "compact_draws.cs.glsl"}));
+
+    // one ring region per frame in flight, large enough for the biggest queued cube field
+    const int maxInstanceCount = 200000;
+    GLRingBuffer streamRing(
+        maxInstanceCount * GLsizeiptr(sizeof(InstanceData) + sizeof(IndirectCommand)) + (1 << 16));
+    // every draw path below goes through the state cache
+    GLStateCache state;
+    GLStateCounters stateCounters;
+    state.enable(GL_DEPTH_TEST);
+    RenderQueue renderQueue(streamRing, state, INSTANCE_BUFFER_BINDING);
+    GLint uniformBufferAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
+    // materials are indexed in the shader, nothing to bind per draw
+    const auto materialTextureSet = renderQueue.addTextureSet({});
+
+    // CPU cost of the per-frame draw submission, to compare uniform paths and draw modes
+    enum UniformPath
+    {
+        UniformPathDriverLookup = 0,
+        UniformPathReflectedCache = 1
+    };
+    int uniformPath = UniformPathReflectedCache;
+    float submitTimeAverage = 0.f;
     float mixValue = .5;
     float zTranslate = -3.0f;
     std::unique_ptr<CameraController> cameraController =
@@ -73,46 +300,602 @@ int ToyOpenGLApp::run()
         lastFrame = currentFrame;
 
         cameraController->update(deltaTime);
+        streamRing.beginFrame();
+        textureLoader.update(state);
 
-        glm::mat4 model(1.f), view(1.0f), projection(1.0f);
-        projection = glm::perspective(glm::radians(camera.Zoom), 1280.f / 720.f, 0.0001f, 100.0f);
+        glm::mat4 view(1.0f), projection(1.0f);
+        const float zNear = 0.0001f, zFar = 100.0f;
+        projection = glm::perspective(glm::radians(camera.Zoom), 1280.f / 720.f, zNear, zFar);
         view = cameraController->getCamera().getViewMatrix();
+        // view dependent constants are uploaded once and shared by every program
+        FrameConstants frameConstants;
+        frameConstants.view = view;
+        frameConstants.projection = projection;
+        frameConstants.viewProj = projection * view;
+        frameConstants.cameraPosition = cameraController->getCamera().eye();
+        frameConstants.time = currentFrame;
+        frameConstants.viewport = glm::vec2(m_GLFWHandle.frameBufferSize());
+        const auto frameConstantsSlice =
+            streamRing.allocate(sizeof(FrameConstants), uniformBufferAlignment);
+        std::memcpy(frameConstantsSlice.data, &frameConstants, sizeof(FrameConstants));
+        state.bindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, streamRing.glId(),
+                              frameConstantsSlice.offset, frameConstantsSlice.size);
+
         // render
         glClearColor(0.5f, 0.5f, 0.5f, 0.f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        program.use();
-        glBindVertexArray(vao);
+        if (instancesDirty)
+        {
+            fieldLocals = createCubeField(size_t(instanceCount));
+            sceneTransforms.clear();
+            sceneTransforms.reserve(fieldLocals.size() + 1);
+            fieldRoot = sceneTransforms.create();
+            instanceNodes.resize(fieldLocals.size());
+            for (size_t i = 0; i < fieldLocals.size(); ++i)
+            {
+                instanceNodes[i] = sceneTransforms.create(fieldRoot, fieldLocals[i]);
+            }
+        }
+        // the hand placed cubes spin in place, swaying moves the whole field through its root
+        if (spinCubes)
+        {
+            for (size_t i = 0; i < std::min<size_t>(instanceNodes.size(), 10); ++i)
+            {
+                sceneTransforms.setRotation(
+                    instanceNodes[i], glm::angleAxis(currentFrame * (1.f + .1f * float(i)),
+                                                     glm::vec3(0.f, 0.f, 1.f)) *
+                                          fieldLocals[i].rotation);
+            }
+        }
+        if (swayField)
+        {
+            sceneTransforms.setRotation(
+                fieldRoot, glm::angleAxis(.1f * std::sin(currentFrame), glm::vec3(0.f, 1.f, 0.f)));
+        }
+        const size_t movedTransforms = sceneTransforms.update(&ThreadPool::global());
 
-        glUniformMatrix4fv(program.getUniformLocation("view"), 1, GL_FALSE,
-                           glm::value_ptr(view));
-        glUniformMatrix4fv(program.getUniformLocation("projection"), 1, GL_FALSE,
-                           glm::value_ptr(projection));
-        for (int i = 0; i < 10; ++i)
+        if (instancesDirty)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(.0f, .0f, 1.f));
-            int index = 0;
-            for (auto tex : textureNameId)
+            fieldMesh = fieldShape == FieldShapeSphere ? &sphere : &cube;
+            fieldTriangles = fieldShape == FieldShapeSphere ? &sphereTriangles : &cubeTriangles;
+            const AABB meshBounds = fieldMesh->bounds();
+            // occluders must not cover more than the mesh, the sphere uses its inscribed cube
+            const glm::vec3 occluderExtent =
+                fieldShape == FieldShapeSphere ? meshBounds.extent() / std::sqrt(3.f)
+                                               : meshBounds.extent();
+            fieldOccluder = makeBoxOccluder(AABB(meshBounds.center() - occluderExtent,
+                                                 meshBounds.center() + occluderExtent));
+            instanceTransforms.resize(instanceNodes.size());
+            for (size_t i = 0; i < instanceNodes.size(); ++i)
             {
-                glActiveTexture(GL_TEXTURE0 + index);
-                glBindTexture(GL_TEXTURE_2D, tex.second);
-                glUniform1i(program.getUniformLocation(tex.first.c_str()), index++);
+                instanceTransforms[i] = sceneTransforms.world(instanceNodes[i]);
             }
-            glUniform1f(program.getUniformLocation("mixParam"), mixValue);
-            glUniformMatrix4fv(program.getUniformLocation("model"), 1, GL_FALSE,
-                               glm::value_ptr(model));
+            instances.assign(instanceTransforms.size(), InstanceData());
+            instanceBounds.clear();
+            instanceBounds.reserve(instances.size());
+            instanceBoxes.resize(instances.size());
+            for (size_t i = 0; i < instances.size(); ++i)
+            {
+                instances[i].model = instanceTransforms[i];
+                instances[i].materialId = uint32_t(i % materials.materialCount());
+                instanceBoxes[i] = transformAABB(meshBounds, instanceTransforms[i]);
+                instanceBounds.push(instanceBoxes[i]);
+            }
+            const auto buildStart = std::chrono::high_resolution_clock::now();
+            instanceBVH.build(instanceBoxes, &ThreadPool::global());
+            bvhBuildTime = std::chrono::duration<float, std::milli>(
+                               std::chrono::high_resolution_clock::now() - buildStart)
+                               .count();
+            instanceBuffer.setData(instances.size() * sizeof(InstanceData), instances.data(),
+                                   GL_STATIC_DRAW);
+            gpuCuller.setInstances(instances, instanceBoxes, {fieldMesh->drawRange()});
+            lodSelector.reset(instances.size());
+            instancesDirty = false;
+            // the frozen visible set indexes the previous field
+            freezeCulling = false;
+        }
+        else if (movedTransforms > 0)
+        {
+            // only the moved instances are refreshed and uploaded, the BVH keeps its topology
+            size_t firstMoved = instances.size(), lastMoved = 0;
+            for (size_t i = 0; i < instances.size(); ++i)
+            {
+                if (!sceneTransforms.updated(instanceNodes[i]))
+                {
+                    continue;
+                }
+                instanceTransforms[i] = sceneTransforms.world(instanceNodes[i]);
+                instances[i].model = instanceTransforms[i];
+                instanceBoxes[i] = transformAABB(fieldMesh->bounds(), instanceTransforms[i]);
+                instanceBounds.set(i, instanceBoxes[i]);
+                firstMoved = std::min(firstMoved, i);
+                lastMoved = i + 1;
+            }
+            if (firstMoved < lastMoved)
+            {
+                const size_t movedCount = lastMoved - firstMoved;
+                instanceBVH.refit(instanceBoxes);
+                instanceBuffer.setSubData(GLintptr(firstMoved * sizeof(InstanceData)),
+                                          GLsizeiptr(movedCount * sizeof(InstanceData)),
+                                          &instances[firstMoved]);
+                gpuCuller.updateInstances(firstMoved, movedCount, instances, instanceBoxes);
+            }
+        }
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        // frozen culling keeps the visible set of the frame it was frozen at
+        const auto cullStart = std::chrono::high_resolution_clock::now();
+        const bool gpuDriven = drawMode == DrawModeGPUDriven;
+        if (!freezeCulling && !gpuDriven)
+        {
+            if (frustumCulling && cullMode == CullModeBVH)
+            {
+                instanceBVH.cull(extractFrustum(frameConstants.viewProj), visibleInstances);
+            }
+            else if (frustumCulling)
+            {
+                cullAABBs(extractFrustum(frameConstants.viewProj), instanceBounds, visibleInstances);
+            }
+            else
+            {
+                visibleInstances.resize(instances.size());
+                std::iota(begin(visibleInstances), end(visibleInstances), 0u);
+            }
         }
+        if (occlusionCulling && !freezeCulling)
+        {
+            const auto occlusionStart = std::chrono::high_resolution_clock::now();
+            const auto eye = cameraController->getCamera().eye();
+            if (gpuDriven)
+            {
+                // the CPU doesn't know what is visible, candidates are the cubes in the near
+                // part of the frustum
+                const auto nearProjection = glm::perspective(glm::radians(camera.Zoom),
+                                                             1280.f / 720.f, zNear, occluderRange);
+                instanceBVH.cull(extractFrustum(nearProjection * view), nearInstances);
+            }
+            occluderCandidates.clear();
+            for (const auto i : gpuDriven ? nearInstances : visibleInstances)
+            {
+                const glm::vec3 offset = instanceBoxes[i].center() - eye;
+                occluderCandidates.emplace_back(glm::dot(offset, offset), i);
+            }
+            const size_t occluderCount = std::min(occluderCandidates.size(), size_t(maxOccluders));
+            std::nth_element(begin(occluderCandidates), begin(occluderCandidates) + occluderCount,
+                             end(occluderCandidates));
+            occlusionCuller.beginFrame(frameConstants.viewProj);
+            for (size_t i = 0; i < occluderCount; ++i)
+            {
+                occlusionCuller.addOccluder(fieldOccluder,
+                                            instanceTransforms[occluderCandidates[i].second]);
+            }
+            occlusionCuller.rasterize(&ThreadPool::global());
+            if (!gpuDriven)
+            {
+                occlusionCuller.cull(instanceBoxes, visibleInstances, &ThreadPool::global());
+            }
+            const auto occlusionTime = std::chrono::duration<float, std::micro>(
+                                           std::chrono::high_resolution_clock::now() - occlusionStart)
+                                           .count();
+            occlusionTimeAverage = glm::mix(occlusionTimeAverage, occlusionTime, 0.05f);
+        }
+        if (gpuDriven && !freezeCulling)
+        {
+            gpuCuller.setOcclusionBuffer(occlusionCulling ? &occlusionCuller : nullptr);
+            gpuCuller.cull(state, frustumCulling);
+        }
+        const auto cullTime = std::chrono::duration<float, std::micro>(
+                                  std::chrono::high_resolution_clock::now() - cullStart)
+                                  .count();
+        cullTimeAverage = glm::mix(cullTimeAverage, cullTime, 0.05f);
 
-        // glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        // cursor ray through the inverse view projection, ignored while over the ui
+        pickHit = PickHit();
+        if (!ImGui::GetIO().WantCaptureMouse)
+        {
+            double cursorX = 0., cursorY = 0.;
+            int windowWidth = 0, windowHeight = 0;
+            glfwGetCursorPos(m_GLFWHandle.window(), &cursorX, &cursorY);
+            glfwGetWindowSize(m_GLFWHandle.window(), &windowWidth, &windowHeight);
+            const auto pickStart = std::chrono::high_resolution_clock::now();
+            const Ray ray = cursorRay(glm::vec2(float(cursorX), float(cursorY)),
+                                      glm::vec2(float(std::max(windowWidth, 1)),
+                                                float(std::max(windowHeight, 1))),
+                                      view, projection);
+            pick(ray, instanceBVH, instanceTransforms, *fieldTriangles, pickHit);
+            pickTime = std::chrono::duration<float, std::micro>(
+                           std::chrono::high_resolution_clock::now() - pickStart)
+                           .count();
+        }
+
+        // LOD per visible instance from the distance to its bounds, then instances grouped by
+        // LOD so the instanced path issues one draw per level
+        const size_t lodCount = lodSelection && !gpuDriven ? fieldMesh->lodCount() : 1;
+        visibleLods.assign(visibleInstances.size(), 0u);
+        if (lodCount > 1)
+        {
+            lodSelector.setProjectionScale(projectionScale(
+                glm::radians(camera.Zoom), float(m_GLFWHandle.frameBufferSize().y)));
+            const auto eye = cameraController->getCamera().eye();
+            const float *errors = fieldMesh->lodErrors().data();
+            for (size_t k = 0; k < visibleInstances.size(); ++k)
+            {
+                const auto &box = instanceBoxes[visibleInstances[k]];
+                const float distance =
+                    std::max(glm::length(box.center() - eye) - glm::length(box.extent()), 0.f);
+                visibleLods[k] = lodSelector.select(visibleInstances[k], errors, lodCount, distance);
+            }
+        }
+        lodInstanceCounts.assign(lodCount + 1, 0);
+        for (const auto lod : visibleLods)
+        {
+            ++lodInstanceCounts[lod + 1];
+        }
+        for (size_t lod = 0; lod < lodCount; ++lod)
+        {
+            lodInstanceCounts[lod + 1] += lodInstanceCounts[lod];
+        }
+        lodInstances.resize(visibleInstances.size());
+        {
+            std::vector<size_t> fill(begin(lodInstanceCounts), end(lodInstanceCounts) - 1);
+            for (size_t k = 0; k < visibleInstances.size(); ++k)
+            {
+                lodInstances[fill[visibleLods[k]]++] = visibleInstances[k];
+            }
+        }
+
+        const GLuint vao = fieldMesh->vao();
+        state.bindVertexArray(vao);
+        const auto submitStart = std::chrono::high_resolution_clock::now();
+        instancedProgram.setUniform(uInstancedMixParam, mixValue);
+        if (drawMode == DrawModeInstanced)
+        {
+            // the whole field in one draw, model matrices come from the instance buffer, or
+            // from the visible instances compacted in the ring when culling removed some
+            state.useProgram(instancedProgram.glId());
+            materials.bind(state);
+            if (visibleInstances.size() < instances.size() || lodCount > 1)
+            {
+                for (size_t lod = 0; lod < lodCount; ++lod)
+                {
+                    const size_t first = lodInstanceCounts[lod];
+                    const size_t count = lodInstanceCounts[lod + 1] - first;
+                    if (count == 0)
+                    {
+                        continue;
+                    }
+                    const auto slice = streamRing.allocate<InstanceData>(count, 16);
+                    auto visible = static_cast<InstanceData *>(slice.data);
+                    for (size_t k = first; k < first + count; ++k)
+                    {
+                        *visible++ = instances[lodInstances[k]];
+                    }
+                    glVertexArrayVertexBuffer(vao, INSTANCE_BUFFER_BINDING, streamRing.glId(),
+                                              slice.offset, sizeof(InstanceData));
+                    fieldMesh->drawInstanced(GLsizei(count), lod);
+                }
+            }
+            else
+            {
+                glVertexArrayVertexBuffer(vao, INSTANCE_BUFFER_BINDING, instanceBuffer.glId(), 0,
+                                          sizeof(InstanceData));
+                fieldMesh->drawInstanced(GLsizei(visibleInstances.size()));
+            }
+        }
+        else if (drawMode == DrawModeGPUDriven)
+        {
+            // instance count and draw count come from the compute passes
+            state.useProgram(instancedProgram.glId());
+            materials.bind(state);
+            gpuCuller.draw(state, vao, INSTANCE_BUFFER_BINDING);
+        }
+        else if (drawMode == DrawModeRenderQueue)
+        {
+            renderQueue.setView(view, zNear, zFar);
+            materials.bind(state);
+            for (size_t k = 0; k < visibleInstances.size(); ++k)
+            {
+                const auto i = visibleInstances[k];
+                renderQueue.push(instancedProgram.glId(), materialTextureSet, vao,
+                                 fieldMesh->drawRange(visibleLods[k]), instances[i].model,
+                                 instances[i].materialId);
+            }
+            renderQueue.submit();
+        }
+        else
+        {
+            state.useProgram(program.glId());
+            program.resetUniformCallCounters();
+            for (size_t k = 0; k < visibleInstances.size(); ++k)
+            {
+                const auto &model = instanceTransforms[visibleInstances[k]];
+                int index = 0;
+                for (const auto &tex : textureNameId)
+                {
+                    state.bindTexture(GLuint(index), textureLoader.texture(tex.second));
+                    if (uniformPath == UniformPathDriverLookup)
+                    {
+                        glUniform1i(glGetUniformLocation(program.glId(), tex.first.c_str()), index);
+                    }
+                    else
+                    {
+                        program.setUniform(uTextures[index], index);
+                    }
+                    ++index;
+                }
+                if (uniformPath == UniformPathDriverLookup)
+                {
+                    glUniform1f(glGetUniformLocation(program.glId(), "mixParam"), mixValue);
+                    glUniformMatrix4fv(glGetUniformLocation(program.glId(), "model"), 1, GL_FALSE,
+                                       glm::value_ptr(model));
+                }
+                else
+                {
+                    program.setUniform(uMixParam, mixValue);
+                    program.setUniform(uModel, model);
+                }
+
+                fieldMesh->draw(visibleLods[k]);
+            }
+        }
+        if (gltfModel)
+        {
+            state.useProgram(gltfProgram.glId());
+            for (const auto &meshNode : gltfMeshNodes)
+            {
+                gltfProgram.setUniform(uGltfModel, gltfTransforms.world(meshNode.first));
+                for (size_t k = gltfModel->firstPrimitive(meshNode.second);
+                     k < gltfModel->firstPrimitive(meshNode.second + 1); ++k)
+                {
+                    // blended materials are drawn as opaque, there is no sorted pass
+                    const auto &primitive = gltfModel->primitive(k);
+                    const auto &material = gltfModel->material(primitive.material);
+                    gltfProgram.setUniform(uGltfBaseColorFactor, material.baseColorFactor);
+                    gltfProgram.setUniform(uGltfAlphaCutoff,
+                                           material.alphaMode == GltfAlphaMode::Mask
+                                               ? material.alphaCutoff
+                                               : -1.f);
+                    state.bindTexture(0, gltfModel->baseColorTexture(material));
+                    state.bindVertexArray(primitive.vao.glId());
+                    primitive.draw();
+                }
+            }
+        }
+        const auto submitTime = std::chrono::duration<float, std::micro>(
+                                     std::chrono::high_resolution_clock::now() - submitStart)
+                                     .count();
+        submitTimeAverage = glm::mix(submitTimeAverage, submitTime, 0.05f);
 
         imguiNewFrame();
 
         ImGui::Begin("GUI Control");
         ImGui::SliderFloat("MixValue", &mixValue, 0.0f, 1.0f);
         ImGui::SliderFloat("zTranslate", &zTranslate, -10.0f, 10.0f);
+        ImGui::Text("CPU submission: %.2f us/frame", submitTimeAverage);
+
+        if (ImGui::CollapsingHeader("Cube field"))
+        {
+            ImGui::RadioButton("Per object draws", &drawMode, DrawModePerObject);
+            ImGui::RadioButton("Instanced", &drawMode, DrawModeInstanced);
+            ImGui::RadioButton("Render queue", &drawMode, DrawModeRenderQueue);
+            ImGui::RadioButton("GPU driven", &drawMode, DrawModeGPUDriven);
+            ImGui::Text("Materials: %zu, %s", materials.materialCount(),
+                        materials.mode() == MaterialTextureMode::Bindless ? "bindless"
+                                                                          : "texture array");
+            if (drawMode == DrawModeRenderQueue)
+            {
+                const auto &stats = renderQueue.stats();
+                ImGui::Text("%zu packets, %zu multi draws", stats.packets, stats.multiDrawCalls);
+                ImGui::Text("binds: %zu programs, %zu texture sets, %zu vaos", stats.programBinds,
+                            stats.textureSetBinds, stats.vaoBinds);
+            }
+            instancesDirty |= ImGui::RadioButton("Cubes", &fieldShape, FieldShapeCube);
+            ImGui::SameLine();
+            instancesDirty |= ImGui::RadioButton("Spheres", &fieldShape, FieldShapeSphere);
+            instancesDirty |= ImGui::SliderInt("Instances", &instanceCount, 1, maxInstanceCount, "%d",
+                                               ImGuiSliderFlags_Logarithmic);
+            ImGui::Checkbox("Spin cubes", &spinCubes);
+            ImGui::SameLine();
+            ImGui::Checkbox("Sway field", &swayField);
+            const auto &transformStats = sceneTransforms.stats();
+            ImGui::Text("transforms: %zu nodes, %zu levels, %zu updated in %.2f us",
+                        transformStats.nodes, transformStats.levels, transformStats.updated,
+                        transformStats.updateMicroseconds);
+            ImGui::Checkbox("Frustum culling", &frustumCulling);
+            ImGui::SameLine();
+            ImGui::Text("(%s)", cullingInstructionSet());
+            ImGui::RadioButton("Linear SIMD", &cullMode, CullModeLinear);
+            ImGui::SameLine();
+            ImGui::RadioButton("BVH", &cullMode, CullModeBVH);
+            if (drawMode == DrawModeGPUDriven)
+            {
+                const auto &stats = gpuCuller.stats();
+                ImGui::Text("visible: %zu / %zu, %zu draws (%zu frames old), CPU: %.2f us",
+                            stats.visibleInstances, instances.size(), stats.drawCount,
+                            stats.framesLate, cullTimeAverage);
+            }
+            else
+            {
+                ImGui::Text("visible: %zu / %zu, culling: %.2f us", visibleInstances.size(),
+                            instances.size(), cullTimeAverage);
+            }
+            ImGui::Text("BVH: %zu nodes, depth %zu, built in %.2f ms", instanceBVH.nodes().size(),
+                        instanceBVH.depth(), bvhBuildTime);
+            if (pickHit.object != ~0u)
+            {
+                ImGui::Text("cursor: instance %u, triangle %u at (%.2f, %.2f, %.2f), %.2f us",
+                            pickHit.object, pickHit.triangle, pickHit.position.x,
+                            pickHit.position.y, pickHit.position.z, pickTime);
+            }
+            else
+            {
+                ImGui::Text("cursor: nothing");
+            }
+            if (fieldMesh->lodCount() > 1)
+            {
+                ImGui::Checkbox("LOD selection", &lodSelection);
+                float threshold = lodSelector.threshold(), hysteresis = lodSelector.hysteresis();
+                if (ImGui::SliderFloat("Max error (pixels)", &threshold, .1f, 16.f, "%.1f",
+                                       ImGuiSliderFlags_Logarithmic))
+                {
+                    lodSelector.setThreshold(threshold);
+                }
+                if (ImGui::SliderFloat("Hysteresis", &hysteresis, 0.f, .9f))
+                {
+                    lodSelector.setHysteresis(hysteresis);
+                }
+                size_t triangles = 0;
+                for (size_t lod = 0; lod < lodCount; ++lod)
+                {
+                    const size_t count = lodInstanceCounts[lod + 1] - lodInstanceCounts[lod];
+                    triangles += count * size_t(fieldMesh->indexCount(lod) / 3);
+                    ImGui::Text("LOD %zu: %zu instances, %d triangles, error %.4f", lod, count,
+                                fieldMesh->indexCount(lod) / 3, fieldMesh->lodErrors()[lod]);
+                }
+                ImGui::Text("submitted: %zu triangles", triangles);
+            }
+            ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+            ImGui::SameLine();
+            ImGui::Checkbox("Freeze", &freezeCulling);
+            ImGui::SliderInt("Occluders", &maxOccluders, 1, 512);
+            const auto &occlusionStats = occlusionCuller.stats();
+            ImGui::Text("%zu occluders, %zu triangles, %zu / %zu occluded",
+                        occlusionStats.occluders, occlusionStats.triangles,
+                        occlusionStats.occluded, occlusionStats.tested);
+            ImGui::Text("occlusion: %.2f us (raster %.2f us, tests %.2f us)", occlusionTimeAverage,
+                        occlusionStats.rasterizeMicroseconds, occlusionStats.testMicroseconds);
+            ImGui::Checkbox("Show occlusion buffer", &showOcclusionBuffer);
+            if (showOcclusionBuffer)
+            {
+                // inverse depth mapped to brightness, closer is brighter
+                const float *depth = occlusionCuller.depth();
+                for (size_t i = 0; i < occlusionPixels.size(); ++i)
+                {
+                    occlusionPixels[i] = uint8_t(255.f * depth[i] / (depth[i] + .2f));
+                }
+                occlusionTexture.subImage2D(0, 0, 0, OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT,
+                                            GL_RED, GL_UNSIGNED_BYTE, occlusionPixels.data());
+                // rows are stored bottom up
+                ImGui::Image(reinterpret_cast<ImTextureID>(intptr_t(occlusionTexture.glId())),
+                             ImVec2(2.f * OcclusionCuller::WIDTH, 2.f * OcclusionCuller::HEIGHT),
+                             ImVec2(0.f, 1.f), ImVec2(1.f, 0.f));
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Uniform submission"))
+        {
+            if (ImGui::RadioButton("glGetUniformLocation per draw", &uniformPath, UniformPathDriverLookup) ||
+                ImGui::RadioButton("Reflected cache", &uniformPath, UniformPathReflectedCache))
+            {
+                // the driver path bypasses the shadow copy
+                program.invalidateUniformShadow();
+                submitTimeAverage = 0.f;
+            }
+            ImGui::Text("glUniform calls issued: %zu, skipped: %zu",
+                        program.getUniformCallsIssued(), program.getUniformCallsSkipped());
+        }
+
+        if (ImGui::CollapsingHeader("Meshes"))
+        {
+            const std::pair<const char *, const Mesh *> meshes[] = {{"cube", &cube},
+                                                                    {"sphere", &sphere}};
+            for (const auto &named : meshes)
+            {
+                const Mesh &mesh = *named.second;
+                const auto &stats = mesh.stats();
+                ImGui::Text("%s: %zu -> %zu vertices, %zu triangles, %zu LODs", named.first,
+                            stats.inputVertices, stats.vertices, stats.triangles, mesh.lodCount());
+                ImGui::Text("ACMR %.3f, ATVR %.3f", stats.acmr, stats.atvr);
+                ImGui::Text("%s vertices, %d bytes each",
+                            mesh.vertexFormat() == VertexFormat::Compact ? "compact" : "float",
+                            mesh.vertexStride());
+                ImGui::Text("%zu -> %zu bytes", stats.unindexedBytes, stats.indexedBytes);
+            }
+        }
+
+        if (gltfModel && ImGui::CollapsingHeader("glTF scene"))
+        {
+            const auto &loadStats = gltfDocument.stats();
+            const auto &modelStats = gltfModel->stats();
+            ImGui::Text("%s", m_ScenePath.filename().string().c_str());
+            ImGui::Text("%zu meshes, %zu primitives, %zu nodes, %zu textures",
+                        gltfModel->meshCount(), modelStats.primitives,
+                        gltfDocument.nodes().size(), modelStats.textures);
+            ImGui::Text("parsed in %.2f ms, %.2f MB mapped, %.2f MB decoded",
+                        loadStats.parseMilliseconds, loadStats.fileBytes / (1024.f * 1024.f),
+                        loadStats.decodedBytes / (1024.f * 1024.f));
+            ImGui::Text("uploaded in %.2f ms: %zu buffers, %.2f MB in place, %.2f MB decoded",
+                        modelStats.uploadMilliseconds, modelStats.buffers,
+                        modelStats.uploadedBytes / (1024.f * 1024.f),
+                        modelStats.decodedBytes / (1024.f * 1024.f));
+            ImGui::Text("%zu accessor bindings shared a buffer view", modelStats.sharedViews);
+        }
+
+        if (ImGui::CollapsingHeader("Texture loading"))
+        {
+            const auto &stats = textureLoader.stats();
+            ImGui::Text("%zu requested: %zu decoding, %zu waiting, %zu uploading",
+                        stats.requested, stats.decoding, stats.waiting, stats.uploading);
+            ImGui::Text("%zu resident, %zu failed, %.2f MB uploaded (%zu direct)", stats.resident,
+                        stats.failed, stats.uploadedBytes / (1024.f * 1024.f),
+                        stats.directUploads);
+            ImGui::Text("%zu block compressed, %zu CPU mip chains, %zu from the cache",
+                        stats.compressed, stats.cpuMipmapped, stats.cacheHits);
+            ImGui::Text("update: %.2f us", stats.lastUpdateMicroseconds);
+            for (const auto &tex : textureNameId)
+            {
+                const GLTexture &texture = textureLoader.glTexture(tex.second);
+                ImGui::Text("%s: %dx%d, %d levels, %.2f MB", tex.first.c_str(), texture.width(),
+                            texture.height(), texture.levels(),
+                            texture.storageBytes() / (1024.f * 1024.f));
+            }
+            ImGui::Text("GPU texture memory: %.2f MB, %.2f MB in loaded textures",
+                        GLTexture::allocatedBytes() / (1024.f * 1024.f),
+                        stats.residentBytes / (1024.f * 1024.f));
+        }
+
+        if (ImGui::CollapsingHeader("Texture atlas"))
+        {
+            const auto &stats = atlas.stats();
+            ImGui::Text("%zu regions in %zu pages of %d texels, %d levels", stats.regions,
+                        stats.pages, atlas.pageSize(), atlas.levels());
+            ImGui::Text("fill: %.1f %%, last insertion: %.2f us", 100.f * stats.fill,
+                        stats.lastInsertMicroseconds);
+            if (ImGui::Button("Insert icons"))
+            {
+                std::vector<std::vector<uint8_t>> icons;
+                icons.reserve(16);
+                std::vector<TextureAtlas::Image> images;
+                for (int i = 0; i < 16; ++i, ++atlasIconSeed)
+                {
+                    const int size = 16 + int(atlasIconSeed * 37u % 113u);
+                    icons.push_back(createAtlasIcon(size, atlasIconSeed));
+                    images.push_back({icons.back().data(), size, size, 4});
+                }
+                atlas.add(images);
+            }
+            ImGui::SliderInt("page", &atlasPreviewPage, 0, int(atlas.pageCount()) - 1);
+            atlasPreviewPage = glm::clamp(atlasPreviewPage, 0, int(atlas.pageCount()) - 1);
+            // rows are stored bottom up
+            const GLTexture &page = atlas.page(size_t(atlasPreviewPage));
+            ImGui::Image(reinterpret_cast<ImTextureID>(intptr_t(page.glId())),
+                         ImVec2(512.f, 512.f), ImVec2(0.f, 1.f), ImVec2(1.f, 0.f));
+        }
+
+        if (ImGui::CollapsingHeader("Streaming ring"))
+        {
+            const auto &stats = streamRing.stats();
+            ImGui::Text("%u regions of %.2f MB", streamRing.regionCount(),
+                        streamRing.regionSize() / (1024.f * 1024.f));
+            ImGui::Text("frame: %.2f MB, peak: %.2f MB", stats.frameBytes / (1024.f * 1024.f),
+                        stats.peakBytes / (1024.f * 1024.f));
+            ImGui::Text("stalls: %zu (last %.3f ms)", stats.stalls, stats.lastStallMs);
+        }
+
+        if (ImGui::CollapsingHeader("GL state"))
+        {
+            ImGui::Text("calls issued: %zu, filtered: %zu", stateCounters.issued,
+                        stateCounters.filtered);
+        }
 
         static int cameraControllerType = 0;
         const auto cameraControllerTypeChanged =
@@ -136,8 +919,13 @@ int ToyOpenGLApp::run()
         }
         ImGui::End();
 
+        stateCounters = state.counters();
+        state.resetCounters();
         imguiRenderFrame();
+        // the ImGui backend binds its own program, vao and textures
+        state.invalidate();
 
+        streamRing.endFrame();
         glfwPollEvents();
         m_GLFWHandle.swapBuffers();
     }
@@ -208,16 +996,9 @@ void ToyOpenGLApp::scroll_callback(GLFWwindow *window, double xoffset, double yo
     thisobj->camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-GLuint ToyOpenGLApp::createTriangleVao()
+Mesh ToyOpenGLApp::createCubeMesh(TriangleSoA &triangles)
 {
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
+    // position, texture coordinates, 6 corners per face
     float vertices[] = {
         -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
         0.5f, -0.5f, -0.5f, 1.0f, 0.0f,
@@ -261,74 +1042,230 @@ GLuint ToyOpenGLApp::createTriangleVao()
         -0.5f, 0.5f, 0.5f, 0.0f, 0.0f,
         -0.5f, 0.5f, -0.5f, 0.0f, 1.0f};
 
-    unsigned int indices[] = {
-        0, 1, 3,
-        1, 2, 3};
+    MeshBuilder builder;
+    const size_t floatsPerCorner = 5;
+    const size_t cornerCount = sizeof(vertices) / sizeof(float) / floatsPerCorner;
+    for (size_t triangle = 0; triangle < cornerCount / 3; ++triangle)
+    {
+        const float *corners = vertices + triangle * 3 * floatsPerCorner;
+        // the face normal is the dominant axis of the triangle centroid, whatever the winding
+        glm::vec3 centroid(0.f);
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            centroid += glm::make_vec3(corners + corner * floatsPerCorner) / 3.f;
+        }
+        const auto magnitude = glm::abs(centroid);
+        const int axis = magnitude.x > magnitude.y ? (magnitude.x > magnitude.z ? 0 : 2)
+                                                   : (magnitude.y > magnitude.z ? 1 : 2);
+        glm::vec3 normal(0.f);
+        normal[axis] = glm::sign(centroid[axis]);
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const float *values = corners + corner * floatsPerCorner;
+            builder.addVertex(Vertex{glm::make_vec3(values), normal, glm::make_vec2(values + 3)});
+        }
+    }
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
+    const auto inputVertices = builder.inputVertexCount();
+    MeshData data = builder.build();
+    const auto report = optimizeMesh(data, vertexFormatSize(VertexFormat::Compact));
+    triangles.build(data);
+    Mesh mesh(data, inputVertices, VertexFormat::Compact);
+    const auto &stats = mesh.stats();
+    std::clog << "Cube mesh: " << stats.inputVertices << " -> " << stats.vertices
+              << " vertices, ACMR " << report.cacheBefore.acmr << " -> " << report.cacheAfter.acmr
+              << ", overfetch " << report.fetchBefore.overfetch << " -> "
+              << report.fetchAfter.overfetch << ", " << stats.unindexedBytes << " -> "
+              << stats.indexedBytes << " bytes" << std::endl;
+    return mesh;
+}
 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                          (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+Mesh ToyOpenGLApp::createSphereMesh(TriangleSoA &triangles)
+{
+    // UV sphere the size of the cube, detailed enough for a LOD chain
+    const int stacks = 48, slices = 96;
+    const float radius = .5f;
+    const auto corner = [&](int stack, int slice) {
+        const float theta = glm::pi<float>() * float(stack) / float(stacks);
+        const float phi = 2.f * glm::pi<float>() * float(slice) / float(slices);
+        // poles exactly on the axis so their corners share a position
+        const float ring = stack == 0 || stack == stacks ? 0.f : std::sin(theta);
+        const glm::vec3 normal(ring * std::cos(phi), std::cos(theta), ring * std::sin(phi));
+        return Vertex{radius * normal, normal,
+                      glm::vec2(float(slice) / float(slices), 1.f - float(stack) / float(stacks))};
+    };
 
-    // GLuint ebo;
-    // glGenBuffers(1, &ebo);
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    MeshBuilder builder;
+    for (int stack = 0; stack < stacks; ++stack)
+    {
+        for (int slice = 0; slice < slices; ++slice)
+        {
+            // counter clockwise seen from outside, the triangle touching a pole is skipped
+            if (stack > 0)
+            {
+                builder.addTriangle(corner(stack, slice), corner(stack, slice + 1),
+                                    corner(stack + 1, slice));
+            }
+            if (stack + 1 < stacks)
+            {
+                builder.addTriangle(corner(stack, slice + 1), corner(stack + 1, slice + 1),
+                                    corner(stack + 1, slice));
+            }
+        }
+    }
 
-    // reset buffer
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    const auto inputVertices = builder.inputVertexCount();
+    MeshData data = builder.build();
+    optimizeMesh(data, vertexFormatSize(VertexFormat::Compact));
+    // picked against the full detail level whatever LOD is drawn
+    triangles.build(data);
+    const auto lodStart = std::chrono::high_resolution_clock::now();
+    const auto lods = generateLODChain(data);
+    const auto lodTime = std::chrono::duration<float, std::milli>(
+                             std::chrono::high_resolution_clock::now() - lodStart)
+                             .count();
+    Mesh mesh(data, inputVertices, VertexFormat::Compact, lods);
+    std::clog << "Sphere mesh: " << data.indices.size() / 3 << " triangles";
+    for (const auto &lod : lods)
+    {
+        std::clog << ", " << lod.indices.size() / 3 << " (error " << lod.error << ")";
+    }
+    std::clog << ", LODs generated in " << lodTime << " ms" << std::endl;
+    return mesh;
+}
+
+GLBuffer ToyOpenGLApp::createInstanceBuffer(const std::vector<GLuint> &vaos)
+{
+    GLBuffer instanceBuffer;
 
-    return vao;
+    // all InstanceData attributes are read from the same binding so the render queue can swap
+    // the buffer behind it
+    for (const auto vao : vaos)
+    {
+        applyVertexLayout<InstanceData>(vao, INSTANCE_BUFFER_BINDING);
+        glVertexArrayBindingDivisor(vao, INSTANCE_BUFFER_BINDING, 1);
+        glVertexArrayVertexBuffer(vao, INSTANCE_BUFFER_BINDING, instanceBuffer.glId(), 0,
+                                  sizeof(InstanceData));
+    }
+
+    return instanceBuffer;
 }
 
-std::vector<std::pair<std::string, int>> ToyOpenGLApp::createTextures()
+std::vector<Transform> ToyOpenGLApp::createCubeField(size_t count)
 {
-    std::vector<std::pair<std::string, int>> textureNameId;
-    int width, height, nChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load(
-        (m_AppPath.parent_path() / "assets" / "wall.jpg").string().c_str(),
-        &width,
-        &height,
-        &nChannels, 0);
-    if (data)
+    static const glm::vec3 cubePositions[] = {
+        glm::vec3(0.0f, 0.0f, 0.0f),
+        glm::vec3(2.0f, 5.0f, -15.0f),
+        glm::vec3(-1.5f, -2.2f, -2.5f),
+        glm::vec3(-3.8f, -2.0f, -12.3f),
+        glm::vec3(2.4f, -0.4f, -3.5f),
+        glm::vec3(-1.7f, 3.0f, -7.5f),
+        glm::vec3(1.3f, -2.0f, -2.5f),
+        glm::vec3(1.5f, 2.0f, -2.5f),
+        glm::vec3(1.5f, 0.2f, -1.5f),
+        glm::vec3(-1.3f, 1.0f, -1.5f)};
+    const size_t handPlacedCount = sizeof(cubePositions) / sizeof(cubePositions[0]);
+
+    // cubes past the hand placed ones fill a lattice behind them
+    const int side = int(std::ceil(std::cbrt(float(count))));
+    std::vector<Transform> transforms(count);
+    for (size_t i = 0; i < count; ++i)
     {
-        glActiveTexture(GL_TEXTURE0);
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGB,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        textureNameId.push_back(std::make_pair("texture1", texture));
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glm::vec3 position;
+        if (i < handPlacedCount)
+        {
+            position = cubePositions[i];
+        }
+        else
+        {
+            const int cell = int(i - handPlacedCount);
+            position = glm::vec3(cell % side - side / 2, (cell / side) % side - side / 2,
+                                 -cell / (side * side)) *
+                           2.f +
+                       glm::vec3(0.f, 0.f, -20.f);
+        }
+        transforms[i].translation = position;
+        transforms[i].rotation = glm::angleAxis(glm::radians(20.0f * i), glm::vec3(.0f, .0f, 1.f));
     }
+    return transforms;
+}
 
-    stbi_image_free(data);
+void ToyOpenGLApp::createMaterials(MaterialTextures &materials)
+{
+    stbi_set_flip_vertically_on_load(true);
+    std::vector<uint32_t> textures;
+    for (const auto name : {"wall.jpg", "awesomeface.png"})
+    {
+        int width, height, nChannels;
+        unsigned char *data = stbi_load(
+            (m_AppPath.parent_path() / "assets" / name).string().c_str(),
+            &width,
+            &height,
+            &nChannels, 0);
+        if (!data)
+        {
+            std::cerr << "Unable to load " << name << std::endl;
+            throw std::runtime_error(std::string("Unable to load ") + name);
+        }
+        textures.push_back(materials.addTexture(data, width, height, nChannels));
+        stbi_image_free(data);
+    }
+    // same textures, swapped, so neighbouring cubes differ
+    materials.addMaterial({textures[0], textures[1]});
+    materials.addMaterial({textures[1], textures[0]});
+    materials.upload();
+}
 
-    unsigned char *data2 = stbi_load(
-        (m_AppPath.parent_path() / "assets" / "awesomeface.png").string().c_str(),
-        &width,
-        &height,
-        &nChannels, 0);
-    if (data2)
+void ToyOpenGLApp::createAtlas(TextureAtlas &atlas)
+{
+    stbi_set_flip_vertically_on_load(true);
+    std::vector<unsigned char *> decoded;
+    std::vector<TextureAtlas::Image> images;
+    for (const auto name : {"wall.jpg", "awesomeface.png"})
+    {
+        TextureAtlas::Image image;
+        unsigned char *data = stbi_load(
+            (m_AppPath.parent_path() / "assets" / name).string().c_str(), &image.width,
+            &image.height, &image.channels, 0);
+        if (!data)
+        {
+            std::cerr << "Unable to load " << name << std::endl;
+            throw std::runtime_error(std::string("Unable to load ") + name);
+        }
+        image.pixels = data;
+        decoded.push_back(data);
+        images.push_back(image);
+    }
+    // a single batch, the packer sees every rectangle at once
+    std::vector<std::vector<uint8_t>> icons;
+    icons.reserve(64);
+    for (uint32_t seed = 0; seed < 64; ++seed)
+    {
+        const int size = 16 + int(seed * 37u % 113u);
+        icons.push_back(createAtlasIcon(size, 1000u + seed));
+        images.push_back({icons.back().data(), size, size, 4});
+    }
+    atlas.add(images);
+    for (auto data : decoded)
     {
-        glActiveTexture(GL_TEXTURE1);
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                     GL_UNSIGNED_BYTE, data2);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        textureNameId.push_back(std::make_pair("texture2", texture));
-        glBindTexture(GL_TEXTURE_2D, 0);
+        stbi_image_free(data);
     }
+}
 
-    stbi_image_free(data2);
+std::vector<std::pair<std::string, TextureRequest>> ToyOpenGLApp::createTextures(
+    TextureLoader &loader)
+{
+    std::vector<std::pair<std::string, TextureRequest>> textureNameId;
+    TextureLoadOptions options;
+    options.compress = true;
+    const std::pair<const char *, const char *> files[] = {{"texture1", "wall.jpg"},
+                                                           {"texture2", "awesomeface.png"}};
+    for (const auto &file : files)
+    {
+        textureNameId.emplace_back(
+            file.first, loader.load(m_AppPath.parent_path() / "assets" / file.second, options));
+    }
 
     return textureNameId;
 }
@@ -3,13 +3,20 @@
 #include "utils/GLFWHandle.hpp"
 #include "utils/filesystem.hpp"
 #include "utils/camera.hpp"
+#include "utils/mesh.hpp"
+#include "utils/transform_hierarchy.hpp"
+
+class MaterialTextures;
+class TextureAtlas;
+class TextureLoader;
+class TriangleSoA;
 
 class ToyOpenGLApp
 {
 public:
     ToyOpenGLApp(const fs::path &appPath, uint32_t width, uint32_t height,
                  const std::string &vertexShader, const std::string &fragmentShader,
-                 const fs::path &output);
+                 const fs::path &output, const fs::path &scene = fs::path());
 
     int run();
 
@@ -26,8 +33,11 @@ private:
 
     std::string m_VertexShader = "forward.vs.glsl";
     std::string m_FragmentShader = "phong.fs.glsl";
+    std::string m_InstancedVertexShader = "cubic_instanced.vs.glsl";
 
     fs::path m_OutputPath;
+    // .gltf or .glb drawn next to the cube field, optional
+    fs::path m_ScenePath;
 
     const std::string m_ImGuiIniFilename;
     GLFWHandle m_GLFWHandle{
@@ -40,6 +50,13 @@ private:
     static void framebuffer_size_callback(GLFWwindow *window, int width, int height);
     static void mouse_callback(GLFWwindow *window, double xpos, double ypos);
     static void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
-    GLuint createTriangleVao();
-    std::vector<std::pair<std::string, int>> createTextures();
+    // the triangles are also returned for exact picking
+    Mesh createCubeMesh(TriangleSoA &triangles);
+    Mesh createSphereMesh(TriangleSoA &triangles);
+    GLBuffer createInstanceBuffer(const std::vector<GLuint> &vaos);
+    std::vector<Transform> createCubeField(size_t count);
+    // requested from the loader, resident a few frames later
+    std::vector<std::pair<std::string, uint32_t>> createTextures(TextureLoader &loader);
+    void createMaterials(MaterialTextures &materials);
+    void createAtlas(TextureAtlas &atlas);
 };
\ No newline at end of file
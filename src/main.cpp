@@ -6,7 +6,8 @@
 int main(int argc, char const *argv[])
 {
     ToyOpenGLApp toy = ToyOpenGLApp(
-        fs::path{std::string{argv[0]}}, 1280, 720, std::string{argv[1]}, std::string{argv[2]}, "");
+        fs::path{std::string{argv[0]}}, 1280, 720, std::string{argv[1]}, std::string{argv[2]}, "",
+        argc > 3 ? fs::path{std::string{argv[3]}} : fs::path());
     int returnCode = toy.run();
     return returnCode;
 }
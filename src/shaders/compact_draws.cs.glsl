@@ -0,0 +1,39 @@
+#version 460 core
+// Stream-compacts the batches left with visible instances by cull_instances.cs.glsl into
+// the indirect commands and draw count read by glMultiDrawElementsIndirectCount.
+layout(local_size_x = 64) in;
+
+// mirrored by IndirectCommand in src/utils/render_queue.hpp
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 4) readonly buffer Batches
+{
+    DrawCommand batches[];
+};
+layout(std430, binding = 5) writeonly buffer Commands
+{
+    DrawCommand commands[];
+};
+layout(std430, binding = 6) buffer DrawCount
+{
+    uint drawCount;
+};
+
+uniform uint batchCount;
+
+void main()
+{
+    uint batch = gl_GlobalInvocationID.x;
+    if (batch >= batchCount || batches[batch].instanceCount == 0u)
+    {
+        return;
+    }
+    commands[atomicAdd(drawCount, 1u)] = batches[batch];
+}
@@ -0,0 +1,26 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// per-instance model matrix, takes locations 3 to 6 (2 is left for normals)
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in uint aMaterial;
+
+out vec2 texCoord;
+flat out uint vMaterial;
+
+// mirrored by src/utils/frame_constants.hpp, keep both in sync
+layout(std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPosition;
+    float time;
+    vec2 viewport;
+};
+void main()
+{
+    gl_Position = viewProj*aModel*vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    texCoord = aTexCoord;
+    vMaterial = aMaterial;
+}
\ No newline at end of file
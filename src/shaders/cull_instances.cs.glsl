@@ -0,0 +1,166 @@
+#version 460 core
+// Frustum and occlusion culling of every instance, see src/utils/gpu_culling.hpp.
+// Visible instances are appended to the range of their batch, counted in its command.
+layout(local_size_x = 64) in;
+
+// mirrored by src/utils/frame_constants.hpp, keep both in sync
+layout(std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPosition;
+    float time;
+    vec2 viewport;
+};
+
+// mirrored by GPUInstanceBounds in src/utils/gpu_culling.hpp
+struct InstanceBounds
+{
+    vec3 center;
+    uint batch;
+    vec3 extent;
+    float padding;
+};
+// mirrored by InstanceData in src/utils/render_queue.hpp
+struct Instance
+{
+    mat4 model;
+    uint materialId;
+    uint padding[3];
+};
+// mirrored by IndirectCommand in src/utils/render_queue.hpp
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 1) readonly buffer Bounds
+{
+    InstanceBounds bounds[];
+};
+layout(std430, binding = 2) readonly buffer Instances
+{
+    Instance instances[];
+};
+layout(std430, binding = 3) writeonly buffer VisibleInstances
+{
+    Instance visibleInstances[];
+};
+layout(std430, binding = 4) buffer Batches
+{
+    DrawCommand batches[];
+};
+
+// inverse depths of OcclusionCuller, per pixel and farthest per 8x8 tile
+layout(binding = 1) uniform sampler2D occlusionDepth;
+layout(binding = 2) uniform sampler2D occlusionTiles;
+const int OCCLUSION_TILE_SIZE = 8;
+// boxes covering more tiles are kept rather than scanned
+const int MAX_OCCLUSION_TILES = 64;
+
+uniform uint instanceCount;
+uniform bool frustumTest;
+uniform bool occlusionTest;
+
+shared vec4 planes[6];
+
+// same test as OcclusionCuller::isVisible, but large boxes are never scanned
+bool isOccluded(vec3 boxMin, vec3 boxMax)
+{
+    vec2 screenMin = vec2(1e30), screenMax = vec2(-1e30);
+    float closest = 0.0;
+    ivec2 size = textureSize(occlusionDepth, 0);
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        vec3 position = mix(boxMin, boxMax, vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));
+        vec4 clip = viewProj * vec4(position, 1.0);
+        if (clip.w <= 1e-6)
+        {
+            return false;
+        }
+        vec2 screen = (clip.xy / clip.w * 0.5 + 0.5) * vec2(size);
+        screenMin = min(screenMin, screen);
+        screenMax = max(screenMax, screen);
+        closest = max(closest, 1.0 / clip.w);
+    }
+    ivec2 pixelMin = max(ivec2(floor(screenMin)), ivec2(0));
+    ivec2 pixelMax = min(ivec2(ceil(screenMax)) - 1, size - 1);
+    if (any(greaterThan(pixelMin, pixelMax)))
+    {
+        return true;
+    }
+    ivec2 tileMin = pixelMin / OCCLUSION_TILE_SIZE, tileMax = pixelMax / OCCLUSION_TILE_SIZE;
+    ivec2 tileCount = tileMax - tileMin + 1;
+    if (tileCount.x * tileCount.y > MAX_OCCLUSION_TILES)
+    {
+        return false;
+    }
+    for (int tileY = tileMin.y; tileY <= tileMax.y; ++tileY)
+    {
+        for (int tileX = tileMin.x; tileX <= tileMax.x; ++tileX)
+        {
+            if (texelFetch(occlusionTiles, ivec2(tileX, tileY), 0).r > closest)
+            {
+                continue;
+            }
+            ivec2 first = max(pixelMin, ivec2(tileX, tileY) * OCCLUSION_TILE_SIZE);
+            ivec2 last = min(pixelMax, ivec2(tileX, tileY) * OCCLUSION_TILE_SIZE +
+                                           OCCLUSION_TILE_SIZE - 1);
+            for (int y = first.y; y <= last.y; ++y)
+            {
+                for (int x = first.x; x <= last.x; ++x)
+                {
+                    if (texelFetch(occlusionDepth, ivec2(x, y), 0).r <= closest)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void main()
+{
+    // Gribb & Hartmann planes, one per invocation, shared by the group
+    uint planeIndex = gl_LocalInvocationIndex;
+    if (planeIndex < 6u)
+    {
+        uint axis = planeIndex / 2u;
+        vec4 row = vec4(viewProj[0][axis], viewProj[1][axis], viewProj[2][axis], viewProj[3][axis]);
+        vec4 w = vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+        vec4 plane = (planeIndex & 1u) == 0u ? w + row : w - row;
+        planes[planeIndex] = plane / length(plane.xyz);
+    }
+    barrier();
+
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= instanceCount)
+    {
+        return;
+    }
+    InstanceBounds box = bounds[index];
+    if (frustumTest)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            vec4 plane = planes[i];
+            if (dot(plane.xyz, box.center) + plane.w + dot(abs(plane.xyz), box.extent) < 0.0)
+            {
+                return;
+            }
+        }
+    }
+    if (occlusionTest && isOccluded(box.center - box.extent, box.center + box.extent))
+    {
+        return;
+    }
+    uint slot = atomicAdd(batches[box.batch].instanceCount, 1u);
+    visibleInstances[batches[box.batch].baseInstance + slot] = instances[index];
+}
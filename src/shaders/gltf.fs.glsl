@@ -0,0 +1,29 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 texCoord;
+in vec3 worldNormal;
+
+// base color texture is sRGB, the factor linear, as glTF defines them
+layout(binding = 0) uniform sampler2D baseColorTexture;
+uniform vec4 baseColorFactor;
+// negative unless the material alpha mode is MASK
+uniform float alphaCutoff;
+void main()
+{
+    vec4 baseColor = baseColorFactor * texture(baseColorTexture, texCoord);
+    if (baseColor.a < alphaCutoff)
+    {
+        discard;
+    }
+    vec3 color = baseColor.rgb;
+    if (dot(worldNormal, worldNormal) > 1e-8)
+    {
+        // a fixed key light plus ambient
+        vec3 normal = normalize(gl_FrontFacing ? worldNormal : -worldNormal);
+        vec3 light = normalize(vec3(0.4, 1.0, 0.6));
+        color *= 0.25 + 0.75 * max(dot(normal, light), 0.0);
+    }
+    // the default framebuffer isn't sRGB, encode here
+    FragColor = vec4(pow(color, vec3(1.0 / 2.2)), baseColor.a);
+}
@@ -0,0 +1,26 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+out vec2 texCoord;
+out vec3 worldNormal;
+
+uniform mat4 model;
+// mirrored by src/utils/frame_constants.hpp, keep both in sync
+layout(std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPosition;
+    float time;
+    vec2 viewport;
+};
+void main()
+{
+    gl_Position = viewProj*model*vec4(aPos, 1.0);
+    texCoord = aTexCoord;
+    // primitives without normals read (0, 0, 0), left unlit by the fragment shader
+    worldNormal = mat3(transpose(inverse(model))) * aNormal;
+}
@@ -0,0 +1,27 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 texCoord;
+flat in uint vMaterial;
+
+// mirrored by MaterialRecord in src/utils/material_textures.hpp
+struct Material
+{
+    uvec2 handles[4];
+    uint layers[4];
+};
+layout(std430, binding = 0) readonly buffer Materials
+{
+    Material materials[];
+};
+
+layout(binding = 0) uniform sampler2DArray materialArray;
+uniform float mixParam;
+void main()
+{
+    Material material = materials[vMaterial];
+    FragColor = mix(
+        texture(materialArray, vec3(texCoord, material.layers[0])),
+        texture(materialArray, vec3(texCoord, material.layers[1])),
+        mixParam);
+}
\ No newline at end of file
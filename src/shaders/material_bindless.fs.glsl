@@ -0,0 +1,27 @@
+#version 460 core
+#extension GL_ARB_bindless_texture : require
+out vec4 FragColor;
+
+in vec2 texCoord;
+flat in uint vMaterial;
+
+// mirrored by MaterialRecord in src/utils/material_textures.hpp
+struct Material
+{
+    uvec2 handles[4];
+    uint layers[4];
+};
+layout(std430, binding = 0) readonly buffer Materials
+{
+    Material materials[];
+};
+
+uniform float mixParam;
+void main()
+{
+    Material material = materials[vMaterial];
+    FragColor = mix(
+        texture(sampler2D(material.handles[0]), texCoord),
+        texture(sampler2D(material.handles[1]), texCoord),
+        mixParam);
+}
\ No newline at end of file
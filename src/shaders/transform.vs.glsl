@@ -7,11 +7,19 @@ out vec2 texCoord;
 out vec3 vColor;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// mirrored by src/utils/frame_constants.hpp, keep both in sync
+layout(std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    vec3 cameraPosition;
+    float time;
+    vec2 viewport;
+};
 void main()
 {
-    gl_Position = projection*view*model*vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    gl_Position = viewProj*model*vec4(aPos.x, aPos.y, aPos.z, 1.0);
     vColor = aColor;
     texCoord = aTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// Axis aligned bounding box, empty (min > max) when default constructed.
+struct AABB
+{
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    AABB() = default;
+    AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
+
+    bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    glm::vec3 center() const { return .5f * (min + max); }
+    // half size
+    glm::vec3 extent() const { return .5f * (max - min); }
+    float surfaceArea() const
+    {
+        const auto size = max - min;
+        return empty() ? 0.f : 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    void extend(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void extend(const AABB &box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+};
+
+// Box enclosing the transformed box (Arvo): the extent is projected on the absolute matrix.
+inline AABB transformAABB(const AABB &box, const glm::mat4 &transform)
+{
+    const glm::vec3 center = glm::vec3(transform * glm::vec4(box.center(), 1.f));
+    const glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])),
+                             glm::abs(glm::vec3(transform[2])));
+    const glm::vec3 extent = absolute * box.extent();
+    return AABB(center - extent, center + extent);
+}
@@ -0,0 +1,366 @@
+#include "bvh.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+// Objects are partitioned by value during the build so every pass reads them sequentially.
+struct BVH::BuildObject
+{
+    glm::vec3 boundsMin;
+    uint32_t index;
+    glm::vec3 boundsMax;
+    uint32_t padding;
+
+    glm::vec3 centroid() const { return .5f * (boundsMin + boundsMax); }
+};
+
+namespace
+{
+const uint32_t BIN_COUNT = 16;
+// nodes with more objects than this bin them on the thread pool
+const uint32_t PARALLEL_BINNING_THRESHOLD = 32 * 1024;
+const uint32_t PARALLEL_GRAIN_SIZE = 8 * 1024;
+
+struct Bin
+{
+    AABB bounds;
+    uint32_t count = 0;
+};
+
+struct NodeBounds
+{
+    AABB bounds, centroidBounds;
+
+    void merge(const NodeBounds &other)
+    {
+        bounds.extend(other.bounds);
+        centroidBounds.extend(other.centroidBounds);
+    }
+};
+
+size_t chunkCount(ThreadPool *pool, uint32_t count)
+{
+    return !pool || count < PARALLEL_BINNING_THRESHOLD
+               ? 1
+               : (count + PARALLEL_GRAIN_SIZE - 1) / PARALLEL_GRAIN_SIZE;
+}
+
+// Runs body(first, last, chunk) over [0, count) in chunkCount(pool, count) chunks, on the
+// pool when large enough.
+template <typename Body>
+void forChunks(ThreadPool *pool, uint32_t count, const Body &body)
+{
+    if (chunkCount(pool, count) == 1)
+    {
+        body(0, count, 0);
+        return;
+    }
+    pool->parallelFor(0, count, PARALLEL_GRAIN_SIZE, [&](size_t first, size_t last) {
+        body(first, last, first / PARALLEL_GRAIN_SIZE);
+    });
+}
+} // namespace
+
+float intersectRayAABB(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                       const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float maxT)
+{
+    const glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    const glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+    const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxT));
+    return enter <= exit ? enter : -1.f;
+}
+
+void BVH::build(const std::vector<AABB> &boxes, ThreadPool *pool)
+{
+    m_ObjectBounds = boxes;
+    m_ObjectIndices.resize(boxes.size());
+    std::iota(begin(m_ObjectIndices), end(m_ObjectIndices), 0u);
+    m_Nodes.clear();
+    m_nDepth = 0;
+    if (boxes.empty())
+    {
+        return;
+    }
+
+    std::vector<BuildObject> objects(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        objects[i] = BuildObject{boxes[i].min, uint32_t(i), boxes[i].max, 0};
+    }
+    // a binary tree with at least one object per leaf
+    m_Nodes.reserve(2 * boxes.size() - 1);
+    m_Nodes.emplace_back();
+    buildNode(0, 0, uint32_t(boxes.size()), 1, objects.data(), pool);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        m_ObjectIndices[i] = objects[i].index;
+    }
+}
+
+void BVH::buildNode(uint32_t node, uint32_t first, uint32_t count, uint32_t depth,
+                    BuildObject *buildObjects, ThreadPool *pool)
+{
+    m_nDepth = std::max<size_t>(m_nDepth, depth);
+    BuildObject *objects = buildObjects + first;
+
+    const auto computeBounds = [&](size_t begin, size_t end, NodeBounds &bounds) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            bounds.bounds.extend(AABB(objects[i].boundsMin, objects[i].boundsMax));
+            bounds.centroidBounds.extend(objects[i].centroid());
+        }
+    };
+    const size_t chunks = chunkCount(pool, count);
+    NodeBounds nodeBounds;
+    if (chunks == 1)
+    {
+        computeBounds(0, count, nodeBounds);
+    }
+    else
+    {
+        std::vector<NodeBounds> chunkBounds(chunks);
+        forChunks(pool, count, [&](size_t begin, size_t end, size_t chunk) {
+            computeBounds(begin, end, chunkBounds[chunk]);
+        });
+        for (const auto &bounds : chunkBounds)
+        {
+            nodeBounds.merge(bounds);
+        }
+    }
+    m_Nodes[node].boundsMin = nodeBounds.bounds.min;
+    m_Nodes[node].boundsMax = nodeBounds.bounds.max;
+
+    const auto makeLeaf = [&]() {
+        m_Nodes[node].rightOrFirst = first;
+        m_Nodes[node].count = count;
+    };
+    const glm::vec3 centroidMin = nodeBounds.centroidBounds.min;
+    const glm::vec3 centroidSize = nodeBounds.centroidBounds.max - centroidMin;
+    if (count <= 2 || depth >= MAX_DEPTH ||
+        (centroidSize.x <= 0.f && centroidSize.y <= 0.f && centroidSize.z <= 0.f))
+    {
+        makeLeaf();
+        return;
+    }
+
+    // bin the centroids on the three axes
+    const glm::vec3 binScale =
+        glm::vec3(float(BIN_COUNT)) / glm::max(centroidSize, glm::vec3(1e-30f));
+    const auto binIndex = [&](const glm::vec3 &centroid, int axis) {
+        const float bin = (centroid[axis] - centroidMin[axis]) * binScale[axis];
+        return std::min(BIN_COUNT - 1, uint32_t(std::max(0.f, bin)));
+    };
+    using Bins = std::array<Bin, 3 * BIN_COUNT>;
+    const auto fillBins = [&](size_t begin, size_t end, Bins &bins) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const AABB bounds(objects[i].boundsMin, objects[i].boundsMax);
+            const auto centroid = objects[i].centroid();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                auto &bin = bins[axis * BIN_COUNT + binIndex(centroid, axis)];
+                bin.bounds.extend(bounds);
+                ++bin.count;
+            }
+        }
+    };
+    Bins bins;
+    if (chunks == 1)
+    {
+        fillBins(0, count, bins);
+    }
+    else
+    {
+        std::vector<Bins> chunkBins(chunks);
+        forChunks(pool, count, [&](size_t begin, size_t end, size_t chunk) {
+            fillBins(begin, end, chunkBins[chunk]);
+        });
+        for (const auto &chunk : chunkBins)
+        {
+            for (size_t i = 0; i < bins.size(); ++i)
+            {
+                bins[i].bounds.extend(chunk[i].bounds);
+                bins[i].count += chunk[i].count;
+            }
+        }
+    }
+
+    // SAH: cost of a split is the sum over children of area * count, relative to the parent
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (centroidSize[axis] <= 0.f)
+        {
+            continue;
+        }
+        const Bin *axisBins = &bins[axis * BIN_COUNT];
+        float rightCosts[BIN_COUNT];
+        AABB rightBounds;
+        uint32_t rightCount = 0;
+        for (uint32_t split = BIN_COUNT - 1; split > 0; --split)
+        {
+            rightBounds.extend(axisBins[split].bounds);
+            rightCount += axisBins[split].count;
+            rightCosts[split] = rightCount * rightBounds.surfaceArea();
+        }
+        AABB leftBounds;
+        uint32_t leftCount = 0;
+        for (uint32_t split = 1; split < BIN_COUNT; ++split)
+        {
+            leftBounds.extend(axisBins[split - 1].bounds);
+            leftCount += axisBins[split - 1].count;
+            const float cost = leftCount * leftBounds.surfaceArea() + rightCosts[split];
+            if (leftCount > 0 && leftCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    // one traversal step costs about one object test
+    const float area = nodeBounds.bounds.surfaceArea();
+    const float leafCost = float(count) * area;
+    const float splitCost = area + bestCost;
+    if (bestAxis < 0 || (splitCost >= leafCost && count <= MAX_LEAF_SIZE))
+    {
+        makeLeaf();
+        return;
+    }
+
+    const auto middle = std::partition(objects, objects + count, [&](const BuildObject &object) {
+        return binIndex(object.centroid(), bestAxis) < bestSplit;
+    });
+    const uint32_t leftCount = uint32_t(middle - objects);
+
+    const uint32_t left = uint32_t(m_Nodes.size());
+    m_Nodes.emplace_back();
+    buildNode(left, first, leftCount, depth + 1, buildObjects, pool);
+    const uint32_t right = uint32_t(m_Nodes.size());
+    m_Nodes.emplace_back();
+    buildNode(right, first + leftCount, count - leftCount, depth + 1, buildObjects, pool);
+    m_Nodes[node].rightOrFirst = right;
+    m_Nodes[node].count = 0;
+}
+
+void BVH::refit(const std::vector<AABB> &boxes)
+{
+    m_ObjectBounds = boxes;
+    // children are stored after their parent
+    for (size_t i = m_Nodes.size(); i-- > 0;)
+    {
+        auto &node = m_Nodes[i];
+        AABB bounds;
+        if (node.isLeaf())
+        {
+            for (uint32_t j = node.rightOrFirst; j < node.rightOrFirst + node.count; ++j)
+            {
+                bounds.extend(m_ObjectBounds[m_ObjectIndices[j]]);
+            }
+        }
+        else
+        {
+            const auto &left = m_Nodes[i + 1];
+            const auto &right = m_Nodes[node.rightOrFirst];
+            bounds = AABB(glm::min(left.boundsMin, right.boundsMin),
+                          glm::max(left.boundsMax, right.boundsMax));
+        }
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+    }
+}
+
+void BVH::appendSubtree(uint32_t node, std::vector<uint32_t> &visible) const
+{
+    // the objects of a subtree are contiguous: from its leftmost to its rightmost leaf
+    uint32_t leftmost = node, rightmost = node;
+    while (!m_Nodes[leftmost].isLeaf())
+    {
+        leftmost = leftmost + 1;
+    }
+    while (!m_Nodes[rightmost].isLeaf())
+    {
+        rightmost = m_Nodes[rightmost].rightOrFirst;
+    }
+    visible.insert(end(visible), begin(m_ObjectIndices) + m_Nodes[leftmost].rightOrFirst,
+                   begin(m_ObjectIndices) + m_Nodes[rightmost].rightOrFirst +
+                       m_Nodes[rightmost].count);
+}
+
+void BVH::cull(const Frustum &frustum, std::vector<uint32_t> &visible) const
+{
+    visible.clear();
+    if (m_Nodes.empty())
+    {
+        return;
+    }
+
+    // returns false when outside, clears the planes the box is fully inside of
+    const auto test = [&](const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                          uint32_t &planeMask) {
+        const glm::vec3 center = .5f * (boundsMin + boundsMax);
+        const glm::vec3 extent = .5f * (boundsMax - boundsMin);
+        for (uint32_t plane = 0; plane < 6; ++plane)
+        {
+            if (!(planeMask & (1u << plane)))
+            {
+                continue;
+            }
+            const auto &p = frustum.planes[plane];
+            const float distance = glm::dot(glm::vec3(p), center) + p.w;
+            const float radius = glm::dot(glm::abs(glm::vec3(p)), extent);
+            if (distance + radius < 0.f)
+            {
+                return false;
+            }
+            if (distance - radius >= 0.f)
+            {
+                planeMask &= ~(1u << plane);
+            }
+        }
+        return true;
+    };
+
+    std::pair<uint32_t, uint32_t> stack[MAX_DEPTH + 1];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {0u, 0x3Fu};
+    while (stackSize > 0)
+    {
+        const auto entry = stack[--stackSize];
+        const auto &node = m_Nodes[entry.first];
+        uint32_t planeMask = entry.second;
+        if (!test(node.boundsMin, node.boundsMax, planeMask))
+        {
+            continue;
+        }
+        if (planeMask == 0)
+        {
+            appendSubtree(entry.first, visible);
+        }
+        else if (node.isLeaf())
+        {
+            for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; ++i)
+            {
+                const auto object = m_ObjectIndices[i];
+                uint32_t objectMask = planeMask;
+                if (test(m_ObjectBounds[object].min, m_ObjectBounds[object].max, objectMask))
+                {
+                    visible.push_back(object);
+                }
+            }
+        }
+        else
+        {
+            stack[stackSize++] = {node.rightOrFirst, planeMask};
+            stack[stackSize++] = {entry.first + 1, planeMask};
+        }
+    }
+}
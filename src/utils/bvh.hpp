@@ -0,0 +1,167 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "frustum.hpp"
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// 32 bytes, two per cache line. Nodes are stored depth first: the left child of an interior
+// node directly follows it, so only the right child index is stored.
+struct BVHNode
+{
+    glm::vec3 boundsMin;
+    uint32_t rightOrFirst; // right child when interior, first entry of objectIndices when leaf
+    glm::vec3 boundsMax;
+    uint32_t count;        // objects in the leaf, 0 for interior nodes
+
+    bool isLeaf() const { return count != 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode should stay 32 bytes");
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct RayHit
+{
+    uint32_t object = ~0u;
+    float t = FLT_MAX;
+};
+
+// Slab test, returns the entry distance or -1 when the ray misses the box before maxT.
+float intersectRayAABB(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                       const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float maxT);
+
+// Bounding volume hierarchy over object boxes, built with a binned surface area heuristic.
+class BVH
+{
+public:
+    static const uint32_t MAX_DEPTH = 64;
+    // nodes are split until SAH finds splitting more expensive, but never kept above this
+    static const uint32_t MAX_LEAF_SIZE = 8;
+
+    // Large nodes bin their objects in parallel on the pool when one is given.
+    void build(const std::vector<AABB> &boxes, ThreadPool *pool = nullptr);
+    // Updates the node bounds after objects moved, keeping the topology: quality degrades
+    // with large motions, rebuild then.
+    void refit(const std::vector<AABB> &boxes);
+
+    // Indices of the objects whose box intersects the frustum. Subtrees fully inside a plane
+    // stop testing it, subtrees fully inside the frustum are appended without tests.
+    void cull(const Frustum &frustum, std::vector<uint32_t> &visible) const;
+
+    // Nearest object box hit by the ray.
+    bool raycast(const Ray &ray, RayHit &hit) const
+    {
+        return raycast(ray, hit, [](uint32_t, float boxT) { return boxT; });
+    }
+    // Nearest hit of an exact object test: intersect(object, boxT) returns the hit distance
+    // along the ray or a negative value on a miss. Objects are visited when their box is
+    // closer than the current hit.
+    template <typename Intersect>
+    bool raycast(const Ray &ray, RayHit &hit, const Intersect &intersect) const;
+
+    const std::vector<BVHNode> &nodes() const { return m_Nodes; }
+    size_t objectCount() const { return m_ObjectIndices.size(); }
+    size_t depth() const { return m_nDepth; }
+
+private:
+    struct BuildObject;
+
+    void buildNode(uint32_t node, uint32_t first, uint32_t count, uint32_t depth,
+                   BuildObject *buildObjects, ThreadPool *pool);
+    void appendSubtree(uint32_t node, std::vector<uint32_t> &visible) const;
+
+    std::vector<BVHNode> m_Nodes;
+    std::vector<uint32_t> m_ObjectIndices;
+    std::vector<AABB> m_ObjectBounds; // per object index, copied at build and refit
+    size_t m_nDepth = 0;
+};
+
+template <typename Intersect>
+bool BVH::raycast(const Ray &ray, RayHit &hit, const Intersect &intersect) const
+{
+    if (m_Nodes.empty())
+    {
+        return false;
+    }
+    const glm::vec3 inverseDirection = 1.f / ray.direction;
+    bool found = false;
+    // pending far children with their entry distance, depth is capped at build
+    uint32_t stack[MAX_DEPTH];
+    float stackT[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    uint32_t node = 0;
+    if (intersectRayAABB(ray.origin, inverseDirection, m_Nodes[0].boundsMin, m_Nodes[0].boundsMax,
+                         hit.t) < 0.f)
+    {
+        return false;
+    }
+    for (;;)
+    {
+        const auto &current = m_Nodes[node];
+        if (current.isLeaf())
+        {
+            for (uint32_t i = current.rightOrFirst; i < current.rightOrFirst + current.count; ++i)
+            {
+                const auto object = m_ObjectIndices[i];
+                const auto &box = m_ObjectBounds[object];
+                const float boxT =
+                    intersectRayAABB(ray.origin, inverseDirection, box.min, box.max, hit.t);
+                if (boxT < 0.f)
+                {
+                    continue;
+                }
+                const float t = intersect(object, boxT);
+                if (t >= 0.f && t < hit.t)
+                {
+                    hit.t = t;
+                    hit.object = object;
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            // nearest child first, the other one is only visited if still closer than the hit
+            uint32_t nearChild = node + 1, farChild = current.rightOrFirst;
+            float nearT = intersectRayAABB(ray.origin, inverseDirection, m_Nodes[nearChild].boundsMin,
+                                           m_Nodes[nearChild].boundsMax, hit.t);
+            float farT = intersectRayAABB(ray.origin, inverseDirection, m_Nodes[farChild].boundsMin,
+                                          m_Nodes[farChild].boundsMax, hit.t);
+            if (farT >= 0.f && (nearT < 0.f || farT < nearT))
+            {
+                std::swap(nearChild, farChild);
+                std::swap(nearT, farT);
+            }
+            if (nearT >= 0.f)
+            {
+                if (farT >= 0.f)
+                {
+                    stack[stackSize] = farChild;
+                    stackT[stackSize++] = farT;
+                }
+                node = nearChild;
+                continue;
+            }
+        }
+        // skip the pending children a closer hit made useless
+        while (stackSize > 0 && stackT[stackSize - 1] > hit.t)
+        {
+            --stackSize;
+        }
+        if (stackSize == 0)
+        {
+            return found;
+        }
+        node = stack[--stackSize];
+    }
+}
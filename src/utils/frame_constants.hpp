@@ -0,0 +1,37 @@
+#pragma once
+
+#include "std140.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform buffer binding shared by every program, see the FrameConstants block in src/shaders/.
+const GLuint FRAME_CONSTANTS_BINDING = 0;
+
+// C++ mirror of:
+// layout(std140, binding = 0) uniform FrameConstants
+// {
+//     mat4 view;
+//     mat4 projection;
+//     mat4 viewProj;
+//     vec3 cameraPosition;
+//     float time;
+//     vec2 viewport;
+// };
+struct FrameConstants
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProj;
+    glm::vec3 cameraPosition;
+    float time;
+    glm::vec2 viewport;
+    glm::vec2 padding;
+};
+
+STD140_FIRST_MEMBER(FrameConstants, view);
+STD140_MEMBER_AFTER(FrameConstants, projection, view);
+STD140_MEMBER_AFTER(FrameConstants, viewProj, projection);
+STD140_MEMBER_AFTER(FrameConstants, cameraPosition, viewProj);
+STD140_MEMBER_AFTER(FrameConstants, time, cameraPosition);
+STD140_MEMBER_AFTER(FrameConstants, viewport, time);
+STD140_BLOCK_SIZE(FrameConstants);
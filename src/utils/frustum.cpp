@@ -0,0 +1,242 @@
+#include "frustum.hpp"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint32_t countTrailingZeros(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctz(mask));
+#endif
+}
+
+Frustum extractFrustum(const glm::mat4 &viewProj)
+{
+    const glm::mat4 rows = glm::transpose(viewProj);
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    for (auto &plane : frustum.planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+bool intersects(const Frustum &frustum, const AABB &box)
+{
+    const auto center = box.center();
+    const auto extent = box.extent();
+    for (const auto &plane : frustum.planes)
+    {
+        const glm::vec3 normal(plane);
+        // distance of the box's most inward corner
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool intersects(const Frustum &frustum, const glm::vec3 &center, float radius)
+{
+    for (const auto &plane : frustum.planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AABBSoA::clear()
+{
+    for (auto array : {&m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ})
+    {
+        array->clear();
+    }
+    m_nCount = 0;
+}
+
+void AABBSoA::reserve(size_t count)
+{
+    const size_t padded = (count + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+    for (auto array : {&m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ})
+    {
+        array->reserve(padded);
+    }
+}
+
+void AABBSoA::push(const AABB &box)
+{
+    if (m_nCount == m_CenterX.size())
+    {
+        // a whole batch at once: SIMD loads never read past the end
+        for (auto array : {&m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ})
+        {
+            array->resize(m_nCount + BATCH_SIZE, 0.f);
+        }
+    }
+    set(m_nCount++, box);
+}
+
+void AABBSoA::set(size_t index, const AABB &box)
+{
+    const auto center = box.center();
+    const auto extent = box.extent();
+    m_CenterX[index] = center.x;
+    m_CenterY[index] = center.y;
+    m_CenterZ[index] = center.z;
+    m_ExtentX[index] = extent.x;
+    m_ExtentY[index] = extent.y;
+    m_ExtentZ[index] = extent.z;
+}
+
+void cullAABBsScalar(const Frustum &frustum, const AABBSoA &boxes, std::vector<uint32_t> &visible)
+{
+    visible.clear();
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        bool inside = true;
+        for (const auto &plane : frustum.planes)
+        {
+            // same evaluation order as the SIMD paths, so they agree on boundary cases
+            const float distance = (plane.x * boxes.centerX()[i] + plane.y * boxes.centerY()[i]) +
+                                   (plane.z * boxes.centerZ()[i] + plane.w);
+            const float radius = (std::abs(plane.x) * boxes.extentX()[i] +
+                                  std::abs(plane.y) * boxes.extentY()[i]) +
+                                 std::abs(plane.z) * boxes.extentZ()[i];
+            if (distance + radius < 0.f)
+            {
+                inside = false;
+                break;
+            }
+        }
+        if (inside)
+        {
+            visible.push_back(uint32_t(i));
+        }
+    }
+}
+
+#if defined(__AVX__)
+
+void cullAABBs(const Frustum &frustum, const AABBSoA &boxes, std::vector<uint32_t> &visible)
+{
+    const size_t count = boxes.size();
+    visible.resize(count);
+    uint32_t *out = visible.data();
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t i = 0; i < count; i += 8)
+    {
+        const __m256 cx = _mm256_loadu_ps(boxes.centerX() + i);
+        const __m256 cy = _mm256_loadu_ps(boxes.centerY() + i);
+        const __m256 cz = _mm256_loadu_ps(boxes.centerZ() + i);
+        const __m256 ex = _mm256_loadu_ps(boxes.extentX() + i);
+        const __m256 ey = _mm256_loadu_ps(boxes.extentY() + i);
+        const __m256 ez = _mm256_loadu_ps(boxes.extentZ() + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto &plane : frustum.planes)
+        {
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx),
+                              _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz),
+                              _mm256_set1_ps(plane.w)));
+            const __m256 radius = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex),
+                              _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey)),
+                _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+            inside = _mm256_and_ps(
+                inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+        uint32_t mask = uint32_t(_mm256_movemask_ps(inside));
+        if (count - i < 8)
+        {
+            mask &= (1u << (count - i)) - 1;
+        }
+        while (mask)
+        {
+            *out++ = uint32_t(i) + countTrailingZeros(mask);
+            mask &= mask - 1;
+        }
+    }
+    visible.resize(size_t(out - visible.data()));
+}
+
+const char *cullingInstructionSet() { return "AVX"; }
+
+#elif defined(FRUSTUM_SSE2)
+
+void cullAABBs(const Frustum &frustum, const AABBSoA &boxes, std::vector<uint32_t> &visible)
+{
+    const size_t count = boxes.size();
+    visible.resize(count);
+    uint32_t *out = visible.data();
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < count; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(boxes.centerX() + i);
+        const __m128 cy = _mm_loadu_ps(boxes.centerY() + i);
+        const __m128 cz = _mm_loadu_ps(boxes.centerZ() + i);
+        const __m128 ex = _mm_loadu_ps(boxes.extentX() + i);
+        const __m128 ey = _mm_loadu_ps(boxes.extentY() + i);
+        const __m128 ez = _mm_loadu_ps(boxes.extentZ() + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto &plane : frustum.planes)
+        {
+            const __m128 distance =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+                                      _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                           _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+            const __m128 radius =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex),
+                                      _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+                           _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+        uint32_t mask = uint32_t(_mm_movemask_ps(inside));
+        if (count - i < 4)
+        {
+            mask &= (1u << (count - i)) - 1;
+        }
+        while (mask)
+        {
+            *out++ = uint32_t(i) + countTrailingZeros(mask);
+            mask &= mask - 1;
+        }
+    }
+    visible.resize(size_t(out - visible.data()));
+}
+
+const char *cullingInstructionSet() { return "SSE2"; }
+
+#else
+
+void cullAABBs(const Frustum &frustum, const AABBSoA &boxes, std::vector<uint32_t> &visible)
+{
+    cullAABBsScalar(frustum, boxes, visible);
+}
+
+const char *cullingInstructionSet() { return "scalar"; }
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bounds.hpp"
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Six planes (left, right, bottom, top, near, far) with inward normals:
+// a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Gribb & Hartmann extraction from a projection * view matrix (GL clip space),
+// planes are normalized so plane distances are world distances.
+Frustum extractFrustum(const glm::mat4 &viewProj);
+
+// Conservative: boxes crossing the corner of two planes may be reported visible.
+bool intersects(const Frustum &frustum, const AABB &box);
+bool intersects(const Frustum &frustum, const glm::vec3 &center, float radius);
+
+// Boxes as centers and half extents in structure of arrays, padded to whole SIMD batches.
+class AABBSoA
+{
+public:
+    static const size_t BATCH_SIZE = 8;
+
+    void clear();
+    void reserve(size_t count);
+    void push(const AABB &box);
+    void set(size_t index, const AABB &box);
+
+    size_t size() const { return m_nCount; }
+    const float *centerX() const { return m_CenterX.data(); }
+    const float *centerY() const { return m_CenterY.data(); }
+    const float *centerZ() const { return m_CenterZ.data(); }
+    const float *extentX() const { return m_ExtentX.data(); }
+    const float *extentY() const { return m_ExtentY.data(); }
+    const float *extentZ() const { return m_ExtentZ.data(); }
+
+private:
+    std::vector<float> m_CenterX, m_CenterY, m_CenterZ;
+    std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+    size_t m_nCount = 0;
+};
+
+// Writes the indices of the boxes intersecting the frustum to visible, in increasing order.
+// Uses AVX (8 boxes per iteration) when built with it, SSE2 (4 boxes) otherwise on x86.
+void cullAABBs(const Frustum &frustum, const AABBSoA &boxes, std::vector<uint32_t> &visible);
+// Reference implementation, one box at a time.
+void cullAABBsScalar(const Frustum &frustum, const AABBSoA &boxes, std::vector<uint32_t> &visible);
+// Instruction set used by cullAABBs.
+const char *cullingInstructionSet();
@@ -0,0 +1,302 @@
+#pragma once
+
+#include "vertex_layout.hpp"
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// RAII owners of GL objects, created and edited with direct state access only:
+// nothing is bound to create or update them.
+
+// Levels of a full mip chain.
+inline GLsizei mipLevelCount(GLsizei width, GLsizei height)
+{
+    return GLsizei(std::floor(std::log2(float(std::max(width, height))))) + 1;
+}
+
+// Bytes of one level of a 2D image, 0 for formats this code doesn't create. RGB formats are
+// counted at 3 bytes per texel although drivers may pad them to 4, block compressed formats
+// by whole 4x4 blocks.
+inline size_t textureLevelBytes(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    const size_t blocks = size_t((width + 3) / 4) * size_t((height + 3) / 4);
+    size_t texelBytes = 0;
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        return blocks * 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return blocks * 16;
+    case GL_R8:
+        texelBytes = 1;
+        break;
+    case GL_RG8:
+        texelBytes = 2;
+        break;
+    case GL_RGB8:
+    case GL_SRGB8:
+        texelBytes = 3;
+        break;
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_R32F:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+        texelBytes = 4;
+        break;
+    case GL_RGBA16F:
+        texelBytes = 8;
+        break;
+    case GL_RGBA32F:
+        texelBytes = 16;
+        break;
+    }
+    return texelBytes * size_t(width) * size_t(height);
+}
+
+class GLBuffer
+{
+    GLuint m_GLId = 0;
+    GLsizeiptr m_nSize = 0;
+
+public:
+    GLBuffer() { glCreateBuffers(1, &m_GLId); }
+    // Immutable storage, flags as for glNamedBufferStorage.
+    GLBuffer(GLsizeiptr size, const void *data, GLbitfield flags = 0) : GLBuffer()
+    {
+        storage(size, data, flags);
+    }
+
+    ~GLBuffer() { glDeleteBuffers(1, &m_GLId); }
+
+    GLBuffer(const GLBuffer &) = delete;
+    GLBuffer &operator=(const GLBuffer &) = delete;
+    GLBuffer(GLBuffer &&rvalue) : m_GLId(rvalue.m_GLId), m_nSize(rvalue.m_nSize)
+    {
+        rvalue.m_GLId = 0;
+    }
+    GLBuffer &operator=(GLBuffer &&rvalue)
+    {
+        std::swap(m_GLId, rvalue.m_GLId);
+        std::swap(m_nSize, rvalue.m_nSize);
+        return *this;
+    }
+
+    GLuint glId() const { return m_GLId; }
+    GLsizeiptr size() const { return m_nSize; }
+
+    void storage(GLsizeiptr size, const void *data, GLbitfield flags)
+    {
+        glNamedBufferStorage(m_GLId, size, data, flags);
+        m_nSize = size;
+    }
+    // Mutable storage, reallocated on every call.
+    void setData(GLsizeiptr size, const void *data, GLenum usage)
+    {
+        glNamedBufferData(m_GLId, size, data, usage);
+        m_nSize = size;
+    }
+    void setSubData(GLintptr offset, GLsizeiptr size, const void *data)
+    {
+        glNamedBufferSubData(m_GLId, offset, size, data);
+    }
+    void *map(GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        return glMapNamedBufferRange(m_GLId, offset, length, access);
+    }
+    bool unmap() { return glUnmapNamedBuffer(m_GLId) == GL_TRUE; }
+};
+
+class GLTexture
+{
+    GLuint m_GLId = 0;
+    GLenum m_Target = GL_NONE;
+    GLenum m_InternalFormat = GL_NONE;
+    GLsizei m_nWidth = 0, m_nHeight = 0, m_nDepth = 0, m_nLevels = 0;
+    size_t m_nStorageBytes = 0;
+
+    // storage of every live texture, GL thread only like everything else here
+    static size_t &allocatedBytesCounter()
+    {
+        static size_t bytes = 0;
+        return bytes;
+    }
+
+public:
+    // Empty, owns nothing until a texture is moved in.
+    GLTexture() = default;
+    explicit GLTexture(GLenum target) : m_Target(target) { glCreateTextures(target, 1, &m_GLId); }
+
+    ~GLTexture()
+    {
+        glDeleteTextures(1, &m_GLId);
+        allocatedBytesCounter() -= m_nStorageBytes;
+    }
+
+    GLTexture(const GLTexture &) = delete;
+    GLTexture &operator=(const GLTexture &) = delete;
+    GLTexture(GLTexture &&rvalue)
+        : m_GLId(rvalue.m_GLId), m_Target(rvalue.m_Target),
+          m_InternalFormat(rvalue.m_InternalFormat), m_nWidth(rvalue.m_nWidth),
+          m_nHeight(rvalue.m_nHeight), m_nDepth(rvalue.m_nDepth), m_nLevels(rvalue.m_nLevels),
+          m_nStorageBytes(rvalue.m_nStorageBytes)
+    {
+        rvalue.m_GLId = 0;
+        rvalue.m_nStorageBytes = 0;
+    }
+    GLTexture &operator=(GLTexture &&rvalue)
+    {
+        std::swap(m_GLId, rvalue.m_GLId);
+        std::swap(m_Target, rvalue.m_Target);
+        std::swap(m_InternalFormat, rvalue.m_InternalFormat);
+        std::swap(m_nWidth, rvalue.m_nWidth);
+        std::swap(m_nHeight, rvalue.m_nHeight);
+        std::swap(m_nDepth, rvalue.m_nDepth);
+        std::swap(m_nLevels, rvalue.m_nLevels);
+        std::swap(m_nStorageBytes, rvalue.m_nStorageBytes);
+        return *this;
+    }
+
+    GLuint glId() const { return m_GLId; }
+    GLenum target() const { return m_Target; }
+    GLenum internalFormat() const { return m_InternalFormat; }
+    GLsizei width() const { return m_nWidth; }
+    GLsizei height() const { return m_nHeight; }
+    GLsizei depth() const { return m_nDepth; }
+    GLsizei levels() const { return m_nLevels; }
+    // GPU memory of the immutable storage, every level and layer
+    size_t storageBytes() const { return m_nStorageBytes; }
+    // Storage of all the textures alive, for memory budgets.
+    static size_t allocatedBytes() { return allocatedBytesCounter(); }
+
+    void storage2D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height)
+    {
+        glTextureStorage2D(m_GLId, levels, internalFormat, width, height);
+        setStorage(levels, internalFormat, width, height, 1);
+    }
+    void storage3D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height,
+                   GLsizei depth)
+    {
+        glTextureStorage3D(m_GLId, levels, internalFormat, width, height, depth);
+        setStorage(levels, internalFormat, width, height, depth);
+    }
+    void subImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,
+                    GLenum type, const void *pixels)
+    {
+        glTextureSubImage2D(m_GLId, level, x, y, width, height, format, type, pixels);
+    }
+    void subImage3D(GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height,
+                    GLsizei depth, GLenum format, GLenum type, const void *pixels)
+    {
+        glTextureSubImage3D(m_GLId, level, x, y, z, width, height, depth, format, type, pixels);
+    }
+    void compressedSubImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+                              GLenum format, GLsizei size, const void *data)
+    {
+        glCompressedTextureSubImage2D(m_GLId, level, x, y, width, height, format, size, data);
+    }
+    void generateMipmap() { glGenerateTextureMipmap(m_GLId); }
+    void setParameter(GLenum name, GLint value) { glTextureParameteri(m_GLId, name, value); }
+    void setParameter(GLenum name, GLfloat value) { glTextureParameterf(m_GLId, name, value); }
+
+private:
+    void setStorage(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height,
+                    GLsizei depth)
+    {
+        m_nLevels = levels;
+        m_InternalFormat = internalFormat;
+        m_nWidth = width;
+        m_nHeight = height;
+        m_nDepth = depth;
+        allocatedBytesCounter() -= m_nStorageBytes;
+        m_nStorageBytes = 0;
+        for (GLsizei level = 0; level < levels; ++level)
+        {
+            m_nStorageBytes += textureLevelBytes(internalFormat, std::max(width >> level, 1),
+                                                 std::max(height >> level, 1)) *
+                               size_t(m_Target == GL_TEXTURE_3D ? std::max(depth >> level, 1)
+                                                                : depth);
+        }
+        allocatedBytesCounter() += m_nStorageBytes;
+    }
+};
+
+class GLVertexArray
+{
+    GLuint m_GLId = 0;
+
+public:
+    GLVertexArray() { glCreateVertexArrays(1, &m_GLId); }
+
+    ~GLVertexArray() { glDeleteVertexArrays(1, &m_GLId); }
+
+    GLVertexArray(const GLVertexArray &) = delete;
+    GLVertexArray &operator=(const GLVertexArray &) = delete;
+    GLVertexArray(GLVertexArray &&rvalue) : m_GLId(rvalue.m_GLId) { rvalue.m_GLId = 0; }
+    GLVertexArray &operator=(GLVertexArray &&rvalue)
+    {
+        std::swap(m_GLId, rvalue.m_GLId);
+        return *this;
+    }
+
+    GLuint glId() const { return m_GLId; }
+
+    template <typename V>
+    void setLayout(GLuint binding)
+    {
+        applyVertexLayout<V>(m_GLId, binding);
+    }
+    void setVertexBuffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+    {
+        glVertexArrayVertexBuffer(m_GLId, binding, buffer, offset, stride);
+    }
+    void setBindingDivisor(GLuint binding, GLuint divisor)
+    {
+        glVertexArrayBindingDivisor(m_GLId, binding, divisor);
+    }
+    void setElementBuffer(GLuint buffer) { glVertexArrayElementBuffer(m_GLId, buffer); }
+};
+
+class GLFramebuffer
+{
+    GLuint m_GLId = 0;
+
+public:
+    GLFramebuffer() { glCreateFramebuffers(1, &m_GLId); }
+
+    ~GLFramebuffer() { glDeleteFramebuffers(1, &m_GLId); }
+
+    GLFramebuffer(const GLFramebuffer &) = delete;
+    GLFramebuffer &operator=(const GLFramebuffer &) = delete;
+    GLFramebuffer(GLFramebuffer &&rvalue) : m_GLId(rvalue.m_GLId) { rvalue.m_GLId = 0; }
+    GLFramebuffer &operator=(GLFramebuffer &&rvalue)
+    {
+        std::swap(m_GLId, rvalue.m_GLId);
+        return *this;
+    }
+
+    GLuint glId() const { return m_GLId; }
+
+    void attachTexture(GLenum attachment, const GLTexture &texture, GLint level = 0)
+    {
+        glNamedFramebufferTexture(m_GLId, attachment, texture.glId(), level);
+    }
+    void attachTextureLayer(GLenum attachment, const GLTexture &texture, GLint level, GLint layer)
+    {
+        glNamedFramebufferTextureLayer(m_GLId, attachment, texture.glId(), level, layer);
+    }
+    void setDrawBuffers(const std::vector<GLenum> &buffers)
+    {
+        glNamedFramebufferDrawBuffers(m_GLId, GLsizei(buffers.size()), buffers.data());
+    }
+    bool isComplete() const
+    {
+        return glCheckNamedFramebufferStatus(m_GLId, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+};
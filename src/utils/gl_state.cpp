@@ -0,0 +1,148 @@
+#include "gl_state.hpp"
+
+GLStateCache::GLStateCache()
+{
+    GLint textureUnits = 0;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &textureUnits);
+    m_Textures.resize(textureUnits);
+    m_Samplers.resize(textureUnits);
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (change(m_Program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (change(m_VertexArray, vao))
+    {
+        glBindVertexArray(vao);
+    }
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLuint texture)
+{
+    if (change(m_Textures[unit], texture))
+    {
+        glBindTextureUnit(unit, texture);
+    }
+}
+
+void GLStateCache::bindSampler(GLuint unit, GLuint sampler)
+{
+    if (change(m_Samplers[unit], sampler))
+    {
+        glBindSampler(unit, sampler);
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    if (change(m_Buffers[target], buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset,
+                                   GLsizeiptr size)
+{
+    auto &bindings = m_IndexedBuffers[target];
+    if (index >= bindings.size())
+    {
+        bindings.resize(index + 1);
+    }
+    if (change(bindings[index], BufferRange{buffer, offset, size}))
+    {
+        glBindBufferRange(target, index, buffer, offset, size);
+        // binding an indexed target also changes its generic binding point
+        m_Buffers[target] = Cached<GLuint>{buffer, true};
+    }
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    auto &bindings = m_IndexedBuffers[target];
+    if (index >= bindings.size())
+    {
+        bindings.resize(index + 1);
+    }
+    // a zero size stands for the whole buffer
+    if (change(bindings[index], BufferRange{buffer, 0, 0}))
+    {
+        glBindBufferBase(target, index, buffer);
+        m_Buffers[target] = Cached<GLuint>{buffer, true};
+    }
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled)
+{
+    if (change(m_Capabilities[capability], enabled))
+    {
+        if (enabled)
+        {
+            glEnable(capability);
+        }
+        else
+        {
+            glDisable(capability);
+        }
+    }
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if (change(m_DepthFunc, func))
+    {
+        glDepthFunc(func);
+    }
+}
+
+void GLStateCache::depthMask(bool writeEnabled)
+{
+    if (change(m_DepthMask, writeEnabled))
+    {
+        glDepthMask(writeEnabled ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GLStateCache::blendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+    if (change(m_BlendFunc, std::make_pair(sourceFactor, destinationFactor)))
+    {
+        glBlendFunc(sourceFactor, destinationFactor);
+    }
+}
+
+void GLStateCache::cullFace(GLenum mode)
+{
+    if (change(m_CullFace, mode))
+    {
+        glCullFace(mode);
+    }
+}
+
+void GLStateCache::invalidate()
+{
+    m_Program.known = false;
+    m_VertexArray.known = false;
+    for (auto &texture : m_Textures)
+    {
+        texture.known = false;
+    }
+    for (auto &sampler : m_Samplers)
+    {
+        sampler.known = false;
+    }
+    m_Buffers.clear();
+    m_IndexedBuffers.clear();
+    m_Capabilities.clear();
+    m_DepthFunc.known = false;
+    m_DepthMask.known = false;
+    m_BlendFunc.known = false;
+    m_CullFace.known = false;
+}
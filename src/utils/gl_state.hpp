@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+struct GLStateCounters
+{
+    size_t issued = 0;   // calls that reached the driver
+    size_t filtered = 0; // redundant calls dropped on the CPU
+};
+
+// Shadows the GL bindings and fixed function state touched by the renderer and filters
+// calls that would not change anything. Every rendering path must go through it, and
+// invalidate() must be called after code that bypasses it (ImGui backend, raw GL calls),
+// since the cache can't know what changed behind its back.
+class GLStateCache
+{
+public:
+    GLStateCache();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // glBindTextureUnit, no active texture selector involved
+    void bindTexture(GLuint unit, GLuint texture);
+    void bindSampler(GLuint unit, GLuint sampler);
+    // Non indexed buffer targets. GL_ELEMENT_ARRAY_BUFFER is VAO state and isn't cached.
+    void bindBuffer(GLenum target, GLuint buffer);
+    // Indexed targets: GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_ATOMIC_COUNTER_BUFFER...
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset,
+                         GLsizeiptr size);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    void enable(GLenum capability) { setCapability(capability, true); }
+    void disable(GLenum capability) { setCapability(capability, false); }
+    void setCapability(GLenum capability, bool enabled);
+    void depthFunc(GLenum func);
+    void depthMask(bool writeEnabled);
+    void blendFunc(GLenum sourceFactor, GLenum destinationFactor);
+    void cullFace(GLenum mode);
+
+    // Forget everything, the next call of each kind is always issued.
+    void invalidate();
+
+    void resetCounters() { m_Counters = GLStateCounters(); }
+    const GLStateCounters &counters() const { return m_Counters; }
+
+private:
+    struct BufferRange
+    {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    // every cached value has a validity flag, cleared by invalidate()
+    template <typename T>
+    struct Cached
+    {
+        T value{};
+        bool known = false;
+    };
+
+    // returns true when the call must be issued, updating the shadow value
+    template <typename T>
+    bool change(Cached<T> &cached, const T &value)
+    {
+        if (cached.known && cached.value == value)
+        {
+            ++m_Counters.filtered;
+            return false;
+        }
+        cached.value = value;
+        cached.known = true;
+        ++m_Counters.issued;
+        return true;
+    }
+
+    Cached<GLuint> m_Program;
+    Cached<GLuint> m_VertexArray;
+    std::vector<Cached<GLuint>> m_Textures;
+    std::vector<Cached<GLuint>> m_Samplers;
+    std::unordered_map<GLenum, Cached<GLuint>> m_Buffers;
+    std::unordered_map<GLenum, std::vector<Cached<BufferRange>>> m_IndexedBuffers;
+    std::unordered_map<GLenum, Cached<bool>> m_Capabilities;
+    Cached<GLenum> m_DepthFunc;
+    Cached<bool> m_DepthMask;
+    Cached<std::pair<GLenum, GLenum>> m_BlendFunc;
+    Cached<GLenum> m_CullFace;
+
+    GLStateCounters m_Counters;
+
+    friend bool operator==(const BufferRange &a, const BufferRange &b)
+    {
+        return a.buffer == b.buffer && a.offset == b.offset && a.size == b.size;
+    }
+};
@@ -0,0 +1,860 @@
+#include "gltf.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+const uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4e4f534a;
+const uint32_t GLB_CHUNK_BIN = 0x004e4942;
+
+[[noreturn]] void gltfError(const std::string &message)
+{
+    std::cerr << "glTF: " << message << std::endl;
+    throw std::runtime_error("glTF: " + message);
+}
+
+uint32_t readU32(const uint8_t *data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+size_t componentSize(uint32_t componentType)
+{
+    switch (componentType)
+    {
+    case GLTF_BYTE:
+    case GLTF_UNSIGNED_BYTE:
+        return 1;
+    case GLTF_SHORT:
+    case GLTF_UNSIGNED_SHORT:
+        return 2;
+    case GLTF_UNSIGNED_INT:
+    case GLTF_FLOAT:
+        return 4;
+    default:
+        gltfError("unknown component type " + std::to_string(componentType));
+    }
+}
+
+uint32_t componentCount(const std::string &type)
+{
+    static const std::pair<const char *, uint32_t> types[] = {
+        {"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4},
+        {"MAT2", 4},   {"MAT3", 9}, {"MAT4", 16}};
+    for (const auto &known : types)
+    {
+        if (type == known.first)
+        {
+            return known.second;
+        }
+    }
+    gltfError("unknown accessor type " + type);
+}
+
+// one component as a float, normalized integers mapped as the spec says
+float readComponent(const uint8_t *data, uint32_t componentType, bool normalized)
+{
+    switch (componentType)
+    {
+    case GLTF_BYTE:
+    {
+        const float value = float(*reinterpret_cast<const int8_t *>(data));
+        return normalized ? std::max(value / 127.f, -1.f) : value;
+    }
+    case GLTF_UNSIGNED_BYTE:
+        return normalized ? float(*data) / 255.f : float(*data);
+    case GLTF_SHORT:
+    {
+        int16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? std::max(float(value) / 32767.f, -1.f) : float(value);
+    }
+    case GLTF_UNSIGNED_SHORT:
+    {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? float(value) / 65535.f : float(value);
+    }
+    case GLTF_UNSIGNED_INT:
+        return float(readU32(data));
+    default:
+    {
+        float value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    }
+}
+
+uint32_t readIndex(const uint8_t *data, uint32_t componentType)
+{
+    switch (componentType)
+    {
+    case GLTF_UNSIGNED_BYTE:
+        return *data;
+    case GLTF_UNSIGNED_SHORT:
+    {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    case GLTF_UNSIGNED_INT:
+        return readU32(data);
+    default:
+        gltfError("indices must be unsigned integers");
+    }
+}
+
+std::vector<uint8_t> decodeBase64(const char *text, size_t size)
+{
+    std::vector<uint8_t> bytes;
+    bytes.reserve(size / 4 * 3);
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (size_t i = 0; i < size && text[i] != '='; ++i)
+    {
+        const char c = text[i];
+        int value;
+        if (c >= 'A' && c <= 'Z')
+        {
+            value = c - 'A';
+        }
+        else if (c >= 'a' && c <= 'z')
+        {
+            value = c - 'a' + 26;
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            value = c - '0' + 52;
+        }
+        else if (c == '+' || c == '-')
+        {
+            value = 62;
+        }
+        else if (c == '/' || c == '_')
+        {
+            value = 63;
+        }
+        else
+        {
+            gltfError("invalid base64 data");
+        }
+        bits = (bits << 6) | uint32_t(value);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            bytes.push_back(uint8_t(bits >> bitCount));
+        }
+    }
+    return bytes;
+}
+
+// URIs of external files are percent encoded
+std::string decodeUri(const std::string &uri)
+{
+    const auto hexDigit = [&](char c) {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        gltfError("invalid percent escape in URI " + uri);
+    };
+    std::string path;
+    for (size_t i = 0; i < uri.size(); ++i)
+    {
+        if (uri[i] == '%')
+        {
+            if (i + 2 >= uri.size())
+            {
+                gltfError("truncated percent escape in URI " + uri);
+            }
+            path += char(hexDigit(uri[i + 1]) * 16 + hexDigit(uri[i + 2]));
+            i += 2;
+        }
+        else
+        {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+// JSON numbers are doubles, converting one outside of the integer type is undefined
+size_t readSize(const JsonValue &value, size_t fallback = 0)
+{
+    if (!value.isNumber())
+    {
+        return fallback;
+    }
+    const double number = value.asNumber();
+    if (!(number >= 0.) || number != std::floor(number) ||
+        number >= std::ldexp(1., std::numeric_limits<size_t>::digits))
+    {
+        std::ostringstream message;
+        message << "invalid size or index " << number;
+        gltfError(message.str());
+    }
+    return size_t(number);
+}
+
+uint32_t readUint32(const JsonValue &value, uint32_t fallback = 0)
+{
+    const size_t number = readSize(value, fallback);
+    if (number > std::numeric_limits<uint32_t>::max())
+    {
+        gltfError("index " + std::to_string(number) + " is out of range");
+    }
+    return uint32_t(number);
+}
+
+GltfIndex readGltfIndex(const JsonValue &value)
+{
+    if (!value.isNumber())
+    {
+        return GLTF_NONE;
+    }
+    const size_t index = readSize(value);
+    if (index > size_t(std::numeric_limits<GltfIndex>::max()))
+    {
+        gltfError("index " + std::to_string(index) + " is out of range");
+    }
+    return GltfIndex(index);
+}
+
+GltfTextureInfo readTextureInfo(const JsonValue &value)
+{
+    GltfTextureInfo info;
+    info.texture = readGltfIndex(value["index"]);
+    info.texCoord = readUint32(value["texCoord"]);
+    return info;
+}
+
+template <typename Vector> Vector readVector(const JsonValue &value, const Vector &fallback)
+{
+    if (!value.isArray() || value.size() != size_t(Vector::length()))
+    {
+        return fallback;
+    }
+    Vector vector;
+    for (int i = 0; i < Vector::length(); ++i)
+    {
+        vector[i] = float(value[size_t(i)].asNumber());
+    }
+    return vector;
+}
+
+Transform decomposeMatrix(const glm::mat4 &matrix)
+{
+    Transform transform;
+    transform.translation = glm::vec3(matrix[3]);
+    const glm::mat3 linear(matrix);
+    transform.scale = glm::vec3(glm::length(linear[0]), glm::length(linear[1]),
+                                glm::length(linear[2]));
+    if (glm::determinant(linear) < 0.f)
+    {
+        transform.scale.x = -transform.scale.x;
+    }
+    glm::mat3 rotation(1.f);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (transform.scale[axis] != 0.f)
+        {
+            rotation[axis] = linear[axis] / transform.scale[axis];
+        }
+    }
+    transform.rotation = glm::normalize(glm::quat_cast(rotation));
+    return transform;
+}
+
+void checkRange(size_t offset, size_t size, size_t limit, const std::string &what)
+{
+    if (offset > limit || size > limit - offset)
+    {
+        gltfError(what + " is out of range");
+    }
+}
+
+void checkRequiredIndex(size_t index, size_t count, const std::string &what)
+{
+    if (index >= count)
+    {
+        gltfError(what + " references a missing object " + std::to_string(index));
+    }
+}
+
+void checkIndex(GltfIndex index, size_t count, const std::string &what)
+{
+    if (index != GLTF_NONE)
+    {
+        checkRequiredIndex(index < 0 ? ~size_t(0) : size_t(index), count, what);
+    }
+}
+} // namespace
+
+size_t GltfAccessor::elementSize() const
+{
+    return componentSize(componentType) * components;
+}
+
+size_t GltfDocument::stride(const GltfAccessor &accessor) const
+{
+    const uint32_t byteStride = m_BufferViews[accessor.bufferView].byteStride;
+    return byteStride ? byteStride : accessor.elementSize();
+}
+
+void GltfDocument::load(const fs::path &path)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    *this = GltfDocument();
+    m_Directory = path.parent_path();
+    m_Mappings.emplace_back(path);
+    const MappedFile &file = m_Mappings.back();
+    m_Stats.fileBytes = file.size();
+
+    if (file.size() >= 12 && readU32(file.data()) == GLB_MAGIC)
+    {
+        // header, then a JSON chunk and an optional binary chunk, both 4 byte aligned
+        if (readU32(file.data() + 4) != 2)
+        {
+            gltfError(path.string() + ": unsupported GLB version");
+        }
+        const size_t length = std::min(size_t(readU32(file.data() + 8)), file.size());
+        const uint8_t *json = nullptr, *binary = nullptr;
+        size_t jsonSize = 0, binarySize = 0;
+        for (size_t offset = 12; offset + 8 <= length;)
+        {
+            const size_t chunkSize = readU32(file.data() + offset);
+            const uint32_t chunkType = readU32(file.data() + offset + 4);
+            checkRange(offset + 8, chunkSize, length, "GLB chunk");
+            if (chunkType == GLB_CHUNK_JSON && !json)
+            {
+                json = file.data() + offset + 8;
+                jsonSize = chunkSize;
+            }
+            else if (chunkType == GLB_CHUNK_BIN && !binary)
+            {
+                binary = file.data() + offset + 8;
+                binarySize = chunkSize;
+            }
+            offset += 8 + ((chunkSize + 3) & ~size_t(3));
+        }
+        if (!json)
+        {
+            gltfError(path.string() + ": GLB without JSON chunk");
+        }
+        parse(reinterpret_cast<const char *>(json), jsonSize, binary, binarySize);
+    }
+    else
+    {
+        const char *json = reinterpret_cast<const char *>(file.data());
+        size_t jsonSize = file.size();
+        // UTF-8 byte order mark
+        if (jsonSize >= 3 && std::memcmp(json, "\xef\xbb\xbf", 3) == 0)
+        {
+            json += 3;
+            jsonSize -= 3;
+        }
+        parse(json, jsonSize, nullptr, 0);
+    }
+    validate();
+    m_Stats.parseMilliseconds = std::chrono::duration<float, std::milli>(
+                                    std::chrono::high_resolution_clock::now() - start)
+                                    .count();
+}
+
+void GltfDocument::parse(const char *text, size_t size, const uint8_t *binaryChunk,
+                         size_t binarySize)
+{
+    const JsonValue json = JsonValue::parse(text, size);
+    if (json["asset"]["version"].asString().compare(0, 1, "2") != 0)
+    {
+        gltfError("only glTF 2.0 is supported");
+    }
+    for (const auto &extension : json["extensionsRequired"].elements())
+    {
+        gltfError("unsupported required extension " + extension.asString());
+    }
+
+    const JsonValue &buffers = json["buffers"];
+    m_Buffers.resize(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        const JsonValue &buffer = buffers[i];
+        const size_t byteLength = readSize(buffer["byteLength"]);
+        const std::string &uri = buffer["uri"].asString();
+        GltfBuffer &target = m_Buffers[i];
+        if (uri.empty())
+        {
+            // only the first buffer of a GLB can be its binary chunk
+            if (i != 0 || !binaryChunk)
+            {
+                gltfError("buffer " + std::to_string(i) + " has no data");
+            }
+            target.data = binaryChunk;
+            target.size = binarySize;
+        }
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            const size_t comma = uri.find(',');
+            if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+            {
+                gltfError("only base64 data URIs are supported");
+            }
+            m_DecodedBuffers.push_back(
+                decodeBase64(uri.data() + comma + 1, uri.size() - comma - 1));
+            target.data = m_DecodedBuffers.back().data();
+            target.size = m_DecodedBuffers.back().size();
+            m_Stats.decodedBytes += target.size;
+        }
+        else
+        {
+            m_Mappings.emplace_back(m_Directory / decodeUri(uri));
+            target.data = m_Mappings.back().data();
+            target.size = m_Mappings.back().size();
+            m_Stats.fileBytes += target.size;
+        }
+        if (target.size < byteLength)
+        {
+            gltfError("buffer " + std::to_string(i) + " is shorter than its byteLength");
+        }
+        target.size = byteLength;
+    }
+
+    const JsonValue &bufferViews = json["bufferViews"];
+    m_BufferViews.resize(bufferViews.size());
+    for (size_t i = 0; i < bufferViews.size(); ++i)
+    {
+        const JsonValue &view = bufferViews[i];
+        GltfBufferView &target = m_BufferViews[i];
+        target.buffer = readUint32(view["buffer"], ~0u);
+        target.byteOffset = readSize(view["byteOffset"]);
+        target.byteLength = readSize(view["byteLength"]);
+        target.byteStride = readUint32(view["byteStride"]);
+    }
+
+    const JsonValue &accessors = json["accessors"];
+    m_Accessors.resize(accessors.size());
+    for (size_t i = 0; i < accessors.size(); ++i)
+    {
+        const JsonValue &accessor = accessors[i];
+        GltfAccessor &target = m_Accessors[i];
+        target.bufferView = readGltfIndex(accessor["bufferView"]);
+        target.byteOffset = readSize(accessor["byteOffset"]);
+        target.componentType = readUint32(accessor["componentType"]);
+        target.normalized = accessor["normalized"].asBool();
+        target.count = readSize(accessor["count"]);
+        target.components = componentCount(accessor["type"].asString());
+        if (target.components == 3 && accessor.has("min") && accessor.has("max"))
+        {
+            target.bounds = AABB(readVector(accessor["min"], glm::vec3(0.f)),
+                                 readVector(accessor["max"], glm::vec3(0.f)));
+        }
+        const JsonValue &sparse = accessor["sparse"];
+        if (sparse.isObject())
+        {
+            target.sparse.count = readSize(sparse["count"]);
+            target.sparse.indicesView = readUint32(sparse["indices"]["bufferView"]);
+            target.sparse.indicesOffset = readSize(sparse["indices"]["byteOffset"]);
+            target.sparse.indicesComponentType = readUint32(sparse["indices"]["componentType"]);
+            target.sparse.valuesView = readUint32(sparse["values"]["bufferView"]);
+            target.sparse.valuesOffset = readSize(sparse["values"]["byteOffset"]);
+        }
+    }
+
+    const JsonValue &meshes = json["meshes"];
+    m_Meshes.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        GltfMesh &target = m_Meshes[i];
+        target.name = meshes[i]["name"].asString();
+        for (const auto &primitive : meshes[i]["primitives"].elements())
+        {
+            GltfPrimitive result;
+            const JsonValue &attributes = primitive["attributes"];
+            result.position = readGltfIndex(attributes["POSITION"]);
+            result.normal = readGltfIndex(attributes["NORMAL"]);
+            result.tangent = readGltfIndex(attributes["TANGENT"]);
+            result.texCoord0 = readGltfIndex(attributes["TEXCOORD_0"]);
+            result.texCoord1 = readGltfIndex(attributes["TEXCOORD_1"]);
+            result.color0 = readGltfIndex(attributes["COLOR_0"]);
+            result.indices = readGltfIndex(primitive["indices"]);
+            result.material = readGltfIndex(primitive["material"]);
+            result.mode = readUint32(primitive["mode"], GLTF_TRIANGLES);
+            target.primitives.push_back(result);
+        }
+    }
+
+    const JsonValue &materials = json["materials"];
+    m_Materials.resize(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i)
+    {
+        const JsonValue &material = materials[i];
+        const JsonValue &pbr = material["pbrMetallicRoughness"];
+        GltfMaterial &target = m_Materials[i];
+        target.name = material["name"].asString();
+        target.baseColorFactor = readVector(pbr["baseColorFactor"], glm::vec4(1.f));
+        target.baseColorTexture = readTextureInfo(pbr["baseColorTexture"]);
+        target.metallicFactor = float(pbr["metallicFactor"].asNumber(1.));
+        target.roughnessFactor = float(pbr["roughnessFactor"].asNumber(1.));
+        target.metallicRoughnessTexture = readTextureInfo(pbr["metallicRoughnessTexture"]);
+        target.normalTexture = readTextureInfo(material["normalTexture"]);
+        target.occlusionTexture = readTextureInfo(material["occlusionTexture"]);
+        target.emissiveTexture = readTextureInfo(material["emissiveTexture"]);
+        target.emissiveFactor = readVector(material["emissiveFactor"], glm::vec3(0.f));
+        const std::string &alphaMode = material["alphaMode"].asString();
+        target.alphaMode = alphaMode == "MASK"    ? GltfAlphaMode::Mask
+                           : alphaMode == "BLEND" ? GltfAlphaMode::Blend
+                                                  : GltfAlphaMode::Opaque;
+        target.alphaCutoff = float(material["alphaCutoff"].asNumber(.5));
+        target.doubleSided = material["doubleSided"].asBool();
+    }
+
+    const JsonValue &textures = json["textures"];
+    m_Textures.resize(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i)
+    {
+        m_Textures[i].source = readGltfIndex(textures[i]["source"]);
+        m_Textures[i].sampler = readGltfIndex(textures[i]["sampler"]);
+    }
+
+    const JsonValue &images = json["images"];
+    m_Images.resize(images.size());
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        m_Images[i].uri = images[i]["uri"].asString();
+        m_Images[i].bufferView = readGltfIndex(images[i]["bufferView"]);
+        m_Images[i].mimeType = images[i]["mimeType"].asString();
+    }
+
+    const JsonValue &samplers = json["samplers"];
+    m_Samplers.resize(samplers.size());
+    for (size_t i = 0; i < samplers.size(); ++i)
+    {
+        m_Samplers[i].magFilter = readUint32(samplers[i]["magFilter"]);
+        m_Samplers[i].minFilter = readUint32(samplers[i]["minFilter"]);
+        m_Samplers[i].wrapS = readUint32(samplers[i]["wrapS"], GLTF_REPEAT);
+        m_Samplers[i].wrapT = readUint32(samplers[i]["wrapT"], GLTF_REPEAT);
+    }
+
+    const JsonValue &nodes = json["nodes"];
+    m_Nodes.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const JsonValue &node = nodes[i];
+        GltfNode &target = m_Nodes[i];
+        target.name = node["name"].asString();
+        target.mesh = readGltfIndex(node["mesh"]);
+        for (const auto &child : node["children"].elements())
+        {
+            target.children.push_back(readUint32(child, ~0u));
+        }
+        const JsonValue &matrix = node["matrix"];
+        if (matrix.isArray() && matrix.size() == 16)
+        {
+            glm::mat4 columns;
+            for (int k = 0; k < 16; ++k)
+            {
+                columns[k / 4][k % 4] = float(matrix[size_t(k)].asNumber());
+            }
+            target.local = decomposeMatrix(columns);
+        }
+        else
+        {
+            target.local.translation = readVector(node["translation"], glm::vec3(0.f));
+            // stored x, y, z, w
+            const glm::vec4 rotation = readVector(node["rotation"], glm::vec4(0.f, 0.f, 0.f, 1.f));
+            target.local.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+            target.local.scale = readVector(node["scale"], glm::vec3(1.f));
+        }
+    }
+
+    const JsonValue &scenes = json["scenes"];
+    m_Scenes.resize(scenes.size());
+    for (size_t i = 0; i < scenes.size(); ++i)
+    {
+        m_Scenes[i].name = scenes[i]["name"].asString();
+        for (const auto &node : scenes[i]["nodes"].elements())
+        {
+            m_Scenes[i].nodes.push_back(readUint32(node, ~0u));
+        }
+    }
+    m_DefaultScene = readGltfIndex(json["scene"]);
+    if (m_DefaultScene == GLTF_NONE && !m_Scenes.empty())
+    {
+        m_DefaultScene = 0;
+    }
+}
+
+void GltfDocument::validate() const
+{
+    for (size_t i = 0; i < m_BufferViews.size(); ++i)
+    {
+        const GltfBufferView &view = m_BufferViews[i];
+        checkRequiredIndex(view.buffer, m_Buffers.size(), "buffer view");
+        // glTF requires at least a byte, and GL buffers can't be empty
+        if (view.byteLength == 0)
+        {
+            gltfError("buffer view " + std::to_string(i) + " is empty");
+        }
+        checkRange(view.byteOffset, view.byteLength, m_Buffers[view.buffer].size,
+                   "buffer view " + std::to_string(i));
+    }
+    for (size_t i = 0; i < m_Accessors.size(); ++i)
+    {
+        const GltfAccessor &accessor = m_Accessors[i];
+        const std::string name = "accessor " + std::to_string(i);
+        checkIndex(accessor.bufferView, m_BufferViews.size(), name);
+        if (accessor.bufferView != GLTF_NONE && accessor.count > 0)
+        {
+            const size_t extent = stride(accessor) * (accessor.count - 1) + accessor.elementSize();
+            checkRange(accessor.byteOffset, extent,
+                       m_BufferViews[accessor.bufferView].byteLength, name);
+        }
+        const GltfSparse &sparse = accessor.sparse;
+        if (sparse.count > 0)
+        {
+            checkRequiredIndex(sparse.indicesView, m_BufferViews.size(), name);
+            checkRequiredIndex(sparse.valuesView, m_BufferViews.size(), name);
+            checkRange(sparse.indicesOffset,
+                       sparse.count * componentSize(sparse.indicesComponentType),
+                       m_BufferViews[sparse.indicesView].byteLength, name + " sparse indices");
+            checkRange(sparse.valuesOffset, sparse.count * accessor.elementSize(),
+                       m_BufferViews[sparse.valuesView].byteLength, name + " sparse values");
+        }
+    }
+    for (const auto &mesh : m_Meshes)
+    {
+        for (const auto &primitive : mesh.primitives)
+        {
+            for (const auto accessor :
+                 {primitive.position, primitive.normal, primitive.tangent, primitive.texCoord0,
+                  primitive.texCoord1, primitive.color0, primitive.indices})
+            {
+                checkIndex(accessor, m_Accessors.size(), "mesh " + mesh.name);
+            }
+            checkIndex(primitive.material, m_Materials.size(), "mesh " + mesh.name);
+            // both are handed to glDraw* as is
+            if (primitive.mode > GLTF_TRIANGLE_FAN)
+            {
+                gltfError("mesh " + mesh.name + " has an unknown primitive mode " +
+                          std::to_string(primitive.mode));
+            }
+            if (primitive.indices != GLTF_NONE)
+            {
+                const GltfAccessor &indices = m_Accessors[primitive.indices];
+                if (indices.components != 1 || (indices.componentType != GLTF_UNSIGNED_BYTE &&
+                                                 indices.componentType != GLTF_UNSIGNED_SHORT &&
+                                                 indices.componentType != GLTF_UNSIGNED_INT))
+                {
+                    gltfError("mesh " + mesh.name + " indices must be unsigned integers");
+                }
+            }
+        }
+    }
+    for (const auto &material : m_Materials)
+    {
+        for (const auto *info :
+             {&material.baseColorTexture, &material.metallicRoughnessTexture,
+              &material.normalTexture, &material.occlusionTexture, &material.emissiveTexture})
+        {
+            checkIndex(info->texture, m_Textures.size(), "material " + material.name);
+        }
+    }
+    for (const auto &texture : m_Textures)
+    {
+        checkIndex(texture.source, m_Images.size(), "texture");
+        checkIndex(texture.sampler, m_Samplers.size(), "texture");
+    }
+    for (const auto &image : m_Images)
+    {
+        checkIndex(image.bufferView, m_BufferViews.size(), "image");
+    }
+
+    // nodes form a forest: one parent at most and no cycle
+    std::vector<GltfIndex> parents(m_Nodes.size(), GLTF_NONE);
+    for (size_t i = 0; i < m_Nodes.size(); ++i)
+    {
+        checkIndex(m_Nodes[i].mesh, m_Meshes.size(), "node " + m_Nodes[i].name);
+        for (const auto child : m_Nodes[i].children)
+        {
+            checkRequiredIndex(child, m_Nodes.size(), "node " + m_Nodes[i].name);
+            if (parents[child] != GLTF_NONE || child == i)
+            {
+                gltfError("node " + std::to_string(child) + " has several parents");
+            }
+            parents[child] = GltfIndex(i);
+        }
+    }
+    for (size_t i = 0; i < m_Nodes.size(); ++i)
+    {
+        size_t depth = 0;
+        for (GltfIndex node = parents[i]; node != GLTF_NONE; node = parents[node])
+        {
+            if (++depth > m_Nodes.size())
+            {
+                gltfError("node hierarchy has a cycle");
+            }
+        }
+    }
+    for (const auto &scene : m_Scenes)
+    {
+        for (const auto node : scene.nodes)
+        {
+            checkRequiredIndex(node, m_Nodes.size(), "scene " + scene.name);
+        }
+    }
+    checkIndex(m_DefaultScene, m_Scenes.size(), "scene");
+}
+
+void GltfDocument::readFloats(uint32_t accessorIndex, std::vector<float> &values) const
+{
+    const GltfAccessor &accessor = m_Accessors[accessorIndex];
+    const size_t components = accessor.components;
+    const size_t size = componentSize(accessor.componentType);
+    values.assign(accessor.count * components, 0.f);
+    if (accessor.bufferView != GLTF_NONE)
+    {
+        const uint8_t *data = viewData(accessor.bufferView) + accessor.byteOffset;
+        const size_t elementStride = stride(accessor);
+        for (size_t element = 0; element < accessor.count; ++element)
+        {
+            for (size_t component = 0; component < components; ++component)
+            {
+                values[element * components + component] =
+                    readComponent(data + element * elementStride + component * size,
+                                  accessor.componentType, accessor.normalized);
+            }
+        }
+    }
+    const GltfSparse &sparse = accessor.sparse;
+    if (sparse.count > 0)
+    {
+        const uint8_t *indices = viewData(sparse.indicesView) + sparse.indicesOffset;
+        const uint8_t *sparseValues = viewData(sparse.valuesView) + sparse.valuesOffset;
+        const size_t indexSize = componentSize(sparse.indicesComponentType);
+        for (size_t k = 0; k < sparse.count; ++k)
+        {
+            const size_t element = readIndex(indices + k * indexSize, sparse.indicesComponentType);
+            if (element >= accessor.count)
+            {
+                gltfError("sparse index out of range in accessor " +
+                          std::to_string(accessorIndex));
+            }
+            for (size_t component = 0; component < components; ++component)
+            {
+                values[element * components + component] =
+                    readComponent(sparseValues + (k * components + component) * size,
+                                  accessor.componentType, accessor.normalized);
+            }
+        }
+    }
+}
+
+void GltfDocument::readIndices(uint32_t accessorIndex, std::vector<uint32_t> &indices) const
+{
+    const GltfAccessor &accessor = m_Accessors[accessorIndex];
+    indices.assign(accessor.count, 0u);
+    if (accessor.bufferView != GLTF_NONE)
+    {
+        const uint8_t *data = viewData(accessor.bufferView) + accessor.byteOffset;
+        const size_t elementStride = stride(accessor);
+        for (size_t element = 0; element < accessor.count; ++element)
+        {
+            indices[element] = readIndex(data + element * elementStride, accessor.componentType);
+        }
+    }
+    const GltfSparse &sparse = accessor.sparse;
+    if (sparse.count > 0)
+    {
+        const uint8_t *sparseIndices = viewData(sparse.indicesView) + sparse.indicesOffset;
+        const uint8_t *sparseValues = viewData(sparse.valuesView) + sparse.valuesOffset;
+        const size_t indexSize = componentSize(sparse.indicesComponentType);
+        const size_t valueSize = componentSize(accessor.componentType);
+        for (size_t k = 0; k < sparse.count; ++k)
+        {
+            const size_t element =
+                readIndex(sparseIndices + k * indexSize, sparse.indicesComponentType);
+            if (element >= accessor.count)
+            {
+                gltfError("sparse index out of range in accessor " +
+                          std::to_string(accessorIndex));
+            }
+            indices[element] = readIndex(sparseValues + k * valueSize, accessor.componentType);
+        }
+    }
+}
+
+fs::path GltfDocument::imagePath(uint32_t image) const
+{
+    const std::string &uri = m_Images[image].uri;
+    if (m_Images[image].bufferView != GLTF_NONE || uri.empty() || uri.compare(0, 5, "data:") == 0)
+    {
+        return fs::path();
+    }
+    return m_Directory / decodeUri(uri);
+}
+
+std::pair<const uint8_t *, size_t> GltfDocument::imageData(uint32_t image,
+                                                           std::vector<uint8_t> &storage) const
+{
+    const GltfImage &source = m_Images[image];
+    if (source.bufferView != GLTF_NONE)
+    {
+        return {viewData(uint32_t(source.bufferView)),
+                m_BufferViews[source.bufferView].byteLength};
+    }
+    const size_t comma = source.uri.find(',');
+    if (source.uri.compare(0, 5, "data:") != 0 || comma == std::string::npos)
+    {
+        return {nullptr, 0};
+    }
+    storage = decodeBase64(source.uri.data() + comma + 1, source.uri.size() - comma - 1);
+    return {storage.data(), storage.size()};
+}
+
+void GltfDocument::instantiate(uint32_t scene, TransformHierarchy &transforms,
+                               std::vector<std::pair<TransformNode, uint32_t>> &meshNodes,
+                               TransformNode parent) const
+{
+    // depth first with an explicit stack, the hierarchy was checked to be a forest
+    std::vector<std::pair<uint32_t, TransformNode>> stack;
+    for (const auto root : m_Scenes[scene].nodes)
+    {
+        stack.emplace_back(root, parent);
+    }
+    while (!stack.empty())
+    {
+        const auto entry = stack.back();
+        stack.pop_back();
+        const GltfNode &node = m_Nodes[entry.first];
+        const TransformNode created = transforms.create(entry.second, node.local);
+        if (node.mesh != GLTF_NONE)
+        {
+            meshNodes.emplace_back(created, uint32_t(node.mesh));
+        }
+        for (const auto child : node.children)
+        {
+            stack.emplace_back(child, created);
+        }
+    }
+}
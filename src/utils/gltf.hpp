@@ -0,0 +1,236 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "filesystem.hpp"
+#include "mapped_file.hpp"
+#include "transform_hierarchy.hpp"
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// glTF enums keep the values of the matching GL enums, so they can be handed to GL as is
+// without this CPU side depending on it.
+const uint32_t GLTF_BYTE = 5120;
+const uint32_t GLTF_UNSIGNED_BYTE = 5121;
+const uint32_t GLTF_SHORT = 5122;
+const uint32_t GLTF_UNSIGNED_SHORT = 5123;
+const uint32_t GLTF_UNSIGNED_INT = 5125;
+const uint32_t GLTF_FLOAT = 5126;
+const uint32_t GLTF_TRIANGLES = 4;
+const uint32_t GLTF_TRIANGLE_FAN = 6; // the last primitive mode
+const uint32_t GLTF_REPEAT = 10497;
+
+// Index of a referenced glTF object, -1 when absent.
+using GltfIndex = int32_t;
+const GltfIndex GLTF_NONE = -1;
+
+struct GltfBuffer
+{
+    const uint8_t *data = nullptr; // in a file mapping or in memory owned by the document
+    size_t size = 0;
+};
+
+struct GltfBufferView
+{
+    uint32_t buffer = 0;
+    size_t byteOffset = 0;
+    size_t byteLength = 0;
+    uint32_t byteStride = 0; // 0 for tightly packed elements
+};
+
+// Values replaced in the dense accessor data, or in zeros without a buffer view.
+struct GltfSparse
+{
+    size_t count = 0; // 0 for a dense accessor
+    uint32_t indicesView = 0;
+    size_t indicesOffset = 0;
+    uint32_t indicesComponentType = GLTF_UNSIGNED_INT;
+    uint32_t valuesView = 0;
+    size_t valuesOffset = 0;
+};
+
+struct GltfAccessor
+{
+    GltfIndex bufferView = GLTF_NONE;
+    size_t byteOffset = 0;
+    uint32_t componentType = GLTF_FLOAT;
+    bool normalized = false;
+    size_t count = 0;
+    uint32_t components = 1; // SCALAR 1, VEC2 2, VEC3 3, VEC4 4, MAT4 16
+    AABB bounds;             // from min and max, for VEC3 accessors that have them
+    GltfSparse sparse;
+
+    size_t elementSize() const;
+};
+
+struct GltfPrimitive
+{
+    // accessors of the attributes
+    GltfIndex position = GLTF_NONE;
+    GltfIndex normal = GLTF_NONE;
+    GltfIndex tangent = GLTF_NONE;
+    GltfIndex texCoord0 = GLTF_NONE;
+    GltfIndex texCoord1 = GLTF_NONE;
+    GltfIndex color0 = GLTF_NONE;
+    GltfIndex indices = GLTF_NONE;
+    GltfIndex material = GLTF_NONE;
+    uint32_t mode = GLTF_TRIANGLES;
+};
+
+struct GltfMesh
+{
+    std::string name;
+    std::vector<GltfPrimitive> primitives;
+};
+
+struct GltfTextureInfo
+{
+    GltfIndex texture = GLTF_NONE;
+    uint32_t texCoord = 0;
+};
+
+enum class GltfAlphaMode
+{
+    Opaque,
+    Mask,
+    Blend
+};
+
+struct GltfMaterial
+{
+    std::string name;
+    glm::vec4 baseColorFactor = glm::vec4(1.f);
+    GltfTextureInfo baseColorTexture;
+    float metallicFactor = 1.f;
+    float roughnessFactor = 1.f;
+    GltfTextureInfo metallicRoughnessTexture;
+    GltfTextureInfo normalTexture;
+    GltfTextureInfo occlusionTexture;
+    GltfTextureInfo emissiveTexture;
+    glm::vec3 emissiveFactor = glm::vec3(0.f);
+    GltfAlphaMode alphaMode = GltfAlphaMode::Opaque;
+    float alphaCutoff = .5f;
+    bool doubleSided = false;
+};
+
+struct GltfSampler
+{
+    uint32_t magFilter = 0; // 0 when unspecified
+    uint32_t minFilter = 0;
+    uint32_t wrapS = GLTF_REPEAT;
+    uint32_t wrapT = GLTF_REPEAT;
+};
+
+struct GltfTexture
+{
+    GltfIndex source = GLTF_NONE; // image
+    GltfIndex sampler = GLTF_NONE;
+};
+
+// Either a URI relative to the document or a buffer view holding the encoded image.
+struct GltfImage
+{
+    std::string uri;
+    GltfIndex bufferView = GLTF_NONE;
+    std::string mimeType;
+};
+
+struct GltfNode
+{
+    std::string name;
+    GltfIndex mesh = GLTF_NONE;
+    std::vector<uint32_t> children;
+    // a node matrix is decomposed, shear is lost
+    Transform local;
+};
+
+struct GltfScene
+{
+    std::string name;
+    std::vector<uint32_t> nodes;
+};
+
+struct GltfLoadStats
+{
+    size_t fileBytes = 0;   // .glb or .gltf plus external buffers, mapped
+    size_t decodedBytes = 0; // data: URI buffers decoded to memory
+    float parseMilliseconds = 0.f;
+};
+
+// glTF 2.0 document from a .gltf or a .glb file. The files are memory mapped and buffers
+// point into the mappings: loading copies nothing but the JSON tree, the binary data is read
+// in place, by the GPU upload in particular (see GltfModel). Only base64 data: URI buffers are
+// decoded to memory. Every index and accessor range is validated when loading, so reading an
+// accessor never leaves its buffer. Extensions are ignored, required ones make loading fail.
+class GltfDocument
+{
+public:
+    // Throws on missing files, malformed data or unsupported required extensions.
+    void load(const fs::path &path);
+
+    const std::vector<GltfBuffer> &buffers() const { return m_Buffers; }
+    const std::vector<GltfBufferView> &bufferViews() const { return m_BufferViews; }
+    const std::vector<GltfAccessor> &accessors() const { return m_Accessors; }
+    const std::vector<GltfMesh> &meshes() const { return m_Meshes; }
+    const std::vector<GltfMaterial> &materials() const { return m_Materials; }
+    const std::vector<GltfTexture> &textures() const { return m_Textures; }
+    const std::vector<GltfImage> &images() const { return m_Images; }
+    const std::vector<GltfSampler> &samplers() const { return m_Samplers; }
+    const std::vector<GltfNode> &nodes() const { return m_Nodes; }
+    const std::vector<GltfScene> &scenes() const { return m_Scenes; }
+    // scene to show, GLTF_NONE when the document has none
+    GltfIndex defaultScene() const { return m_DefaultScene; }
+    const fs::path &directory() const { return m_Directory; }
+    const GltfLoadStats &stats() const { return m_Stats; }
+
+    // First byte of a buffer view.
+    const uint8_t *viewData(uint32_t view) const
+    {
+        return m_Buffers[m_BufferViews[view].buffer].data + m_BufferViews[view].byteOffset;
+    }
+    // Distance between two elements of an accessor with a buffer view.
+    size_t stride(const GltfAccessor &accessor) const;
+
+    // Elements converted to floats, normalized integers mapped to [0, 1] or [-1, 1], sparse
+    // values applied. components floats per element.
+    void readFloats(uint32_t accessor, std::vector<float> &values) const;
+    // Scalar integer accessor, indices in particular, sparse values applied.
+    void readIndices(uint32_t accessor, std::vector<uint32_t> &indices) const;
+
+    // File of an image stored next to the document, empty for embedded images.
+    fs::path imagePath(uint32_t image) const;
+    // Encoded bytes of an embedded image: read in place from its buffer view, or decoded into
+    // storage for a data URI. Empty for images stored in their own file.
+    std::pair<const uint8_t *, size_t> imageData(uint32_t image,
+                                                 std::vector<uint8_t> &storage) const;
+
+    // Creates the nodes of a scene in transforms under parent, and returns the transform node
+    // and mesh of every node that has a mesh.
+    void instantiate(uint32_t scene, TransformHierarchy &transforms,
+                     std::vector<std::pair<TransformNode, uint32_t>> &meshNodes,
+                     TransformNode parent = NO_TRANSFORM_NODE) const;
+
+private:
+    void parse(const char *json, size_t size, const uint8_t *binaryChunk, size_t binarySize);
+    void validate() const;
+
+    fs::path m_Directory;
+    std::vector<MappedFile> m_Mappings;
+    std::vector<std::vector<uint8_t>> m_DecodedBuffers;
+    std::vector<GltfBuffer> m_Buffers;
+    std::vector<GltfBufferView> m_BufferViews;
+    std::vector<GltfAccessor> m_Accessors;
+    std::vector<GltfMesh> m_Meshes;
+    std::vector<GltfMaterial> m_Materials;
+    std::vector<GltfTexture> m_Textures;
+    std::vector<GltfImage> m_Images;
+    std::vector<GltfSampler> m_Samplers;
+    std::vector<GltfNode> m_Nodes;
+    std::vector<GltfScene> m_Scenes;
+    GltfIndex m_DefaultScene = GLTF_NONE;
+    GltfLoadStats m_Stats;
+};
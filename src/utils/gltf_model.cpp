@@ -0,0 +1,221 @@
+#include "gltf_model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+void GltfModel::Primitive::draw() const
+{
+    if (indexType == GL_NONE)
+    {
+        glDrawArrays(mode, 0, count);
+    }
+    else
+    {
+        glDrawElements(mode, count, indexType, reinterpret_cast<const void *>(indexOffset));
+    }
+}
+
+GltfModel::GltfModel(const GltfDocument &document, TextureLoader &textures)
+    : m_Textures(textures)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    m_ViewBuffers.assign(document.bufferViews().size(), 0);
+    createTextures(document);
+
+    const auto &meshes = document.meshes();
+    m_MeshPrimitives.push_back(0);
+    for (const auto &mesh : meshes)
+    {
+        AABB meshBounds;
+        for (const auto &source : mesh.primitives)
+        {
+            // nothing to draw without positions
+            if (source.position == GLTF_NONE)
+            {
+                continue;
+            }
+            Primitive primitive;
+            primitive.mode = GLenum(source.mode);
+            primitive.material = source.material;
+            bindAttribute(document, primitive, 0, source.position);
+            bindAttribute(document, primitive, 1, source.texCoord0);
+            bindAttribute(document, primitive, 2, source.normal);
+            if (source.indices != GLTF_NONE)
+            {
+                setIndices(document, primitive, uint32_t(source.indices));
+            }
+            else
+            {
+                primitive.count = GLsizei(document.accessors()[source.position].count);
+            }
+
+            const GltfAccessor &positions = document.accessors()[source.position];
+            primitive.bounds = positions.bounds;
+            if (primitive.bounds.empty() || positions.sparse.count > 0)
+            {
+                // min and max are required, but not always there; sparse values may move out
+                std::vector<float> values;
+                document.readFloats(uint32_t(source.position), values);
+                primitive.bounds = AABB();
+                for (size_t k = 0; k + 2 < values.size(); k += positions.components)
+                {
+                    primitive.bounds.extend(glm::vec3(values[k], values[k + 1], values[k + 2]));
+                }
+            }
+            meshBounds.extend(primitive.bounds);
+            m_Primitives.push_back(std::move(primitive));
+        }
+        m_MeshPrimitives.push_back(m_Primitives.size());
+        m_MeshBounds.push_back(meshBounds);
+    }
+
+    m_Stats.buffers = m_Buffers.size();
+    m_Stats.primitives = m_Primitives.size();
+    m_Stats.uploadMilliseconds = std::chrono::duration<float, std::milli>(
+                                     std::chrono::high_resolution_clock::now() - start)
+                                     .count();
+}
+
+GLuint GltfModel::viewBuffer(const GltfDocument &document, uint32_t view)
+{
+    if (m_ViewBuffers[view])
+    {
+        ++m_Stats.sharedViews;
+        return m_ViewBuffers[view];
+    }
+    // straight from the mapped file to the driver
+    const GLsizeiptr size = GLsizeiptr(document.bufferViews()[view].byteLength);
+    m_Buffers.emplace_back(size, document.viewData(view), 0);
+    m_Stats.uploadedBytes += size_t(size);
+    m_ViewBuffers[view] = m_Buffers.back().glId();
+    return m_ViewBuffers[view];
+}
+
+void GltfModel::bindAttribute(const GltfDocument &document, Primitive &primitive,
+                              GLuint location, GltfIndex accessorIndex)
+{
+    if (accessorIndex == GLTF_NONE)
+    {
+        // the shader reads the constant attribute value
+        return;
+    }
+    const GltfAccessor &accessor = document.accessors()[accessorIndex];
+    const GLuint vao = primitive.vao.glId();
+    const GLint components = GLint(std::min(accessor.components, 4u));
+    if (accessor.bufferView != GLTF_NONE && accessor.sparse.count == 0)
+    {
+        glVertexArrayAttribFormat(vao, location, components, GLenum(accessor.componentType),
+                                  accessor.normalized ? GL_TRUE : GL_FALSE, 0);
+        primitive.vao.setVertexBuffer(location,
+                                      viewBuffer(document, uint32_t(accessor.bufferView)),
+                                      GLintptr(accessor.byteOffset),
+                                      GLsizei(document.stride(accessor)));
+    }
+    else
+    {
+        std::vector<float> values;
+        document.readFloats(uint32_t(accessorIndex), values);
+        m_Buffers.emplace_back(GLsizeiptr(values.size() * sizeof(float)), values.data(), 0);
+        m_Stats.decodedBytes += values.size() * sizeof(float);
+        glVertexArrayAttribFormat(vao, location, components, GL_FLOAT, GL_FALSE, 0);
+        primitive.vao.setVertexBuffer(location, m_Buffers.back().glId(), 0,
+                                      GLsizei(accessor.components * sizeof(float)));
+    }
+    glVertexArrayAttribBinding(vao, location, location);
+    glEnableVertexArrayAttrib(vao, location);
+}
+
+void GltfModel::setIndices(const GltfDocument &document, Primitive &primitive,
+                           uint32_t accessorIndex)
+{
+    const GltfAccessor &accessor = document.accessors()[accessorIndex];
+    primitive.count = GLsizei(accessor.count);
+    // an element buffer reads packed indices, a strided view has to be repacked
+    const bool packed = accessor.bufferView == GLTF_NONE ||
+                        document.stride(accessor) == accessor.elementSize();
+    if (accessor.bufferView != GLTF_NONE && accessor.sparse.count == 0 && packed)
+    {
+        primitive.indexType = GLenum(accessor.componentType);
+        primitive.indexOffset = accessor.byteOffset;
+        primitive.vao.setElementBuffer(viewBuffer(document, uint32_t(accessor.bufferView)));
+        return;
+    }
+    std::vector<uint32_t> indices;
+    document.readIndices(accessorIndex, indices);
+    m_Buffers.emplace_back(GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(), 0);
+    m_Stats.decodedBytes += indices.size() * sizeof(uint32_t);
+    primitive.indexType = GL_UNSIGNED_INT;
+    primitive.indexOffset = 0;
+    primitive.vao.setElementBuffer(m_Buffers.back().glId());
+}
+
+void GltfModel::createTextures(const GltfDocument &document)
+{
+    const unsigned char white[4] = {255, 255, 255, 255};
+    m_WhiteTexture = GLTexture(GL_TEXTURE_2D);
+    m_WhiteTexture.storage2D(1, GL_RGBA8, 1, 1);
+    m_WhiteTexture.subImage2D(0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+    // only base color images are decoded, once whatever the number of textures using them
+    const auto &textures = document.textures();
+    m_Images.assign(document.images().size(), NO_TEXTURE_REQUEST);
+    const auto imageTexture = [&](const GltfTextureInfo &info) -> TextureRequest {
+        if (info.texture == GLTF_NONE || textures[info.texture].source == GLTF_NONE)
+        {
+            return NO_TEXTURE_REQUEST;
+        }
+        const GltfTexture &texture = textures[info.texture];
+        TextureRequest &request = m_Images[texture.source];
+        if (request != NO_TEXTURE_REQUEST)
+        {
+            return request;
+        }
+
+        TextureLoadOptions options;
+        // glTF texture coordinates have their origin at the top left, no flip
+        options.flipVertically = false;
+        options.srgb = true;
+        options.compress = true;
+        if (texture.sampler != GLTF_NONE)
+        {
+            const GltfSampler &sampler = document.samplers()[texture.sampler];
+            if (sampler.minFilter)
+            {
+                options.minFilter = GLenum(sampler.minFilter);
+            }
+            if (sampler.magFilter)
+            {
+                options.magFilter = GLenum(sampler.magFilter);
+            }
+            options.wrapS = GLenum(sampler.wrapS);
+            options.wrapT = GLenum(sampler.wrapT);
+        }
+        const fs::path path = document.imagePath(uint32_t(texture.source));
+        if (!path.empty())
+        {
+            request = m_Textures.load(path, options);
+        }
+        else
+        {
+            std::vector<uint8_t> storage;
+            const auto encoded = document.imageData(uint32_t(texture.source), storage);
+            // bytes in a buffer view are decoded in place, a data URI hands its decoding over
+            request = storage.empty() ? m_Textures.load(encoded.first, encoded.second, options)
+                                      : m_Textures.load(std::move(storage), options);
+        }
+        ++m_Stats.textures;
+        return request;
+    };
+
+    for (const auto &source : document.materials())
+    {
+        Material material;
+        material.baseColorFactor = source.baseColorFactor;
+        material.baseColorTexture = imageTexture(source.baseColorTexture);
+        material.alphaMode = source.alphaMode;
+        material.alphaCutoff = source.alphaCutoff;
+        material.doubleSided = source.doubleSided;
+        m_Materials.push_back(material);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "gltf.hpp"
+#include "texture_loader.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+struct GltfModelStats
+{
+    size_t buffers = 0;       // GL buffers created
+    size_t sharedViews = 0;   // accessor bindings reusing the buffer of an earlier one
+    size_t uploadedBytes = 0; // read in place from the document memory
+    size_t decodedBytes = 0;  // sparse or view-less accessors, expanded before upload
+    size_t primitives = 0;
+    size_t textures = 0;
+    float uploadMilliseconds = 0.f;
+};
+
+// GPU side of a GltfDocument. Every buffer view read by a vertex or index accessor is uploaded
+// once to an immutable buffer straight from the document memory, which is the file mapping
+// for a .glb: there is no intermediate copy. Every accessor reading that view, in any
+// primitive, binds the same buffer at its own offset and stride. Accessors that are sparse or
+// have no buffer view are decoded first and get a buffer of their own.
+// Primitives have a VAO with the Mesh attribute locations: 0 position, 1 texture coordinates,
+// 2 normal, each read from the binding of the same number. Base color images are requested
+// from a TextureLoader as sRGB textures and show its placeholder until they are resident;
+// embedded ones are decoded in place, the document has to outlive the loader's work.
+class GltfModel
+{
+public:
+    struct Primitive
+    {
+        GLVertexArray vao;
+        GLenum mode = GL_TRIANGLES;
+        GLenum indexType = GL_NONE; // GL_NONE for non indexed primitives
+        GLsizei count = 0;
+        size_t indexOffset = 0;
+        GltfIndex material = GLTF_NONE;
+        AABB bounds; // object space
+
+        // Expects the VAO to be bound.
+        void draw() const;
+    };
+
+    struct Material
+    {
+        glm::vec4 baseColorFactor = glm::vec4(1.f);
+        TextureRequest baseColorTexture = NO_TEXTURE_REQUEST; // white when there is none
+        GltfAlphaMode alphaMode = GltfAlphaMode::Opaque;
+        float alphaCutoff = .5f;
+        bool doubleSided = false;
+    };
+
+    GltfModel(const GltfDocument &document, TextureLoader &textures);
+
+    GltfModel(const GltfModel &) = delete;
+    GltfModel &operator=(const GltfModel &) = delete;
+
+    size_t meshCount() const { return m_MeshPrimitives.size() - 1; }
+    // primitives of a mesh are [firstPrimitive(mesh), firstPrimitive(mesh + 1))
+    size_t firstPrimitive(size_t mesh) const { return m_MeshPrimitives[mesh]; }
+    const Primitive &primitive(size_t index) const { return m_Primitives[index]; }
+    // material of a primitive, the glTF default material for GLTF_NONE
+    const Material &material(GltfIndex index) const
+    {
+        return index == GLTF_NONE ? m_DefaultMaterial : m_Materials[index];
+    }
+    GLuint baseColorTexture(const Material &material) const
+    {
+        return material.baseColorTexture == NO_TEXTURE_REQUEST
+                   ? m_WhiteTexture.glId()
+                   : m_Textures.texture(material.baseColorTexture);
+    }
+    const AABB &meshBounds(size_t mesh) const { return m_MeshBounds[mesh]; }
+    const GltfModelStats &stats() const { return m_Stats; }
+
+private:
+    GLuint viewBuffer(const GltfDocument &document, uint32_t view);
+    void bindAttribute(const GltfDocument &document, Primitive &primitive, GLuint location,
+                       GltfIndex accessor);
+    void setIndices(const GltfDocument &document, Primitive &primitive, uint32_t accessor);
+    void createTextures(const GltfDocument &document);
+
+    std::vector<GLBuffer> m_Buffers;
+    // GL buffer of each buffer view, 0 until a primitive reads it
+    std::vector<GLuint> m_ViewBuffers;
+    std::vector<Primitive> m_Primitives;
+    std::vector<size_t> m_MeshPrimitives;
+    std::vector<AABB> m_MeshBounds;
+    TextureLoader &m_Textures;
+    // request of each image, once whatever the number of textures using it
+    std::vector<TextureRequest> m_Images;
+    GLTexture m_WhiteTexture;
+    std::vector<Material> m_Materials;
+    Material m_DefaultMaterial;
+    GltfModelStats m_Stats;
+};
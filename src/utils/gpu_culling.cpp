@@ -0,0 +1,242 @@
+#include "gpu_culling.hpp"
+#include "occlusion_culler.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+static const GLuint GPU_CULL_GROUP_SIZE = 64; // local_size_x of both compute shaders
+
+GPUCuller::GPUCuller(GLProgram cullProgram, GLProgram compactProgram)
+    : m_CullProgram(std::move(cullProgram)), m_CompactProgram(std::move(compactProgram)),
+      m_DrawCount(sizeof(GLuint), nullptr, 0), m_OcclusionDepth(GL_TEXTURE_2D),
+      m_OcclusionTiles(GL_TEXTURE_2D)
+{
+    m_uInstanceCount = m_CullProgram.getUniformHandle("instanceCount");
+    m_uFrustumTest = m_CullProgram.getUniformHandle("frustumTest");
+    m_uOcclusionTest = m_CullProgram.getUniformHandle("occlusionTest");
+    m_uBatchCount = m_CompactProgram.getUniformHandle("batchCount");
+
+    m_OcclusionDepth.storage2D(1, GL_R32F, OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT);
+    m_OcclusionTiles.storage2D(1, GL_R32F, OcclusionCuller::TILES_X, OcclusionCuller::TILES_Y);
+    for (auto texture : {&m_OcclusionDepth, &m_OcclusionTiles})
+    {
+        texture->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        texture->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+}
+
+GPUCuller::~GPUCuller()
+{
+    if (m_ReadbackFence)
+    {
+        glDeleteSync(m_ReadbackFence);
+    }
+}
+
+void GPUCuller::setInstances(const std::vector<InstanceData> &instances,
+                             const std::vector<AABB> &bounds, const std::vector<DrawRange> &batches,
+                             const std::vector<uint32_t> &instanceBatches)
+{
+    if (bounds.size() != instances.size() ||
+        (!instanceBatches.empty() && instanceBatches.size() != instances.size()))
+    {
+        std::cerr << "GPUCuller: one bound and one batch per instance expected" << std::endl;
+        throw std::runtime_error("GPUCuller: one bound and one batch per instance expected");
+    }
+    if (instances.empty() || batches.empty())
+    {
+        m_nInstanceCount = m_nBatchCount = 0;
+        return;
+    }
+    m_IndexType = batches[0].indexType;
+    for (const auto &batch : batches)
+    {
+        if (batch.indexType != m_IndexType || batch.indexType == GL_NONE)
+        {
+            std::cerr << "GPUCuller: batches must share one index type" << std::endl;
+            throw std::runtime_error("GPUCuller: batches must share one index type");
+        }
+    }
+
+    // each batch owns a range of the visible instance buffer as large as its instance count
+    std::vector<GLuint> batchSizes(batches.size(), 0);
+    std::vector<GPUInstanceBounds> gpuBounds(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i)
+    {
+        const uint32_t batch = instanceBatches.empty() ? 0 : instanceBatches[i];
+        if (batch >= batches.size())
+        {
+            std::cerr << "GPUCuller: instance " << i << " has no batch " << batch << std::endl;
+            throw std::runtime_error("GPUCuller: instance batch out of range");
+        }
+        ++batchSizes[batch];
+        gpuBounds[i].center = bounds[i].center();
+        gpuBounds[i].batch = batch;
+        gpuBounds[i].extent = bounds[i].extent();
+        gpuBounds[i].padding = 0.f;
+    }
+    std::vector<IndirectCommand> commands(batches.size());
+    GLuint baseInstance = 0;
+    for (size_t i = 0; i < batches.size(); ++i)
+    {
+        commands[i].count = batches[i].count;
+        commands[i].instanceCount = 0;
+        commands[i].first = batches[i].first;
+        commands[i].baseVertexOrBaseInstance = GLuint(batches[i].baseVertex);
+        commands[i].baseInstance = baseInstance;
+        baseInstance += batchSizes[i];
+    }
+
+    m_nInstanceCount = GLuint(instances.size());
+    m_nBatchCount = GLuint(batches.size());
+    const GLsizeiptr commandBytes = GLsizeiptr(batches.size() * sizeof(IndirectCommand));
+    m_InstanceBatches = instanceBatches;
+    m_Bounds = GLBuffer(GLsizeiptr(gpuBounds.size() * sizeof(GPUInstanceBounds)),
+                        gpuBounds.data(), GL_DYNAMIC_STORAGE_BIT);
+    m_Instances = GLBuffer(GLsizeiptr(instances.size() * sizeof(InstanceData)), instances.data(),
+                           GL_DYNAMIC_STORAGE_BIT);
+    m_VisibleInstances = GLBuffer(GLsizeiptr(instances.size() * sizeof(InstanceData)), nullptr);
+    m_BatchTemplate = GLBuffer(commandBytes, commands.data());
+    m_Batches = GLBuffer(commandBytes, nullptr);
+    m_Commands = GLBuffer(commandBytes, nullptr);
+
+    if (m_ReadbackFence)
+    {
+        glDeleteSync(m_ReadbackFence);
+        m_ReadbackFence = nullptr;
+    }
+    const GLbitfield readbackFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    m_Readback = GLBuffer(GLsizeiptr(sizeof(GLuint)) + commandBytes, nullptr, readbackFlags);
+    m_pReadback = m_Readback.map(0, m_Readback.size(), readbackFlags);
+}
+
+void GPUCuller::updateInstances(size_t first, size_t count,
+                                const std::vector<InstanceData> &instances,
+                                const std::vector<AABB> &bounds)
+{
+    if (first + count > m_nInstanceCount || instances.size() != m_nInstanceCount ||
+        bounds.size() != m_nInstanceCount)
+    {
+        std::cerr << "GPUCuller: updated instances out of range" << std::endl;
+        throw std::runtime_error("GPUCuller: updated instances out of range");
+    }
+    if (count == 0)
+    {
+        return;
+    }
+    std::vector<GPUInstanceBounds> gpuBounds(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        gpuBounds[i].center = bounds[first + i].center();
+        gpuBounds[i].batch = m_InstanceBatches.empty() ? 0 : m_InstanceBatches[first + i];
+        gpuBounds[i].extent = bounds[first + i].extent();
+        gpuBounds[i].padding = 0.f;
+    }
+    m_Bounds.setSubData(GLintptr(first * sizeof(GPUInstanceBounds)),
+                        GLsizeiptr(count * sizeof(GPUInstanceBounds)), gpuBounds.data());
+    m_Instances.setSubData(GLintptr(first * sizeof(InstanceData)),
+                           GLsizeiptr(count * sizeof(InstanceData)), instances.data() + first);
+}
+
+void GPUCuller::setOcclusionBuffer(const OcclusionCuller *occlusion)
+{
+    m_bOcclusionTest = occlusion != nullptr;
+    if (occlusion)
+    {
+        m_OcclusionDepth.subImage2D(0, 0, 0, OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT,
+                                    GL_RED, GL_FLOAT, occlusion->depth());
+        m_OcclusionTiles.subImage2D(0, 0, 0, OcclusionCuller::TILES_X, OcclusionCuller::TILES_Y,
+                                    GL_RED, GL_FLOAT, occlusion->tileDepth());
+    }
+}
+
+void GPUCuller::cull(GLStateCache &state, bool frustumTest)
+{
+    if (m_nInstanceCount == 0)
+    {
+        return;
+    }
+    readBackStats();
+
+    // per batch instance counters back to 0, no draw
+    glCopyNamedBufferSubData(m_BatchTemplate.glId(), m_Batches.glId(), 0, 0, m_Batches.size());
+    glClearNamedBufferData(m_DrawCount.glId(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_BOUNDS_BINDING, m_Bounds.glId());
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_INSTANCES_BINDING, m_Instances.glId());
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_VISIBLE_BINDING,
+                         m_VisibleInstances.glId());
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_BATCHES_BINDING, m_Batches.glId());
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_COMMANDS_BINDING, m_Commands.glId());
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULL_DRAW_COUNT_BINDING,
+                         m_DrawCount.glId());
+    state.bindTexture(GPU_CULL_OCCLUSION_DEPTH_UNIT, m_OcclusionDepth.glId());
+    state.bindTexture(GPU_CULL_OCCLUSION_TILES_UNIT, m_OcclusionTiles.glId());
+
+    state.useProgram(m_CullProgram.glId());
+    m_CullProgram.setUniform(m_uInstanceCount, m_nInstanceCount);
+    m_CullProgram.setUniform(m_uFrustumTest, GLint(frustumTest));
+    m_CullProgram.setUniform(m_uOcclusionTest, GLint(m_bOcclusionTest));
+    glDispatchCompute((m_nInstanceCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    state.useProgram(m_CompactProgram.glId());
+    m_CompactProgram.setUniform(m_uBatchCount, m_nBatchCount);
+    glDispatchCompute((m_nBatchCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                    GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (!m_ReadbackFence)
+    {
+        glCopyNamedBufferSubData(m_DrawCount.glId(), m_Readback.glId(), 0, 0, sizeof(GLuint));
+        glCopyNamedBufferSubData(m_Batches.glId(), m_Readback.glId(), 0, sizeof(GLuint),
+                                 m_Batches.size());
+        m_ReadbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_nReadbackFrames = 0;
+    }
+}
+
+void GPUCuller::draw(GLStateCache &state, GLuint vao, GLuint instanceBinding) const
+{
+    if (m_nInstanceCount == 0)
+    {
+        return;
+    }
+    glVertexArrayVertexBuffer(vao, instanceBinding, m_VisibleInstances.glId(), 0,
+                              sizeof(InstanceData));
+    state.bindVertexArray(vao);
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Commands.glId());
+    state.bindBuffer(GL_PARAMETER_BUFFER, m_DrawCount.glId());
+    glMultiDrawElementsIndirectCount(GL_TRIANGLES, m_IndexType, nullptr, 0, GLsizei(m_nBatchCount),
+                                     sizeof(IndirectCommand));
+}
+
+void GPUCuller::readBackStats()
+{
+    if (!m_ReadbackFence)
+    {
+        return;
+    }
+    ++m_nReadbackFrames;
+    if (glClientWaitSync(m_ReadbackFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        return;
+    }
+    glDeleteSync(m_ReadbackFence);
+    m_ReadbackFence = nullptr;
+
+    const auto bytes = static_cast<const unsigned char *>(m_pReadback);
+    GLuint drawCount = 0;
+    std::memcpy(&drawCount, bytes, sizeof(GLuint));
+    m_Stats.drawCount = drawCount;
+    m_Stats.visibleInstances = 0;
+    for (GLuint i = 0; i < m_nBatchCount; ++i)
+    {
+        IndirectCommand command;
+        std::memcpy(&command, bytes + sizeof(GLuint) + i * sizeof(IndirectCommand),
+                    sizeof(IndirectCommand));
+        m_Stats.visibleInstances += command.instanceCount;
+    }
+    m_Stats.framesLate = m_nReadbackFrames;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "gl_state.hpp"
+#include "render_queue.hpp"
+#include "shaders.hpp"
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class OcclusionCuller;
+
+// Shader storage bindings of cull_instances.cs.glsl and compact_draws.cs.glsl, after the
+// materials (MATERIALS_BINDING).
+const GLuint GPU_CULL_BOUNDS_BINDING = 1;
+const GLuint GPU_CULL_INSTANCES_BINDING = 2;
+const GLuint GPU_CULL_VISIBLE_BINDING = 3;
+const GLuint GPU_CULL_BATCHES_BINDING = 4;
+const GLuint GPU_CULL_COMMANDS_BINDING = 5;
+const GLuint GPU_CULL_DRAW_COUNT_BINDING = 6;
+// Texture units of the optional occlusion buffer, after the material array.
+const GLuint GPU_CULL_OCCLUSION_DEPTH_UNIT = 1;
+const GLuint GPU_CULL_OCCLUSION_TILES_UNIT = 2;
+
+// std430 mirror of InstanceBounds in cull_instances.cs.glsl.
+struct GPUInstanceBounds
+{
+    glm::vec3 center;
+    uint32_t batch; // draw range of the instance
+    glm::vec3 extent;
+    float padding;
+};
+static_assert(sizeof(GPUInstanceBounds) == 32, "GPUInstanceBounds doesn't match std430");
+
+struct GPUCullingStats
+{
+    size_t visibleInstances = 0;
+    size_t drawCount = 0;
+    size_t framesLate = 0; // age of the counts above, read back without stalling
+};
+
+// GPU driven culling: instance data and world bounds live in SSBOs, and a compute pass
+// tests every instance against the frustum (and the CPU occlusion buffer when given).
+// Visible instances are appended to the range of their batch in a visible instance buffer
+// with an atomic counter in the batch's indirect command. A second pass stream-compacts
+// the non-empty commands into the GL_DRAW_INDIRECT_BUFFER and writes their count to the
+// GL_PARAMETER_BUFFER read by glMultiDrawElementsIndirectCount. The CPU only dispatches.
+class GPUCuller
+{
+public:
+    GPUCuller(GLProgram cullProgram, GLProgram compactProgram);
+    ~GPUCuller();
+
+    GPUCuller(const GPUCuller &) = delete;
+    GPUCuller &operator=(const GPUCuller &) = delete;
+
+    // A batch is one draw range of the shared VAO, all batches use the same index type.
+    // instanceBatches gives the batch of each instance, every instance is in batch 0 when
+    // it is empty.
+    void setInstances(const std::vector<InstanceData> &instances,
+                      const std::vector<AABB> &bounds, const std::vector<DrawRange> &batches,
+                      const std::vector<uint32_t> &instanceBatches = {});
+    // Uploads instances [first, first + count) again after they moved, their batches don't
+    // change.
+    void updateInstances(size_t first, size_t count, const std::vector<InstanceData> &instances,
+                         const std::vector<AABB> &bounds);
+    // Uploads the occlusion buffer rasterized this frame, nullptr disables occlusion tests.
+    void setOcclusionBuffer(const OcclusionCuller *occlusion);
+
+    // Dispatches both passes, reads viewProj from the FrameConstants uniform buffer.
+    void cull(GLStateCache &state, bool frustumTest = true);
+    // Draws the visible instances with the bound program, instanceBinding is the VAO vertex
+    // buffer binding read with a divisor of 1 for InstanceData.
+    void draw(GLStateCache &state, GLuint vao, GLuint instanceBinding) const;
+
+    const GPUCullingStats &stats() const { return m_Stats; }
+
+private:
+    void readBackStats();
+
+    GLProgram m_CullProgram;
+    GLProgram m_CompactProgram;
+    GLUniformHandle m_uInstanceCount;
+    GLUniformHandle m_uFrustumTest;
+    GLUniformHandle m_uOcclusionTest;
+    GLUniformHandle m_uBatchCount;
+
+    GLBuffer m_Bounds;
+    GLBuffer m_Instances;
+    GLBuffer m_VisibleInstances;
+    GLBuffer m_BatchTemplate; // commands with no instance, copied over m_Batches every frame
+    GLBuffer m_Batches;
+    GLBuffer m_Commands;
+    GLBuffer m_DrawCount;
+    std::vector<uint32_t> m_InstanceBatches; // empty when every instance is in batch 0
+    GLenum m_IndexType = GL_UNSIGNED_INT;
+    GLuint m_nInstanceCount = 0;
+    GLuint m_nBatchCount = 0;
+
+    GLTexture m_OcclusionDepth;
+    GLTexture m_OcclusionTiles;
+    bool m_bOcclusionTest = false;
+
+    // draw count and batch commands copied to a mapped buffer, read once the fence passed
+    GLBuffer m_Readback;
+    void *m_pReadback = nullptr;
+    GLsync m_ReadbackFence = nullptr;
+    size_t m_nReadbackFrames = 0;
+    GPUCullingStats m_Stats;
+};
@@ -0,0 +1,339 @@
+#include "json.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+// nesting deeper than this is rejected rather than overflowing the stack
+const size_t MAX_DEPTH = 256;
+
+const JsonValue &nullValue()
+{
+    static const JsonValue value;
+    return value;
+}
+
+void appendUtf8(std::string &text, uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        text += char(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        text += char(0xc0 | (codePoint >> 6));
+        text += char(0x80 | (codePoint & 0x3f));
+    }
+    else if (codePoint < 0x10000)
+    {
+        text += char(0xe0 | (codePoint >> 12));
+        text += char(0x80 | ((codePoint >> 6) & 0x3f));
+        text += char(0x80 | (codePoint & 0x3f));
+    }
+    else
+    {
+        text += char(0xf0 | (codePoint >> 18));
+        text += char(0x80 | ((codePoint >> 12) & 0x3f));
+        text += char(0x80 | ((codePoint >> 6) & 0x3f));
+        text += char(0x80 | (codePoint & 0x3f));
+    }
+}
+} // namespace
+
+class JsonParser
+{
+public:
+    JsonParser(const char *text, size_t size) : m_pText(text), m_nSize(size) {}
+
+    JsonValue parseDocument()
+    {
+        JsonValue value;
+        parseValue(value, 0);
+        skipSpaces();
+        if (m_nPosition != m_nSize)
+        {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const char *message) const
+    {
+        const std::string text =
+            std::string("JSON: ") + message + " at byte " + std::to_string(m_nPosition);
+        std::cerr << text << std::endl;
+        throw std::runtime_error(text);
+    }
+
+    void skipSpaces()
+    {
+        while (m_nPosition < m_nSize &&
+               (m_pText[m_nPosition] == ' ' || m_pText[m_nPosition] == '\t' ||
+                m_pText[m_nPosition] == '\n' || m_pText[m_nPosition] == '\r'))
+        {
+            ++m_nPosition;
+        }
+    }
+    char peek() const { return m_nPosition < m_nSize ? m_pText[m_nPosition] : '\0'; }
+    void expect(char c)
+    {
+        if (peek() != c)
+        {
+            fail((std::string("expected '") + c + "'").c_str());
+        }
+        ++m_nPosition;
+    }
+    void expectWord(const char *word)
+    {
+        for (; *word; ++word)
+        {
+            expect(*word);
+        }
+    }
+
+    void parseValue(JsonValue &value, size_t depth)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            fail("nesting too deep");
+        }
+        skipSpaces();
+        switch (peek())
+        {
+        case '{':
+            parseObject(value, depth);
+            break;
+        case '[':
+            parseArray(value, depth);
+            break;
+        case '"':
+            value.m_Type = JsonValue::Type::String;
+            parseString(value.m_String);
+            break;
+        case 't':
+            expectWord("true");
+            value.m_Type = JsonValue::Type::Bool;
+            value.m_bBool = true;
+            break;
+        case 'f':
+            expectWord("false");
+            value.m_Type = JsonValue::Type::Bool;
+            value.m_bBool = false;
+            break;
+        case 'n':
+            expectWord("null");
+            break;
+        default:
+            parseNumber(value);
+            break;
+        }
+    }
+
+    void parseObject(JsonValue &value, size_t depth)
+    {
+        value.m_Type = JsonValue::Type::Object;
+        expect('{');
+        skipSpaces();
+        if (peek() == '}')
+        {
+            ++m_nPosition;
+            return;
+        }
+        while (true)
+        {
+            skipSpaces();
+            value.m_Members.emplace_back();
+            parseString(value.m_Members.back().first);
+            skipSpaces();
+            expect(':');
+            parseValue(value.m_Members.back().second, depth + 1);
+            skipSpaces();
+            if (peek() == ',')
+            {
+                ++m_nPosition;
+                continue;
+            }
+            expect('}');
+            return;
+        }
+    }
+
+    void parseArray(JsonValue &value, size_t depth)
+    {
+        value.m_Type = JsonValue::Type::Array;
+        expect('[');
+        skipSpaces();
+        if (peek() == ']')
+        {
+            ++m_nPosition;
+            return;
+        }
+        while (true)
+        {
+            value.m_Elements.emplace_back();
+            parseValue(value.m_Elements.back(), depth + 1);
+            skipSpaces();
+            if (peek() == ',')
+            {
+                ++m_nPosition;
+                continue;
+            }
+            expect(']');
+            return;
+        }
+    }
+
+    uint32_t parseHex4()
+    {
+        if (m_nPosition + 4 > m_nSize)
+        {
+            fail("truncated \\u escape");
+        }
+        uint32_t value = 0;
+        for (int digit = 0; digit < 4; ++digit)
+        {
+            const char c = m_pText[m_nPosition++];
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+            {
+                value |= uint32_t(c - '0');
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                value |= uint32_t(c - 'a' + 10);
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                value |= uint32_t(c - 'A' + 10);
+            }
+            else
+            {
+                fail("invalid \\u escape");
+            }
+        }
+        return value;
+    }
+
+    void parseString(std::string &text)
+    {
+        expect('"');
+        while (true)
+        {
+            // copy the run up to the next quote or escape at once
+            const size_t start = m_nPosition;
+            while (m_nPosition < m_nSize && m_pText[m_nPosition] != '"' &&
+                   m_pText[m_nPosition] != '\\')
+            {
+                ++m_nPosition;
+            }
+            text.append(m_pText + start, m_nPosition - start);
+            if (m_nPosition >= m_nSize)
+            {
+                fail("unterminated string");
+            }
+            if (m_pText[m_nPosition++] == '"')
+            {
+                return;
+            }
+            const char escape = peek();
+            ++m_nPosition;
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                text += escape;
+                break;
+            case 'b':
+                text += '\b';
+                break;
+            case 'f':
+                text += '\f';
+                break;
+            case 'n':
+                text += '\n';
+                break;
+            case 'r':
+                text += '\r';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case 'u':
+            {
+                uint32_t codePoint = parseHex4();
+                // surrogate pair
+                if (codePoint >= 0xd800 && codePoint < 0xdc00 && peek() == '\\')
+                {
+                    ++m_nPosition;
+                    expect('u');
+                    const uint32_t low = parseHex4();
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(text, codePoint);
+                break;
+            }
+            default:
+                fail("invalid escape");
+            }
+        }
+    }
+
+    void parseNumber(JsonValue &value)
+    {
+        // the text may not be null terminated (GLB chunk), strtod reads a copy
+        const size_t start = m_nPosition;
+        while (m_nPosition < m_nSize)
+        {
+            const char c = m_pText[m_nPosition];
+            if ((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E')
+            {
+                break;
+            }
+            ++m_nPosition;
+        }
+        if (m_nPosition == start)
+        {
+            fail("unexpected character");
+        }
+        const std::string number(m_pText + start, m_nPosition - start);
+        char *end = nullptr;
+        value.m_Type = JsonValue::Type::Number;
+        value.m_dNumber = std::strtod(number.c_str(), &end);
+        if (end != number.c_str() + number.size())
+        {
+            m_nPosition = start;
+            fail("invalid number");
+        }
+    }
+
+    const char *m_pText;
+    size_t m_nSize;
+    size_t m_nPosition = 0;
+};
+
+JsonValue JsonValue::parse(const char *text, size_t size)
+{
+    return JsonParser(text, size).parseDocument();
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const
+{
+    return isArray() && index < m_Elements.size() ? m_Elements[index] : nullValue();
+}
+
+const JsonValue &JsonValue::operator[](const char *key) const
+{
+    for (const auto &member : m_Members)
+    {
+        if (member.first == key)
+        {
+            return member.second;
+        }
+    }
+    return nullValue();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON document, enough for glTF. Strings are kept in UTF-8 with their escapes
+// decoded, numbers are doubles, object members keep the file order and are looked up
+// linearly. Missing members and out of range elements read as null, so optional fields can be
+// chained: json["asset"]["version"].asString().
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    // Throws on malformed text, the message holds the byte offset.
+    static JsonValue parse(const char *text, size_t size);
+
+    Type type() const { return m_Type; }
+    bool isNull() const { return m_Type == Type::Null; }
+    bool isBool() const { return m_Type == Type::Bool; }
+    bool isNumber() const { return m_Type == Type::Number; }
+    bool isString() const { return m_Type == Type::String; }
+    bool isArray() const { return m_Type == Type::Array; }
+    bool isObject() const { return m_Type == Type::Object; }
+
+    // fallback when the value has another type
+    bool asBool(bool fallback = false) const { return isBool() ? m_bBool : fallback; }
+    double asNumber(double fallback = 0.) const { return isNumber() ? m_dNumber : fallback; }
+    const std::string &asString() const { return m_String; }
+
+    // elements of an array, members of an object
+    size_t size() const { return isArray() ? m_Elements.size() : m_Members.size(); }
+    const JsonValue &operator[](size_t index) const;
+    const JsonValue &operator[](const char *key) const;
+    bool has(const char *key) const { return !(*this)[key].isNull(); }
+    const std::vector<JsonValue> &elements() const { return m_Elements; }
+    const std::vector<std::pair<std::string, JsonValue>> &members() const { return m_Members; }
+
+private:
+    friend class JsonParser;
+
+    Type m_Type = Type::Null;
+    bool m_bBool = false;
+    double m_dNumber = 0.;
+    std::string m_String;
+    std::vector<JsonValue> m_Elements;
+    std::vector<std::pair<std::string, JsonValue>> m_Members;
+};
@@ -0,0 +1,45 @@
+#include "lod_selector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float projectionScale(float fovY, float viewportHeight)
+{
+    return viewportHeight / (2.f * std::tan(fovY * .5f));
+}
+
+void LODSelector::reset(size_t objectCount)
+{
+    m_CurrentLods.assign(objectCount, 0);
+}
+
+uint32_t LODSelector::select(size_t object, const float *errors, size_t lodCount, float distance,
+                             float scale)
+{
+    if (object >= m_CurrentLods.size())
+    {
+        m_CurrentLods.resize(object + 1, 0);
+    }
+    if (lodCount <= 1)
+    {
+        m_CurrentLods[object] = 0;
+        return 0;
+    }
+    // inside the bounds the error can't be bounded, full detail
+    const float pixelsPerUnit =
+        distance > 0.f ? m_fProjectionScale * scale / distance : INFINITY;
+    const float refineAbove = m_fThreshold * (1.f + m_fHysteresis);
+    const float coarsenBelow = m_fThreshold * (1.f - m_fHysteresis);
+
+    size_t lod = std::min<size_t>(m_CurrentLods[object], lodCount - 1);
+    while (lod > 0 && errors[lod] * pixelsPerUnit > refineAbove)
+    {
+        --lod;
+    }
+    while (lod + 1 < lodCount && errors[lod + 1] * pixelsPerUnit <= coarsenBelow)
+    {
+        ++lod;
+    }
+    m_CurrentLods[object] = uint8_t(lod);
+    return uint32_t(lod);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pixels covered by one world unit at distance 1 for a perspective projection.
+float projectionScale(float fovY, float viewportHeight);
+
+// Per object LOD choice by projected screen space error: an object uses its coarsest LOD
+// whose error, in pixels, stays under the threshold. With hysteresis h, the current LOD is
+// kept until its error exceeds threshold * (1 + h) and a coarser one is only taken once its
+// error is under threshold * (1 - h), so objects near a switching distance don't pop back
+// and forth.
+class LODSelector
+{
+public:
+    // Forgets the previous choices, every object restarts at LOD 0.
+    void reset(size_t objectCount);
+
+    void setProjectionScale(float scale) { m_fProjectionScale = scale; }
+    void setThreshold(float pixels) { m_fThreshold = pixels; }
+    void setHysteresis(float hysteresis) { m_fHysteresis = hysteresis; }
+    float threshold() const { return m_fThreshold; }
+    float hysteresis() const { return m_fHysteresis; }
+
+    // errors[i] is the object space error of LOD i, increasing, errors[0] is usually 0.
+    // distance is from the camera to the closest point of the object bounds, scale converts
+    // object to world units.
+    uint32_t select(size_t object, const float *errors, size_t lodCount, float distance,
+                    float scale = 1.f);
+
+private:
+    std::vector<uint8_t> m_CurrentLods;
+    float m_fProjectionScale = 1.f;
+    float m_fThreshold = 1.f;
+    float m_fHysteresis = .2f;
+};
@@ -0,0 +1,160 @@
+#include "mapped_file.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+[[noreturn]] void mapError(const fs::path &path, const char *reason)
+{
+    const std::string message = "Unable to map " + path.string() + ": " + reason;
+    std::cerr << message << std::endl;
+    throw std::runtime_error(message);
+}
+} // namespace
+
+#ifdef _WIN32
+MappedFile::MappedFile(const fs::path &path)
+{
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        mapError(path, "can't open");
+    }
+    m_pFile = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        unmap();
+        mapError(path, "can't read the size");
+    }
+    m_nSize = size_t(size.QuadPart);
+    if (m_nSize == 0)
+    {
+        return;
+    }
+    m_pMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_pMapping)
+    {
+        unmap();
+        mapError(path, "CreateFileMapping failed");
+    }
+    m_pData = static_cast<const uint8_t *>(MapViewOfFile(m_pMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_pData)
+    {
+        unmap();
+        mapError(path, "MapViewOfFile failed");
+    }
+}
+
+void MappedFile::unmap()
+{
+    if (m_pData)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_pMapping)
+    {
+        CloseHandle(m_pMapping);
+    }
+    if (m_pFile)
+    {
+        CloseHandle(m_pFile);
+    }
+    m_pData = nullptr;
+    m_pMapping = nullptr;
+    m_pFile = nullptr;
+    m_nSize = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&rvalue)
+    : m_pData(rvalue.m_pData), m_nSize(rvalue.m_nSize), m_pFile(rvalue.m_pFile),
+      m_pMapping(rvalue.m_pMapping)
+{
+    rvalue.m_pData = nullptr;
+    rvalue.m_nSize = 0;
+    rvalue.m_pFile = nullptr;
+    rvalue.m_pMapping = nullptr;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue)
+{
+    std::swap(m_pData, rvalue.m_pData);
+    std::swap(m_nSize, rvalue.m_nSize);
+    std::swap(m_pFile, rvalue.m_pFile);
+    std::swap(m_pMapping, rvalue.m_pMapping);
+    return *this;
+}
+#else
+MappedFile::MappedFile(const fs::path &path)
+{
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        mapError(path, "can't open");
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+        close(file);
+        mapError(path, "can't read the size");
+    }
+    m_nSize = size_t(status.st_size);
+    if (m_nSize > 0)
+    {
+        void *data = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED)
+        {
+            close(file);
+            m_nSize = 0;
+            mapError(path, "mmap failed");
+        }
+        m_pData = static_cast<const uint8_t *>(data);
+    }
+    // the mapping keeps its own reference to the file
+    close(file);
+}
+
+void MappedFile::unmap()
+{
+    if (m_pData)
+    {
+        munmap(const_cast<uint8_t *>(m_pData), m_nSize);
+    }
+    m_pData = nullptr;
+    m_nSize = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&rvalue) : m_pData(rvalue.m_pData), m_nSize(rvalue.m_nSize)
+{
+    rvalue.m_pData = nullptr;
+    rvalue.m_nSize = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue)
+{
+    std::swap(m_pData, rvalue.m_pData);
+    std::swap(m_nSize, rvalue.m_nSize);
+    return *this;
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Read only memory mapping of a whole file. Pages are read on first access and belong to the
+// page cache, so reading a large file through the mapping doesn't grow the heap and pages
+// that are never touched are never read.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    // Throws when the file can't be opened or mapped.
+    explicit MappedFile(const fs::path &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&rvalue);
+    MappedFile &operator=(MappedFile &&rvalue);
+
+    const uint8_t *data() const { return m_pData; }
+    size_t size() const { return m_nSize; }
+    bool empty() const { return m_nSize == 0; }
+
+private:
+    void unmap();
+
+    const uint8_t *m_pData = nullptr;
+    size_t m_nSize = 0;
+#ifdef _WIN32
+    void *m_pFile = nullptr;
+    void *m_pMapping = nullptr;
+#endif
+};
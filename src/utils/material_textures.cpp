@@ -0,0 +1,149 @@
+#include "material_textures.hpp"
+#include "texture_cooker.hpp"
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+static void setMaterialSampling(GLTexture &texture)
+{
+    texture.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    texture.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    texture.setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+    texture.setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+MaterialTextures::MaterialTextures(bool allowBindless)
+    : m_Mode(allowBindless && GLAD_GL_ARB_bindless_texture ? MaterialTextureMode::Bindless
+                                                           : MaterialTextureMode::TextureArray)
+{
+    std::clog << "Material textures: "
+              << (m_Mode == MaterialTextureMode::Bindless ? "bindless" : "texture array")
+              << std::endl;
+}
+
+MaterialTextures::~MaterialTextures()
+{
+    // before the textures are deleted with the members
+    for (auto handle : m_Handles)
+    {
+        glMakeTextureHandleNonResidentARB(handle);
+    }
+}
+
+uint32_t MaterialTextures::addTexture(const unsigned char *pixels, int width, int height,
+                                      int channels)
+{
+    Image image{width, height, std::vector<unsigned char>(size_t(width) * height * 4)};
+    for (size_t i = 0; i < size_t(width) * height; ++i)
+    {
+        const unsigned char *texel = pixels + i * channels;
+        unsigned char *rgba = image.rgba.data() + i * 4;
+        // grey and grey alpha images are expanded like GL does with GL_RED/GL_RG swizzles
+        rgba[0] = texel[0];
+        rgba[1] = channels >= 3 ? texel[1] : texel[0];
+        rgba[2] = channels >= 3 ? texel[2] : texel[0];
+        rgba[3] = channels == 4 ? texel[3] : channels == 2 ? texel[1] : 255;
+    }
+    m_Images.push_back(std::move(image));
+    return uint32_t(m_Images.size() - 1);
+}
+
+uint32_t MaterialTextures::addMaterial(const std::vector<uint32_t> &textures)
+{
+    if (textures.size() > MAX_MATERIAL_TEXTURES)
+    {
+        throw std::runtime_error("Too many textures in material");
+    }
+    m_Materials.push_back(textures);
+    return uint32_t(m_Materials.size() - 1);
+}
+
+void MaterialTextures::upload()
+{
+    if (m_Images.empty())
+    {
+        return;
+    }
+
+    if (m_Mode == MaterialTextureMode::Bindless)
+    {
+        for (const auto &image : m_Images)
+        {
+            // mips computed on the CPU, glGenerateMipmap quality varies with the driver
+            const CookedTexture chain =
+                cookMipChain(image.rgba.data(), image.width, image.height, 4, false);
+            GLTexture texture = createCookedTexture(chain, chain.data.data());
+            setMaterialSampling(texture);
+            // sampling state is frozen once a handle exists
+            const auto handle = glGetTextureHandleARB(texture.glId());
+            glMakeTextureHandleResidentARB(handle);
+            m_Textures.push_back(std::move(texture));
+            m_Handles.push_back(handle);
+        }
+    }
+    else
+    {
+        const int width = m_Images.front().width;
+        const int height = m_Images.front().height;
+        m_TextureArray = GLTexture(GL_TEXTURE_2D_ARRAY);
+        m_TextureArray.storage3D(mipLevelCount(width, height), GL_RGBA8, width, height,
+                                 GLsizei(m_Images.size()));
+        std::vector<unsigned char> resized;
+        for (size_t layer = 0; layer < m_Images.size(); ++layer)
+        {
+            const auto &image = m_Images[layer];
+            const unsigned char *pixels = image.rgba.data();
+            if (image.width != width || image.height != height)
+            {
+                resized.resize(size_t(width) * height * 4);
+                stbir_resize_uint8(image.rgba.data(), image.width, image.height, 0, resized.data(),
+                                   width, height, 0, 4);
+                pixels = resized.data();
+            }
+            const CookedTexture chain = cookMipChain(pixels, width, height, 4, false);
+            for (size_t level = 0; level < chain.levels.size(); ++level)
+            {
+                const CookedLevel &cooked = chain.levels[level];
+                m_TextureArray.subImage3D(GLint(level), 0, 0, GLint(layer), cooked.width,
+                                          cooked.height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                          chain.data.data() + cooked.offset);
+            }
+        }
+        setMaterialSampling(m_TextureArray);
+    }
+    // pixels live on the GPU from now on
+    m_Images.clear();
+    m_Images.shrink_to_fit();
+
+    std::vector<MaterialRecord> records(m_Materials.size());
+    for (size_t i = 0; i < m_Materials.size(); ++i)
+    {
+        for (size_t slot = 0; slot < m_Materials[i].size(); ++slot)
+        {
+            const auto texture = m_Materials[i][slot];
+            records[i].handles[slot] = m_Handles.empty() ? 0 : m_Handles[texture];
+            records[i].layers[slot] = texture;
+        }
+    }
+    m_MaterialBuffer.storage(records.size() * sizeof(MaterialRecord), records.data(), 0);
+}
+
+void MaterialTextures::bind(GLStateCache &state) const
+{
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIALS_BINDING, m_MaterialBuffer.glId());
+    if (m_Mode == MaterialTextureMode::TextureArray)
+    {
+        state.bindTexture(MATERIAL_ARRAY_UNIT, m_TextureArray.glId());
+    }
+}
+
+const char *MaterialTextures::fragmentShader() const
+{
+    return m_Mode == MaterialTextureMode::Bindless ? "material_bindless.fs.glsl"
+                                                   : "material_array.fs.glsl";
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "gl_state.hpp"
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Shader storage binding of the Materials buffer, see material_*.fs.glsl.
+const GLuint MATERIALS_BINDING = 0;
+// Texture unit of the array used by the texture array backend.
+const GLuint MATERIAL_ARRAY_UNIT = 0;
+const size_t MAX_MATERIAL_TEXTURES = 4;
+
+// std430 mirror of the Material struct declared in material_*.fs.glsl.
+// Only the member matching the active backend is meaningful.
+struct MaterialRecord
+{
+    uint64_t handles[MAX_MATERIAL_TEXTURES]; // bindless texture handles
+    uint32_t layers[MAX_MATERIAL_TEXTURES];  // layers of the texture array
+};
+static_assert(offsetof(MaterialRecord, layers) == 32, "MaterialRecord doesn't match std430");
+static_assert(sizeof(MaterialRecord) == 48, "MaterialRecord doesn't match std430");
+
+enum class MaterialTextureMode
+{
+    Bindless,
+    TextureArray
+};
+
+// Material texture backend: draws index their textures with a material ID instead of
+// binding texture units, so draws with different materials can share one multi draw.
+// Uses GL_ARB_bindless_texture handles stored in an SSBO when available, otherwise packs
+// every texture in the layers of a single GL_TEXTURE_2D_ARRAY (images of another size are
+// resized to the size of the first one).
+class MaterialTextures
+{
+public:
+    explicit MaterialTextures(bool allowBindless = true);
+    ~MaterialTextures();
+
+    MaterialTextures(const MaterialTextures &) = delete;
+    MaterialTextures &operator=(const MaterialTextures &) = delete;
+
+    // Pixels are copied, the returned index is used to build materials.
+    uint32_t addTexture(const unsigned char *pixels, int width, int height, int channels);
+    uint32_t addMaterial(const std::vector<uint32_t> &textures);
+
+    // Creates the GL textures and the material buffer from everything added so far.
+    void upload();
+
+    // Binds the material buffer, and the texture array in array mode.
+    void bind(GLStateCache &state) const;
+
+    MaterialTextureMode mode() const { return m_Mode; }
+    // Fragment shader matching the backend, relative to the shader directory.
+    const char *fragmentShader() const;
+    size_t materialCount() const { return m_Materials.size(); }
+
+private:
+    struct Image
+    {
+        int width, height;
+        std::vector<unsigned char> rgba;
+    };
+
+    MaterialTextureMode m_Mode;
+    std::vector<Image> m_Images;
+    std::vector<std::vector<uint32_t>> m_Materials;
+
+    GLBuffer m_MaterialBuffer;
+    GLTexture m_TextureArray;
+    std::vector<GLTexture> m_Textures;
+    std::vector<GLuint64> m_Handles;
+};
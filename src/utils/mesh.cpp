@@ -0,0 +1,72 @@
+#include "mesh.hpp"
+
+#include <cstddef>
+
+// C++14 needs a definition of the layouts applyVertexLayout() binds to a reference
+constexpr VertexLayout VertexLayoutOf<Vertex>::value;
+constexpr VertexLayout VertexLayoutOf<CompactVertex>::value;
+
+// Uploads the vertices in format V and sets the attributes up.
+template <typename V>
+static GLsizei uploadVertices(GLVertexArray &vao, GLBuffer &vbo, const std::vector<V> &vertices)
+{
+    vbo.storage(vertices.size() * sizeof(V), vertices.data(), 0);
+    vao.setLayout<V>(MESH_VERTEX_BINDING);
+    vao.setVertexBuffer(MESH_VERTEX_BINDING, vbo.glId(), 0, sizeof(V));
+    return GLsizei(sizeof(V));
+}
+
+Mesh::Mesh(const MeshData &data, size_t inputVertices, VertexFormat format,
+           const std::vector<MeshLOD> &lods)
+    : m_VertexFormat(format)
+{
+    switch (format)
+    {
+    case VertexFormat::Float:
+        m_nVertexStride = uploadVertices(m_VAO, m_VBO, data.vertices);
+        break;
+    case VertexFormat::Compact:
+        m_nVertexStride =
+            uploadVertices(m_VAO, m_VBO, encodeVertices<CompactVertex>(data.vertices));
+        break;
+    }
+
+    // every level in one index buffer
+    std::vector<uint32_t> allIndices(data.indices);
+    m_LODErrors.push_back(0.f);
+    for (const auto &lod : lods)
+    {
+        allIndices.insert(end(allIndices), begin(lod.indices), end(lod.indices));
+        m_LODErrors.push_back(lod.error);
+    }
+    m_IndexType = data.vertices.size() <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    GLuint first = 0;
+    m_LODRanges.push_back(DrawRange{m_IndexType, GLuint(data.indices.size()), first, 0});
+    first += GLuint(data.indices.size());
+    for (const auto &lod : lods)
+    {
+        m_LODRanges.push_back(DrawRange{m_IndexType, GLuint(lod.indices.size()), first, 0});
+        first += GLuint(lod.indices.size());
+    }
+
+    if (m_IndexType == GL_UNSIGNED_SHORT)
+    {
+        std::vector<uint16_t> indices(begin(allIndices), end(allIndices));
+        m_nIndexSize = sizeof(uint16_t);
+        m_EBO.storage(indices.size() * m_nIndexSize, indices.data(), 0);
+    }
+    else
+    {
+        m_nIndexSize = sizeof(uint32_t);
+        m_EBO.storage(allIndices.size() * m_nIndexSize, allIndices.data(), 0);
+    }
+    m_VAO.setElementBuffer(m_EBO.glId());
+
+    for (const auto &vertex : data.vertices)
+    {
+        m_Bounds.extend(vertex.position);
+    }
+
+    m_Stats = computeMeshStats(data, inputVertices ? inputVertices : data.indices.size(),
+                               m_nIndexSize, size_t(m_nVertexStride));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "mesh_builder.hpp"
+#include "mesh_simplifier.hpp"
+#include "render_queue.hpp"
+#include "vertex_formats.hpp"
+#include <glad/glad.h>
+
+const GLuint MESH_VERTEX_BINDING = 0;
+
+// GPU copy of a MeshData: owns its VAO, vertex and index buffers.
+// Vertex attributes: 0 position, 1 texture coordinates, 2 normal, read from vertex buffer
+// binding MESH_VERTEX_BINDING in the requested VertexFormat.
+// Indices are stored on 16 bits whenever the vertex count allows it.
+// Levels of detail share the vertex buffer, their indices follow the full detail ones in the
+// index buffer. LOD 0 is the full detail mesh.
+class Mesh
+{
+public:
+    Mesh(const MeshData &data, size_t inputVertices = 0,
+         VertexFormat format = VertexFormat::Float, const std::vector<MeshLOD> &lods = {});
+
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+
+    GLuint vao() const { return m_VAO.glId(); }
+    VertexFormat vertexFormat() const { return m_VertexFormat; }
+    GLsizei vertexStride() const { return m_nVertexStride; }
+    GLenum indexType() const { return m_IndexType; }
+    GLsizei indexCount(size_t lod = 0) const { return GLsizei(m_LODRanges[lod].count); }
+    DrawRange drawRange(size_t lod = 0) const { return m_LODRanges[lod]; }
+    size_t lodCount() const { return m_LODRanges.size(); }
+    // object space error of each LOD, increasing, 0 for LOD 0
+    const std::vector<float> &lodErrors() const { return m_LODErrors; }
+    const MeshStats &stats() const { return m_Stats; }
+    // object space
+    const AABB &bounds() const { return m_Bounds; }
+
+    // Expects the VAO to be bound.
+    void draw(size_t lod = 0) const
+    {
+        glDrawElements(GL_TRIANGLES, indexCount(lod), m_IndexType, indexOffset(lod));
+    }
+    void drawInstanced(GLsizei instanceCount, size_t lod = 0) const
+    {
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount(lod), m_IndexType, indexOffset(lod),
+                                instanceCount);
+    }
+
+private:
+    const void *indexOffset(size_t lod) const
+    {
+        return reinterpret_cast<const void *>(size_t(m_LODRanges[lod].first) * m_nIndexSize);
+    }
+
+    GLVertexArray m_VAO;
+    GLBuffer m_VBO;
+    GLBuffer m_EBO;
+    VertexFormat m_VertexFormat = VertexFormat::Float;
+    GLsizei m_nVertexStride = 0;
+    GLenum m_IndexType = GL_UNSIGNED_INT;
+    size_t m_nIndexSize = sizeof(uint32_t);
+    std::vector<DrawRange> m_LODRanges;
+    std::vector<float> m_LODErrors;
+    MeshStats m_Stats;
+    AABB m_Bounds;
+};
@@ -0,0 +1,85 @@
+#include "mesh_builder.hpp"
+
+#include <cstring>
+
+// -0.f and 0.f must weld, compare and hash the canonical bits
+static uint32_t floatBits(float value)
+{
+    value = value == 0.f ? 0.f : value;
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+size_t MeshBuilder::VertexHash::operator()(const Vertex &vertex) const
+{
+    const float values[] = {vertex.position.x, vertex.position.y, vertex.position.z,
+                            vertex.normal.x, vertex.normal.y, vertex.normal.z,
+                            vertex.texCoord.x, vertex.texCoord.y};
+    // FNV-1a over the canonical float bits
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto value : values)
+    {
+        hash ^= floatBits(value);
+        hash *= 1099511628211ull;
+    }
+    return size_t(hash);
+}
+
+bool MeshBuilder::VertexEqual::operator()(const Vertex &a, const Vertex &b) const
+{
+    return a.position == b.position && a.normal == b.normal && a.texCoord == b.texCoord;
+}
+
+uint32_t MeshBuilder::addVertex(const Vertex &vertex)
+{
+    ++m_nInputVertices;
+    const auto inserted =
+        m_VertexIndices.emplace(vertex, uint32_t(m_Data.vertices.size()));
+    if (inserted.second)
+    {
+        m_Data.vertices.push_back(vertex);
+    }
+    const auto index = inserted.first->second;
+    m_Data.indices.push_back(index);
+    return index;
+}
+
+void MeshBuilder::addTriangle(const Vertex &a, const Vertex &b, const Vertex &c)
+{
+    addVertex(a);
+    addVertex(b);
+    addVertex(c);
+}
+
+size_t countTransformedVertices(const std::vector<uint32_t> &indices, size_t vertexCount,
+                                size_t cacheSize)
+{
+    // a vertex is still cached while less than cacheSize vertices were transformed after it
+    std::vector<size_t> transformedAt(vertexCount, 0);
+    size_t transformed = 0;
+    for (const auto index : indices)
+    {
+        if (transformedAt[index] && transformed - transformedAt[index] < cacheSize)
+        {
+            continue;
+        }
+        transformedAt[index] = ++transformed;
+    }
+    return transformed;
+}
+
+MeshStats computeMeshStats(const MeshData &mesh, size_t inputVertices, size_t indexSize,
+                           size_t vertexSize)
+{
+    MeshStats stats;
+    stats.inputVertices = inputVertices;
+    stats.vertices = mesh.vertices.size();
+    stats.triangles = mesh.indices.size() / 3;
+    const auto transformed = countTransformedVertices(mesh.indices, mesh.vertices.size());
+    stats.acmr = stats.triangles ? float(transformed) / stats.triangles : 0.f;
+    stats.atvr = stats.vertices ? float(transformed) / stats.vertices : 0.f;
+    stats.unindexedBytes = inputVertices * sizeof(Vertex);
+    stats.indexedBytes = mesh.vertices.size() * vertexSize + mesh.indices.size() * indexSize;
+    return stats;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+// Indexed triangle list, CPU side.
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct MeshStats
+{
+    size_t inputVertices = 0; // vertices fed to the builder, one per triangle corner
+    size_t vertices = 0;      // after welding
+    size_t triangles = 0;
+    float acmr = 0.f;         // post-transform cache misses per triangle
+    float atvr = 0.f;         // post-transform cache misses per vertex, 1 is optimal
+    size_t unindexedBytes = 0;
+    size_t indexedBytes = 0;  // vertex + index buffers
+};
+
+// Builds an indexed mesh from triangle corners, welding corners with identical
+// position, normal and texture coordinates into a single vertex.
+class MeshBuilder
+{
+public:
+    uint32_t addVertex(const Vertex &vertex);
+    void addTriangle(const Vertex &a, const Vertex &b, const Vertex &c);
+
+    const MeshData &data() const { return m_Data; }
+    size_t inputVertexCount() const { return m_nInputVertices; }
+    MeshData build() { return std::move(m_Data); }
+
+private:
+    struct VertexHash
+    {
+        size_t operator()(const Vertex &vertex) const;
+    };
+    struct VertexEqual
+    {
+        bool operator()(const Vertex &a, const Vertex &b) const;
+    };
+
+    MeshData m_Data;
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> m_VertexIndices;
+    size_t m_nInputVertices = 0;
+};
+
+// Simulates a FIFO post-transform cache and returns the number of vertex shader invocations.
+size_t countTransformedVertices(const std::vector<uint32_t> &indices, size_t vertexCount,
+                                size_t cacheSize = 16);
+
+// vertexSize is the size of the GPU vertex, unindexedBytes always counts full float vertices.
+MeshStats computeMeshStats(const MeshData &mesh, size_t inputVertices, size_t indexSize,
+                           size_t vertexSize = sizeof(Vertex));
@@ -0,0 +1,270 @@
+#include "mesh_io.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+const char MESH_BINARY_MAGIC[4] = {'T', 'M', 'S', 'H'};
+// version 2 appends the LOD chain
+const uint32_t MESH_BINARY_VERSION = 2;
+
+struct MeshBinaryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+};
+
+[[noreturn]] void meshIOError(const std::string &message)
+{
+    std::cerr << message << std::endl;
+    throw std::runtime_error(message);
+}
+
+// OBJ indices are 1-based, negative ones count back from the last element
+int resolveObjIndex(int index, size_t count)
+{
+    return index < 0 ? int(count) + index : index - 1;
+}
+
+struct ObjCorner
+{
+    int position, texCoord, normal;
+};
+
+ObjCorner parseObjCorner(const std::string &token)
+{
+    ObjCorner corner = {0, 0, 0};
+    int *fields[3] = {&corner.position, &corner.texCoord, &corner.normal};
+    size_t field = 0, start = 0;
+    while (field < 3 && start <= token.size())
+    {
+        const auto slash = token.find('/', start);
+        const auto value = token.substr(start, slash == std::string::npos ? slash : slash - start);
+        if (!value.empty())
+        {
+            *fields[field] = std::stoi(value);
+        }
+        if (slash == std::string::npos)
+        {
+            break;
+        }
+        start = slash + 1;
+        ++field;
+    }
+    return corner;
+}
+} // namespace
+
+MeshData loadObjMesh(const std::string &path, size_t *inputVertices)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        meshIOError("Unable to open OBJ file " + path);
+    }
+
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<ObjCorner> face, triangles;
+    std::string line, keyword, token;
+    size_t lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        std::istringstream tokens(line);
+        if (!(tokens >> keyword))
+        {
+            continue;
+        }
+        if (keyword == "v")
+        {
+            glm::vec3 position;
+            tokens >> position.x >> position.y >> position.z;
+            positions.push_back(position);
+        }
+        else if (keyword == "vt")
+        {
+            glm::vec2 texCoord;
+            tokens >> texCoord.x >> texCoord.y;
+            texCoords.push_back(texCoord);
+        }
+        else if (keyword == "vn")
+        {
+            glm::vec3 normal;
+            tokens >> normal.x >> normal.y >> normal.z;
+            normals.push_back(normal);
+        }
+        else if (keyword == "f")
+        {
+            face.clear();
+            while (tokens >> token)
+            {
+                auto corner = parseObjCorner(token);
+                corner.position = resolveObjIndex(corner.position, positions.size());
+                corner.texCoord =
+                    corner.texCoord ? resolveObjIndex(corner.texCoord, texCoords.size()) : -1;
+                corner.normal =
+                    corner.normal ? resolveObjIndex(corner.normal, normals.size()) : -1;
+                if (corner.position < 0 || size_t(corner.position) >= positions.size() ||
+                    size_t(corner.texCoord + 1) > texCoords.size() ||
+                    size_t(corner.normal + 1) > normals.size())
+                {
+                    std::stringstream ss;
+                    ss << path << ":" << lineNumber << ": face index out of range";
+                    meshIOError(ss.str());
+                }
+                face.push_back(corner);
+            }
+
+            for (size_t i = 2; i < face.size(); ++i)
+            {
+                triangles.push_back(face[0]);
+                triangles.push_back(face[i - 1]);
+                triangles.push_back(face[i]);
+            }
+        }
+    }
+
+    // missing normals are smoothed: area weighted face normals summed per position
+    std::vector<glm::vec3> smoothNormals(positions.size(), glm::vec3(0.f));
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const auto &a = positions[triangles[i].position];
+        const auto faceNormal = glm::cross(positions[triangles[i + 1].position] - a,
+                                           positions[triangles[i + 2].position] - a);
+        for (size_t c = 0; c < 3; ++c)
+        {
+            smoothNormals[triangles[i + c].position] += faceNormal;
+        }
+    }
+
+    MeshBuilder builder;
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        Vertex vertices[3];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const auto &corner = triangles[i + c];
+            vertices[c].position = positions[corner.position];
+            vertices[c].texCoord =
+                corner.texCoord >= 0 ? texCoords[corner.texCoord] : glm::vec2(0.f);
+            const auto &smooth = smoothNormals[corner.position];
+            const float length = glm::length(smooth);
+            vertices[c].normal = corner.normal >= 0 ? normals[corner.normal]
+                                 : length > 0.f     ? smooth / length
+                                                    : glm::vec3(0.f);
+        }
+        builder.addTriangle(vertices[0], vertices[1], vertices[2]);
+    }
+
+    if (inputVertices)
+    {
+        *inputVertices = builder.inputVertexCount();
+    }
+    return builder.build();
+}
+
+void saveMeshBinary(const std::string &path, const MeshData &mesh,
+                    const std::vector<MeshLOD> &lods)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        meshIOError("Unable to create mesh file " + path);
+    }
+    MeshBinaryHeader header;
+    std::memcpy(header.magic, MESH_BINARY_MAGIC, sizeof(header.magic));
+    header.version = MESH_BINARY_VERSION;
+    header.vertexCount = uint32_t(mesh.vertices.size());
+    header.indexCount = uint32_t(mesh.indices.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(mesh.vertices.data()),
+              mesh.vertices.size() * sizeof(Vertex));
+    out.write(reinterpret_cast<const char *>(mesh.indices.data()),
+              mesh.indices.size() * sizeof(uint32_t));
+    const uint32_t lodCount = uint32_t(lods.size());
+    out.write(reinterpret_cast<const char *>(&lodCount), sizeof(lodCount));
+    for (const auto &lod : lods)
+    {
+        const uint32_t indexCount = uint32_t(lod.indices.size());
+        out.write(reinterpret_cast<const char *>(&lod.error), sizeof(lod.error));
+        out.write(reinterpret_cast<const char *>(&indexCount), sizeof(indexCount));
+        out.write(reinterpret_cast<const char *>(lod.indices.data()),
+                  lod.indices.size() * sizeof(uint32_t));
+    }
+    if (!out)
+    {
+        meshIOError("Unable to write mesh file " + path);
+    }
+}
+
+MeshData loadMeshBinary(const std::string &path, std::vector<MeshLOD> *lods)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        meshIOError("Unable to open mesh file " + path);
+    }
+    MeshBinaryHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, MESH_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version < 1 || header.version > MESH_BINARY_VERSION)
+    {
+        meshIOError("Not a mesh file, or a newer version: " + path);
+    }
+
+    MeshData mesh;
+    mesh.vertices.resize(header.vertexCount);
+    mesh.indices.resize(header.indexCount);
+    in.read(reinterpret_cast<char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+    in.read(reinterpret_cast<char *>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+    std::vector<MeshLOD> fileLods;
+    uint32_t lodCount = 0;
+    if (header.version >= 2)
+    {
+        in.read(reinterpret_cast<char *>(&lodCount), sizeof(lodCount));
+    }
+    for (uint32_t i = 0; i < lodCount && in; ++i)
+    {
+        MeshLOD lod;
+        uint32_t indexCount = 0;
+        in.read(reinterpret_cast<char *>(&lod.error), sizeof(lod.error));
+        in.read(reinterpret_cast<char *>(&indexCount), sizeof(indexCount));
+        if (!in || indexCount > header.indexCount)
+        {
+            meshIOError("Invalid level of detail in mesh file " + path);
+        }
+        lod.indices.resize(indexCount);
+        in.read(reinterpret_cast<char *>(lod.indices.data()), indexCount * sizeof(uint32_t));
+        fileLods.push_back(std::move(lod));
+    }
+    if (!in)
+    {
+        meshIOError("Truncated mesh file " + path);
+    }
+    const auto checkIndices = [&](const std::vector<uint32_t> &indices) {
+        for (const auto index : indices)
+        {
+            if (index >= header.vertexCount)
+            {
+                meshIOError("Index out of range in mesh file " + path);
+            }
+        }
+    };
+    checkIndices(mesh.indices);
+    for (const auto &lod : fileLods)
+    {
+        checkIndices(lod.indices);
+    }
+    if (lods)
+    {
+        *lods = std::move(fileLods);
+    }
+    return mesh;
+}
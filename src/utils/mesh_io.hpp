@@ -0,0 +1,18 @@
+#pragma once
+
+#include "mesh_builder.hpp"
+#include "mesh_simplifier.hpp"
+
+#include <string>
+
+// Wavefront OBJ triangles and polygons (fan triangulated). Corners without normals get a
+// smooth normal averaged over the faces sharing their position. Corners are welded by
+// MeshBuilder, inputVertices receives the corner count.
+MeshData loadObjMesh(const std::string &path, size_t *inputVertices = nullptr);
+
+// Binary cache of an optimized mesh: "TMSH" magic, version, vertex and index counts, then
+// the raw Vertex and uint32_t arrays in native byte order. Version 2 follows with the LOD
+// count and, per LOD, its error, index count and indices. Version 1 files load without LODs.
+void saveMeshBinary(const std::string &path, const MeshData &mesh,
+                    const std::vector<MeshLOD> &lods = {});
+MeshData loadMeshBinary(const std::string &path, std::vector<MeshLOD> *lods = nullptr);
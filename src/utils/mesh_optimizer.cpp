@@ -0,0 +1,389 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const size_t FORSYTH_CACHE_SIZE = 32;
+const size_t FORSYTH_MAX_VALENCE = 64;
+
+struct ForsythScores
+{
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE];
+
+    ForsythScores()
+    {
+        for (size_t i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+        {
+            // the three vertices of the last triangle get a fixed score so it isn't reused right away
+            cache[i] = i < 3 ? 0.75f
+                             : std::pow(1.f - float(i - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        valence[0] = 0.f;
+        for (size_t i = 1; i < FORSYTH_MAX_VALENCE; ++i)
+        {
+            // favor vertices with few triangles left, to get rid of them
+            valence[i] = 2.f * std::pow(float(i), -0.5f);
+        }
+    }
+
+    float vertexScore(int cachePosition, uint32_t liveTriangles) const
+    {
+        if (liveTriangles == 0)
+        {
+            return -1.f;
+        }
+        const float cacheScore = cachePosition >= 0 ? cache[cachePosition] : 0.f;
+        return cacheScore + valence[std::min<size_t>(liveTriangles, FORSYTH_MAX_VALENCE - 1)];
+    }
+};
+} // namespace
+
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices,
+                                          size_t vertexCount)
+{
+    static const ForsythScores scores;
+    const size_t triangleCount = indices.size() / 3;
+
+    // vertex to triangle adjacency, compressed rows; live triangles are kept at the front
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (const auto index : indices)
+    {
+        ++liveTriangles[index];
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangles[vertex];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(begin(adjacencyOffsets), end(adjacencyOffsets) - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        vertexScore[vertex] = scores.vertexScore(-1, liveTriangles[vertex]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        triangleScore[triangle] = vertexScore[indices[3 * triangle]] +
+                                  vertexScore[indices[3 * triangle + 1]] +
+                                  vertexScore[indices[3 * triangle + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t cursor = 0; // first triangle that may not be emitted yet
+    int64_t best = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best < 0)
+        {
+            // the cache holds no live triangle: restart from the best scoring one left
+            while (emitted[cursor])
+            {
+                ++cursor;
+            }
+            best = int64_t(cursor);
+            for (size_t triangle = cursor + 1; triangle < triangleCount; ++triangle)
+            {
+                if (!emitted[triangle] && triangleScore[triangle] > triangleScore[size_t(best)])
+                {
+                    best = int64_t(triangle);
+                }
+            }
+        }
+
+        const uint32_t *triangleIndices = &indices[3 * size_t(best)];
+        result.insert(end(result), triangleIndices, triangleIndices + 3);
+        emitted[size_t(best)] = true;
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const auto vertex = triangleIndices[corner];
+            // swap the triangle out of the live part of the vertex row
+            const auto rowBegin = begin(adjacency) + adjacencyOffsets[vertex];
+            const auto rowLive = rowBegin + liveTriangles[vertex];
+            std::iter_swap(std::find(rowBegin, rowLive, uint32_t(best)), rowLive - 1);
+            --liveTriangles[vertex];
+        }
+
+        // the triangle's vertices move to the front of the LRU cache
+        nextCache.assign(triangleIndices, triangleIndices + 3);
+        for (const auto vertex : cache)
+        {
+            if (vertex != triangleIndices[0] && vertex != triangleIndices[1] &&
+                vertex != triangleIndices[2])
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+        for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); ++i)
+        {
+            cachePosition[nextCache[i]] = -1;
+            vertexScore[nextCache[i]] = scores.vertexScore(-1, liveTriangles[nextCache[i]]);
+        }
+        for (size_t i = 0; i < std::min(nextCache.size(), FORSYTH_CACHE_SIZE); ++i)
+        {
+            cachePosition[nextCache[i]] = int(i);
+            vertexScore[nextCache[i]] = scores.vertexScore(int(i), liveTriangles[nextCache[i]]);
+        }
+        // triangles of evicted vertices lost score, the restart reads it
+        for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); ++i)
+        {
+            const auto rowBegin = adjacencyOffsets[nextCache[i]];
+            for (auto j = rowBegin; j < rowBegin + liveTriangles[nextCache[i]]; ++j)
+            {
+                const auto triangle = adjacency[j];
+                triangleScore[triangle] = vertexScore[indices[3 * triangle]] +
+                                          vertexScore[indices[3 * triangle + 1]] +
+                                          vertexScore[indices[3 * triangle + 2]];
+            }
+        }
+        if (nextCache.size() > FORSYTH_CACHE_SIZE)
+        {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        std::swap(cache, nextCache);
+
+        // only triangles around cached vertices changed score, the next one is among them
+        best = -1;
+        float bestScore = -1.f;
+        for (const auto vertex : cache)
+        {
+            const auto rowBegin = adjacencyOffsets[vertex];
+            for (auto i = rowBegin; i < rowBegin + liveTriangles[vertex]; ++i)
+            {
+                const auto triangle = adjacency[i];
+                const float score = vertexScore[indices[3 * triangle]] +
+                                    vertexScore[indices[3 * triangle + 1]] +
+                                    vertexScore[indices[3 * triangle + 2]];
+                triangleScore[triangle] = score;
+                if (score > bestScore || (score == bestScore && int64_t(triangle) < best))
+                {
+                    best = int64_t(triangle);
+                    bestScore = score;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t> &indices,
+                                       const std::vector<Vertex> &vertices, float threshold,
+                                       size_t cacheSize, size_t *clusters)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        if (clusters)
+        {
+            *clusters = 0;
+        }
+        return indices;
+    }
+
+    // simulated FIFO cache, flush() makes every vertex miss again
+    std::vector<size_t> transformedAt(vertices.size(), 0);
+    size_t transformed = 0;
+    const auto drawTriangle = [&](size_t triangle) {
+        int misses = 0;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const auto index = indices[3 * triangle + corner];
+            if (!transformedAt[index] || transformed - transformedAt[index] >= cacheSize)
+            {
+                transformedAt[index] = ++transformed;
+                ++misses;
+            }
+        }
+        return misses;
+    };
+    const auto flush = [&]() { transformed += cacheSize; };
+
+    // hard cluster boundaries: triangles where the cache restarts
+    std::vector<size_t> hardStarts;
+    size_t meshMisses = 0;
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        const int misses = drawTriangle(triangle);
+        meshMisses += size_t(misses);
+        if (triangle == 0 || misses == 3)
+        {
+            hardStarts.push_back(triangle);
+        }
+    }
+    hardStarts.push_back(triangleCount);
+
+    // soft boundaries: a cluster ends once it is as cache efficient as the mesh, within the
+    // threshold, even when drawn after any other cluster
+    const float targetAcmr = threshold * float(meshMisses) / float(triangleCount);
+    std::vector<size_t> clusterStarts;
+    for (size_t hard = 0; hard + 1 < hardStarts.size(); ++hard)
+    {
+        clusterStarts.push_back(hardStarts[hard]);
+        flush();
+        size_t misses = 0, triangles = 0;
+        for (size_t triangle = hardStarts[hard]; triangle < hardStarts[hard + 1]; ++triangle)
+        {
+            misses += size_t(drawTriangle(triangle));
+            ++triangles;
+            if (float(misses) < targetAcmr * float(triangles) &&
+                triangle + 1 < hardStarts[hard + 1])
+            {
+                clusterStarts.push_back(triangle + 1);
+                flush();
+                misses = triangles = 0;
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    const size_t clusterCount = clusterStarts.size() - 1;
+    if (clusters)
+    {
+        *clusters = clusterCount;
+    }
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.f));
+    std::vector<float> clusterAreas(clusterCount, 0.f);
+    glm::vec3 meshCentroid(0.f);
+    float meshArea = 0.f;
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        for (size_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1];
+             ++triangle)
+        {
+            const auto &a = vertices[indices[3 * triangle]].position;
+            const auto &b = vertices[indices[3 * triangle + 1]].position;
+            const auto &c = vertices[indices[3 * triangle + 2]].position;
+            const auto areaNormal = glm::cross(b - a, c - a); // twice the area, area weighted
+            const float area = glm::length(areaNormal);
+            clusterCentroids[cluster] += area * (a + b + c) / 3.f;
+            clusterNormals[cluster] += areaNormal;
+            clusterAreas[cluster] += area;
+        }
+        meshCentroid += clusterCentroids[cluster];
+        meshArea += clusterAreas[cluster];
+    }
+    meshCentroid = meshArea > 0.f ? meshCentroid / meshArea : meshCentroid;
+
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        const auto centroid = clusterAreas[cluster] > 0.f
+                                  ? clusterCentroids[cluster] / clusterAreas[cluster]
+                                  : meshCentroid;
+        const float normalLength = glm::length(clusterNormals[cluster]);
+        const auto normal =
+            normalLength > 0.f ? clusterNormals[cluster] / normalLength : glm::vec3(0.f);
+        sortKeys[cluster] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    // outward facing, outer clusters first; stable so equal keys keep the cache order
+    std::vector<size_t> order(clusterCount);
+    for (size_t i = 0; i < clusterCount; ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(begin(order), end(order),
+                     [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const auto cluster : order)
+    {
+        result.insert(end(result), begin(indices) + 3 * clusterStarts[cluster],
+                      begin(indices) + 3 * clusterStarts[cluster + 1]);
+    }
+    return result;
+}
+
+std::vector<uint32_t> optimizeVertexFetch(MeshData &mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), ~0u);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (auto &index : mesh.indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = uint32_t(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+    return remap;
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount,
+                                    size_t cacheSize)
+{
+    VertexCacheStats stats;
+    const auto transformed = countTransformedVertices(indices, vertexCount, cacheSize);
+    const size_t triangleCount = indices.size() / 3;
+    stats.acmr = triangleCount ? float(transformed) / triangleCount : 0.f;
+    stats.atvr = vertexCount ? float(transformed) / vertexCount : 0.f;
+    return stats;
+}
+
+VertexFetchStats analyzeVertexFetch(const std::vector<uint32_t> &indices, size_t vertexCount,
+                                    size_t vertexSize)
+{
+    const size_t lineSize = 64;
+    const size_t cacheLines = 64;
+
+    VertexFetchStats stats;
+    const size_t lineCount = (vertexCount * vertexSize + lineSize - 1) / lineSize;
+    std::vector<size_t> fetchedAt(lineCount, 0);
+    size_t fetched = 0;
+    for (const auto index : indices)
+    {
+        const size_t firstLine = index * vertexSize / lineSize;
+        const size_t lastLine = ((index + 1) * vertexSize - 1) / lineSize;
+        for (size_t line = firstLine; line <= lastLine; ++line)
+        {
+            if (!fetchedAt[line] || fetched - fetchedAt[line] >= cacheLines)
+            {
+                fetchedAt[line] = ++fetched;
+            }
+        }
+    }
+    stats.bytesFetched = fetched * lineSize;
+    stats.overfetch =
+        vertexCount ? float(stats.bytesFetched) / float(vertexCount * vertexSize) : 0.f;
+    return stats;
+}
+
+MeshOptimizationReport optimizeMesh(MeshData &mesh, size_t vertexSize)
+{
+    MeshOptimizationReport report;
+    report.cacheBefore = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    report.fetchBefore = analyzeVertexFetch(mesh.indices, mesh.vertices.size(), vertexSize);
+
+    mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    mesh.indices = optimizeOverdraw(mesh.indices, mesh.vertices, 1.05f, 16,
+                                    &report.overdrawClusters);
+    optimizeVertexFetch(mesh);
+
+    report.cacheAfter = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    report.fetchAfter = analyzeVertexFetch(mesh.indices, mesh.vertices.size(), vertexSize);
+    return report;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "mesh_builder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats
+{
+    float acmr = 0.f; // transformed vertices per triangle, 0.5 is the lower bound
+    float atvr = 0.f; // transformed vertices per vertex, 1 is optimal
+};
+
+struct VertexFetchStats
+{
+    size_t bytesFetched = 0;
+    float overfetch = 0.f; // bytes fetched per byte of vertex data, 1 is optimal
+};
+
+struct MeshOptimizationReport
+{
+    VertexCacheStats cacheBefore, cacheAfter;
+    VertexFetchStats fetchBefore, fetchAfter;
+    size_t overdrawClusters = 0;
+};
+
+// All optimizations are deterministic: the same input always gives the same output,
+// so their results can be cached on disk (see mesh_io.hpp).
+
+// Reorders triangles for post-transform cache reuse (Forsyth's linear-speed algorithm,
+// simulating a 32 entry LRU cache).
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices,
+                                          size_t vertexCount);
+
+// Reorders clusters of a cache optimized index buffer so triangles likely to occlude
+// the others are drawn first. As in Tipsify, clusters are split where the cache restarts
+// (all three vertices miss), and also as soon as the ACMR of the cluster drawn from a cold
+// cache drops below threshold times the ACMR of the mesh, so a threshold above 1 bounds
+// the cache cost of the reordering. Clusters are sorted by how much they face away from
+// the mesh center. clusters, when given, receives the number of clusters.
+std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t> &indices,
+                                       const std::vector<Vertex> &vertices,
+                                       float threshold = 1.05f, size_t cacheSize = 16,
+                                       size_t *clusters = nullptr);
+
+// Reorders vertices by first use in the index buffer and remaps the indices.
+// Unreferenced vertices are dropped. Returns the old to new index remap (~0u when dropped).
+std::vector<uint32_t> optimizeVertexFetch(MeshData &mesh);
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount,
+                                    size_t cacheSize = 16);
+// Simulates a small FIFO cache of 64 byte lines in front of the vertex buffer.
+VertexFetchStats analyzeVertexFetch(const std::vector<uint32_t> &indices, size_t vertexCount,
+                                    size_t vertexSize);
+
+// Vertex cache, overdraw then vertex fetch optimization. vertexSize is the size of the GPU
+// vertex, the fetch statistics simulate that vertex buffer.
+MeshOptimizationReport optimizeMesh(MeshData &mesh, size_t vertexSize = sizeof(Vertex));
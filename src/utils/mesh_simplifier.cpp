@@ -0,0 +1,330 @@
+#include "mesh_simplifier.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+
+// Symmetric 4x4 matrix of the squared distance to a set of planes, with the total weight of
+// the planes so errors are averaged distances whatever the triangle areas.
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    void addPlane(const glm::dvec3 &normal, double distance, double planeWeight)
+    {
+        a00 += planeWeight * normal.x * normal.x;
+        a01 += planeWeight * normal.x * normal.y;
+        a02 += planeWeight * normal.x * normal.z;
+        a03 += planeWeight * normal.x * distance;
+        a11 += planeWeight * normal.y * normal.y;
+        a12 += planeWeight * normal.y * normal.z;
+        a13 += planeWeight * normal.y * distance;
+        a22 += planeWeight * normal.z * normal.z;
+        a23 += planeWeight * normal.z * distance;
+        a33 += planeWeight * distance * distance;
+        weight += planeWeight;
+    }
+
+    void add(const Quadric &other)
+    {
+        a00 += other.a00, a01 += other.a01, a02 += other.a02, a03 += other.a03;
+        a11 += other.a11, a12 += other.a12, a13 += other.a13;
+        a22 += other.a22, a23 += other.a23;
+        a33 += other.a33;
+        weight += other.weight;
+    }
+
+    // mean squared distance of p to the planes
+    double error(const glm::vec3 &p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        const double sum = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x +
+                           a11 * y * y + 2 * a12 * y * z + 2 * a13 * y + a22 * z * z +
+                           2 * a23 * z + a33;
+        return weight > 0 ? std::abs(sum) / weight : 0.;
+    }
+};
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double cost;
+
+    bool operator<(const Collapse &other) const { return cost < other.cost; }
+};
+
+struct PositionHash
+{
+    size_t operator()(const glm::vec3 &position) const
+    {
+        uint32_t bits[3];
+        std::memcpy(bits, &position, sizeof(bits));
+        return size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+    }
+};
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+glm::vec3 triangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+} // namespace
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t> &indices,
+                                   const std::vector<Vertex> &vertices, size_t targetIndexCount,
+                                   float maxError, float *resultError)
+{
+    const size_t vertexCount = vertices.size();
+
+    // vertices sharing a position differ by their attributes, they form one position group
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> groupIndices;
+    std::vector<uint32_t> group(vertexCount);
+    std::vector<uint32_t> groupSizes;
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        const auto inserted =
+            groupIndices.emplace(vertices[vertex].position, uint32_t(groupSizes.size()));
+        if (inserted.second)
+        {
+            groupSizes.push_back(0);
+        }
+        group[vertex] = inserted.first->second;
+        ++groupSizes[group[vertex]];
+    }
+
+    // seams, open borders and non manifold edges are locked, found on position edges
+    std::vector<bool> lockedGroups(groupSizes.size(), false);
+    for (size_t g = 0; g < groupSizes.size(); ++g)
+    {
+        lockedGroups[g] = groupSizes[g] > 1;
+    }
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            ++edgeUses[edgeKey(group[indices[i + corner]], group[indices[i + (corner + 1) % 3]])];
+        }
+    }
+    for (const auto &edge : edgeUses)
+    {
+        if (edge.second != 2)
+        {
+            lockedGroups[uint32_t(edge.first >> 32)] = true;
+            lockedGroups[uint32_t(edge.first)] = true;
+        }
+    }
+
+    // area weighted planes of the triangles around each position
+    std::vector<Quadric> quadrics(groupSizes.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const glm::dvec3 a = vertices[indices[i]].position;
+        const glm::dvec3 b = vertices[indices[i + 1]].position;
+        const glm::dvec3 c = vertices[indices[i + 2]].position;
+        const glm::dvec3 normal = glm::cross(b - a, c - a);
+        const double length = glm::length(normal);
+        if (length <= 0.)
+        {
+            continue;
+        }
+        const glm::dvec3 unitNormal = normal / length;
+        for (const auto index : {indices[i], indices[i + 1], indices[i + 2]})
+        {
+            quadrics[group[index]].addPlane(unitNormal, -glm::dot(unitNormal, a), length * .5);
+        }
+    }
+
+    std::vector<uint32_t> result(indices);
+    const double maxCost = double(maxError) * double(maxError);
+    double worstCost = 0.;
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint64_t> edges;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    while (result.size() > targetIndexCount)
+    {
+        // vertex to triangle adjacency of the current triangles
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (const auto index : result)
+        {
+            ++adjacencyOffsets[index + 1];
+        }
+        for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+        }
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                adjacency[fill[result[i]]++] = uint32_t(i / 3);
+            }
+        }
+
+        // cheapest direction of every edge
+        edges.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                edges.push_back(edgeKey(result[i + corner], result[i + (corner + 1) % 3]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        collapses.clear();
+        for (const auto edge : edges)
+        {
+            const uint32_t a = uint32_t(edge >> 32), b = uint32_t(edge);
+            Quadric quadric = quadrics[group[a]];
+            quadric.add(quadrics[group[b]]);
+            Collapse best{a, b, -1.};
+            if (!lockedGroups[group[a]])
+            {
+                best = Collapse{a, b, quadric.error(vertices[b].position)};
+            }
+            if (!lockedGroups[group[b]])
+            {
+                const double cost = quadric.error(vertices[a].position);
+                if (best.cost < 0. || cost < best.cost)
+                {
+                    best = Collapse{b, a, cost};
+                }
+            }
+            if (best.cost >= 0. && best.cost <= maxCost)
+            {
+                collapses.push_back(best);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        // independent collapses: the triangles around a collapsed vertex are left alone for
+        // the rest of the pass, so the flip test below stays valid
+        for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            remap[vertex] = uint32_t(vertex);
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        size_t triangleCount = result.size() / 3;
+        size_t collapseCount = 0;
+        for (const auto &collapse : collapses)
+        {
+            if (triangleCount * 3 <= targetIndexCount)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+            const glm::vec3 &target = vertices[collapse.to].position;
+            bool flips = false;
+            size_t removed = 0;
+            for (uint32_t k = adjacencyOffsets[collapse.from];
+                 k < adjacencyOffsets[collapse.from + 1] && !flips; ++k)
+            {
+                const uint32_t *triangle = &result[size_t(adjacency[k]) * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+                    triangle[2] == collapse.to)
+                {
+                    ++removed;
+                    continue;
+                }
+                glm::vec3 corners[3], moved[3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    corners[corner] = vertices[triangle[corner]].position;
+                    moved[corner] = triangle[corner] == collapse.from ? target : corners[corner];
+                }
+                const auto before = triangleNormal(corners[0], corners[1], corners[2]);
+                const auto after = triangleNormal(moved[0], moved[1], moved[2]);
+                // flipped or collapsed to a sliver
+                flips = glm::dot(before, after) <= 1e-2f * glm::length(before) * glm::length(after);
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            for (uint32_t k = adjacencyOffsets[collapse.from];
+                 k < adjacencyOffsets[collapse.from + 1]; ++k)
+            {
+                const uint32_t *triangle = &result[size_t(adjacency[k]) * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            quadrics[group[collapse.to]].add(quadrics[group[collapse.from]]);
+            worstCost = std::max(worstCost, collapse.cost);
+            triangleCount -= removed;
+            ++collapseCount;
+        }
+        if (collapseCount == 0)
+        {
+            break;
+        }
+
+        // apply and drop the triangles that lost an edge
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a != b && b != c && c != a)
+            {
+                result[kept++] = a;
+                result[kept++] = b;
+                result[kept++] = c;
+            }
+        }
+        result.resize(kept);
+    }
+
+    if (resultError)
+    {
+        *resultError = float(std::sqrt(worstCost));
+    }
+    return result;
+}
+
+std::vector<MeshLOD> generateLODChain(const MeshData &mesh, size_t maxLevels, float reduction,
+                                      float maxError)
+{
+    std::vector<MeshLOD> lods;
+    size_t previousCount = mesh.indices.size();
+    float previousError = 0.f;
+    for (size_t level = 0; level < maxLevels; ++level)
+    {
+        const size_t target = size_t(float(previousCount / 3) * reduction) * 3;
+        MeshLOD lod;
+        lod.indices = simplifyMesh(mesh.indices, mesh.vertices, target, maxError, &lod.error);
+        if (lod.indices.empty() || lod.indices.size() * 10 > previousCount * 9)
+        {
+            break;
+        }
+        // errors of successive levels only grow, the selector relies on it
+        lod.error = std::max(lod.error, previousError);
+        lod.indices = optimizeVertexCache(lod.indices, mesh.vertices.size());
+        previousCount = lod.indices.size();
+        previousError = lod.error;
+        lods.push_back(std::move(lod));
+    }
+    return lods;
+}
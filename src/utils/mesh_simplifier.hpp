@@ -0,0 +1,32 @@
+#pragma once
+
+#include "mesh_builder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One coarser level of detail: indices into the vertices of the full detail mesh, so every
+// level shares its vertex buffer.
+struct MeshLOD
+{
+    std::vector<uint32_t> indices;
+    float error = 0.f; // object space distance to the full detail surface
+};
+
+// Quadric error metric simplification (Garland & Heckbert) by edge collapses onto existing
+// vertices, so the result indexes the input vertices. Collapses are done in passes, cheapest
+// first, until the index count reaches targetIndexCount or the next collapse would move the
+// surface by more than maxError (object space). Vertices on open borders, non manifold edges
+// and attribute seams (several vertices at one position) are locked, collapses flipping a
+// triangle are rejected. resultError receives the error of the most expensive collapse done.
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t> &indices,
+                                   const std::vector<Vertex> &vertices, size_t targetIndexCount,
+                                   float maxError, float *resultError = nullptr);
+
+// Chain of coarser levels, each with about reduction times the triangles of the previous one.
+// Every level is simplified from the full mesh, so errors are measured against it, and is
+// vertex cache optimized. Stops early when a level can't get below 90% of the previous one
+// or its error exceeds maxError.
+std::vector<MeshLOD> generateLODChain(const MeshData &mesh, size_t maxLevels = 4,
+                                      float reduction = .5f, float maxError = 1e30f);
@@ -0,0 +1,381 @@
+#include "occlusion_culler.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Edge functions and the inverse depth plane of a triangle, in pixels, plus its pixel bounds.
+// A pixel is covered when its center is on the inner side of the three edges.
+struct OcclusionCuller::ScreenTriangle
+{
+    float edgeA[3], edgeB[3], edgeC[3];
+    float depthA, depthB, depthC;
+    int minX, maxX, minY, maxY;
+};
+
+namespace
+{
+
+const float CLIP_EPSILON = 1e-6f;
+
+template <typename Body>
+void forRange(ThreadPool *pool, size_t count, size_t grainSize, const Body &body)
+{
+    if (pool)
+    {
+        pool->parallelFor(0, count, grainSize, body);
+    }
+    else if (count > 0)
+    {
+        body(0, count);
+    }
+}
+
+// Clips a clip space triangle against the near plane (z >= -w), returns the vertex count
+// of the resulting convex polygon: 0, 3 or 4.
+int clipNear(const glm::vec4 (&input)[3], glm::vec4 (&output)[4])
+{
+    int count = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const auto &current = input[i];
+        const auto &next = input[(i + 1) % 3];
+        const float currentDistance = current.z + current.w;
+        const float nextDistance = next.z + next.w;
+        if (currentDistance >= 0.f)
+        {
+            output[count++] = current;
+        }
+        if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+        {
+            const float t = currentDistance / (currentDistance - nextDistance);
+            output[count++] = glm::mix(current, next, t);
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+OccluderMesh makeBoxOccluder(const AABB &box)
+{
+    OccluderMesh mesh;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        mesh.positions.emplace_back(corner & 1 ? box.max.x : box.min.x,
+                                    corner & 2 ? box.max.y : box.min.y,
+                                    corner & 4 ? box.max.z : box.min.z);
+    }
+    // two counter-clockwise triangles per face, seen from outside
+    mesh.indices = {0, 2, 3, 0, 3, 1, // -z
+                    4, 5, 7, 4, 7, 6, // +z
+                    0, 4, 6, 0, 6, 2, // -x
+                    1, 3, 7, 1, 7, 5, // +x
+                    0, 1, 5, 0, 5, 4, // -y
+                    2, 6, 7, 2, 7, 3}; // +y
+    return mesh;
+}
+
+OcclusionCuller::OcclusionCuller()
+    : m_Depth(size_t(WIDTH) * HEIGHT, 0.f), m_TileDepth(size_t(TILES_X) * TILES_Y, 0.f)
+{
+}
+
+OcclusionCuller::~OcclusionCuller() = default;
+
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProj)
+{
+    m_ViewProj = viewProj;
+    m_Occluders.clear();
+    m_Stats = OcclusionStats();
+}
+
+void OcclusionCuller::addOccluder(const OccluderMesh &mesh, const glm::mat4 &model)
+{
+    m_Occluders.push_back(Occluder{&mesh, model});
+}
+
+void OcclusionCuller::rasterize(ThreadPool *pool)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    m_Triangles.resize(m_Occluders.size());
+    forRange(pool, m_Occluders.size(), 16, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            setupTriangles(m_Occluders[i], m_Triangles[i]);
+        }
+    });
+    m_Stats.occluders = m_Occluders.size();
+    for (size_t i = 0; i < m_Occluders.size(); ++i)
+    {
+        m_Stats.triangles += m_Triangles[i].size();
+    }
+
+    // bands are whole tile rows, so each job owns its pixels and its tiles
+    forRange(pool, TILES_Y, 1, [this](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; ++band)
+        {
+            rasterizeBand(int(band));
+        }
+    });
+
+    m_Stats.rasterizeMicroseconds = std::chrono::duration<float, std::micro>(
+                                        std::chrono::high_resolution_clock::now() - start)
+                                        .count();
+}
+
+void OcclusionCuller::setupTriangles(const Occluder &occluder,
+                                     std::vector<ScreenTriangle> &triangles) const
+{
+    triangles.clear();
+    const auto &mesh = *occluder.mesh;
+    const glm::mat4 transform = m_ViewProj * occluder.model;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const glm::vec4 clip[3] = {transform * glm::vec4(mesh.positions[mesh.indices[i]], 1.f),
+                                   transform * glm::vec4(mesh.positions[mesh.indices[i + 1]], 1.f),
+                                   transform * glm::vec4(mesh.positions[mesh.indices[i + 2]], 1.f)};
+        glm::vec4 polygon[4];
+        const int vertexCount = clipNear(clip, polygon);
+
+        // pixel coordinates and inverse depth
+        glm::vec3 screen[4];
+        for (int v = 0; v < vertexCount; ++v)
+        {
+            const float inverseW = 1.f / std::max(polygon[v].w, CLIP_EPSILON);
+            screen[v] = glm::vec3((polygon[v].x * inverseW * .5f + .5f) * WIDTH,
+                                  (polygon[v].y * inverseW * .5f + .5f) * HEIGHT, inverseW);
+        }
+
+        for (int v = 2; v < vertexCount; ++v)
+        {
+            const glm::vec3 &p0 = screen[0], &p1 = screen[v - 1], &p2 = screen[v];
+            const float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+            if (!(area > 0.f))
+            {
+                continue;
+            }
+
+            ScreenTriangle triangle;
+            triangle.minX = std::max(0, int(std::ceil(std::min({p0.x, p1.x, p2.x}) - .5f)));
+            triangle.maxX = std::min(WIDTH - 1, int(std::floor(std::max({p0.x, p1.x, p2.x}) - .5f)));
+            triangle.minY = std::max(0, int(std::ceil(std::min({p0.y, p1.y, p2.y}) - .5f)));
+            triangle.maxY = std::min(HEIGHT - 1, int(std::floor(std::max({p0.y, p1.y, p2.y}) - .5f)));
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            {
+                continue;
+            }
+
+            const glm::vec3 *corners[3] = {&p0, &p1, &p2};
+            for (int edge = 0; edge < 3; ++edge)
+            {
+                const auto &from = *corners[edge];
+                const auto &to = *corners[(edge + 1) % 3];
+                triangle.edgeA[edge] = from.y - to.y;
+                triangle.edgeB[edge] = to.x - from.x;
+                triangle.edgeC[edge] = -(triangle.edgeA[edge] * from.x + triangle.edgeB[edge] * from.y);
+            }
+            // barycentric weight of a corner is the edge function of the opposite edge
+            const float inverseArea = 1.f / area;
+            triangle.depthA = (triangle.edgeA[1] * p0.z + triangle.edgeA[2] * p1.z +
+                               triangle.edgeA[0] * p2.z) * inverseArea;
+            triangle.depthB = (triangle.edgeB[1] * p0.z + triangle.edgeB[2] * p1.z +
+                               triangle.edgeB[0] * p2.z) * inverseArea;
+            triangle.depthC = (triangle.edgeC[1] * p0.z + triangle.edgeC[2] * p1.z +
+                               triangle.edgeC[0] * p2.z) * inverseArea;
+            triangles.push_back(triangle);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeBand(int band)
+{
+    const int firstRow = band * TILE_SIZE;
+    const int lastRow = firstRow + TILE_SIZE - 1;
+    std::fill(m_Depth.begin() + size_t(firstRow) * WIDTH,
+              m_Depth.begin() + size_t(lastRow + 1) * WIDTH, 0.f);
+
+    for (const auto &triangles : m_Triangles)
+    {
+        for (const auto &triangle : triangles)
+        {
+            if (triangle.maxY < firstRow || triangle.minY > lastRow)
+            {
+                continue;
+            }
+            const int rowBegin = std::max(triangle.minY, firstRow);
+            const int rowEnd = std::min(triangle.maxY, lastRow);
+            // rows are a multiple of 4 pixels wide, spans start on a multiple of 4
+            const int columnBegin = triangle.minX & ~3;
+            for (int y = rowBegin; y <= rowEnd; ++y)
+            {
+                float *row = m_Depth.data() + size_t(y) * WIDTH;
+                const float py = float(y) + .5f;
+                float rowEdge[3];
+                for (int edge = 0; edge < 3; ++edge)
+                {
+                    rowEdge[edge] = triangle.edgeB[edge] * py + triangle.edgeC[edge];
+                }
+                const float rowDepth = triangle.depthB * py + triangle.depthC;
+#ifdef OCCLUSION_SSE2
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 offsets = _mm_setr_ps(.5f, 1.5f, 2.5f, 3.5f);
+                const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+                const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+                const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+                const __m128 depthA = _mm_set1_ps(triangle.depthA);
+                const __m128 edge0 = _mm_set1_ps(rowEdge[0]);
+                const __m128 edge1 = _mm_set1_ps(rowEdge[1]);
+                const __m128 edge2 = _mm_set1_ps(rowEdge[2]);
+                const __m128 depth = _mm_set1_ps(rowDepth);
+                for (int x = columnBegin; x <= triangle.maxX; x += 4)
+                {
+                    const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+                    const __m128 inside = _mm_and_ps(
+                        _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, px), edge0), zero),
+                                   _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, px), edge1), zero)),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, px), edge2), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                    {
+                        continue;
+                    }
+                    const __m128 previous = _mm_loadu_ps(row + x);
+                    const __m128 closest =
+                        _mm_max_ps(previous, _mm_add_ps(_mm_mul_ps(depthA, px), depth));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest),
+                                                     _mm_andnot_ps(inside, previous)));
+                }
+#else
+                for (int x = columnBegin; x <= triangle.maxX; ++x)
+                {
+                    const float px = float(x) + .5f;
+                    if (triangle.edgeA[0] * px + rowEdge[0] >= 0.f &&
+                        triangle.edgeA[1] * px + rowEdge[1] >= 0.f &&
+                        triangle.edgeA[2] * px + rowEdge[2] >= 0.f)
+                    {
+                        row[x] = std::max(row[x], triangle.depthA * px + rowDepth);
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    for (int tileX = 0; tileX < TILES_X; ++tileX)
+    {
+        float farthest = FLT_MAX;
+        for (int y = firstRow; y <= lastRow; ++y)
+        {
+            const float *row = m_Depth.data() + size_t(y) * WIDTH + tileX * TILE_SIZE;
+            farthest = std::min(farthest, *std::min_element(row, row + TILE_SIZE));
+        }
+        m_TileDepth[size_t(band) * TILES_X + tileX] = farthest;
+    }
+}
+
+bool OcclusionCuller::isVisible(const AABB &box) const
+{
+    // corners from the min corner plus the transformed box edges: one matrix product
+    const glm::vec4 minCorner = m_ViewProj * glm::vec4(box.min, 1.f);
+    const glm::vec3 size = box.max - box.min;
+    const glm::vec4 edges[3] = {m_ViewProj[0] * size.x, m_ViewProj[1] * size.y,
+                                m_ViewProj[2] * size.z};
+    glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+    float closest = 0.f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 clip = minCorner;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (corner & (1 << axis))
+            {
+                clip += edges[axis];
+            }
+        }
+        if (clip.w <= CLIP_EPSILON)
+        {
+            return true;
+        }
+        const float inverseW = 1.f / clip.w;
+        const glm::vec2 screen((clip.x * inverseW * .5f + .5f) * WIDTH,
+                               (clip.y * inverseW * .5f + .5f) * HEIGHT);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        closest = std::max(closest, inverseW);
+    }
+
+    // every pixel the box touches, not only the ones whose center it covers
+    const int minX = std::max(0, int(std::floor(screenMin.x)));
+    const int maxX = std::min(WIDTH - 1, int(std::ceil(screenMax.x)) - 1);
+    const int minY = std::max(0, int(std::floor(screenMin.y)));
+    const int maxY = std::min(HEIGHT - 1, int(std::ceil(screenMax.y)) - 1);
+    if (minX > maxX || minY > maxY)
+    {
+        return false;
+    }
+
+    for (int tileY = minY / TILE_SIZE; tileY <= maxY / TILE_SIZE; ++tileY)
+    {
+        for (int tileX = minX / TILE_SIZE; tileX <= maxX / TILE_SIZE; ++tileX)
+        {
+            // the whole tile is closer than the box
+            if (m_TileDepth[size_t(tileY) * TILES_X + tileX] > closest)
+            {
+                continue;
+            }
+            const int rowBegin = std::max(minY, tileY * TILE_SIZE);
+            const int rowEnd = std::min(maxY, tileY * TILE_SIZE + TILE_SIZE - 1);
+            const int columnBegin = std::max(minX, tileX * TILE_SIZE);
+            const int columnEnd = std::min(maxX, tileX * TILE_SIZE + TILE_SIZE - 1);
+            for (int y = rowBegin; y <= rowEnd; ++y)
+            {
+                const float *row = m_Depth.data() + size_t(y) * WIDTH;
+                for (int x = columnBegin; x <= columnEnd; ++x)
+                {
+                    if (row[x] <= closest)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionCuller::cull(const std::vector<AABB> &boxes, std::vector<uint32_t> &visible,
+                           ThreadPool *pool)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    m_Visibility.resize(visible.size());
+    forRange(pool, visible.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            m_Visibility[i] = isVisible(boxes[visible[i]]) ? 1 : 0;
+        }
+    });
+    size_t kept = 0;
+    for (size_t i = 0; i < visible.size(); ++i)
+    {
+        if (m_Visibility[i])
+        {
+            visible[kept++] = visible[i];
+        }
+    }
+    m_Stats.tested += visible.size();
+    m_Stats.occluded += visible.size() - kept;
+    visible.resize(kept);
+
+    m_Stats.testMicroseconds += std::chrono::duration<float, std::micro>(
+                                    std::chrono::high_resolution_clock::now() - start)
+                                    .count();
+}
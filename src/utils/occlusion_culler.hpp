@@ -0,0 +1,89 @@
+#pragma once
+
+#include "bounds.hpp"
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Triangles rasterized into the occlusion buffer, counter-clockwise front faces as in GL.
+// Back faces are skipped, so occluders should be closed and consistently wound.
+struct OccluderMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// The 12 triangles of a box.
+OccluderMesh makeBoxOccluder(const AABB &box);
+
+struct OcclusionStats
+{
+    size_t occluders = 0;
+    size_t triangles = 0; // after near plane clipping and back face culling
+    size_t tested = 0;
+    size_t occluded = 0;
+    float rasterizeMicroseconds = 0.f;
+    float testMicroseconds = 0.f;
+};
+
+// Software occlusion culling: occluders are rasterized into a small depth buffer on the CPU,
+// then occludee boxes are tested against it before anything is submitted to GL.
+// The buffer stores 1 / w, which interpolates linearly in screen space and keeps its precision
+// far from the camera whatever the near plane: larger values are closer, 0 is empty.
+// Rows are rasterized 4 pixels at a time with SSE2 when available, one band of tiles per job.
+class OcclusionCuller
+{
+public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 128;
+    // each tile keeps the farthest depth of its pixels, whole tiles are tested first
+    static const int TILE_SIZE = 8;
+    static const int TILES_X = WIDTH / TILE_SIZE;
+    static const int TILES_Y = HEIGHT / TILE_SIZE;
+
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // Clears the buffer and the occluder list.
+    void beginFrame(const glm::mat4 &viewProj);
+    // The mesh is referenced until rasterize() returns.
+    void addOccluder(const OccluderMesh &mesh, const glm::mat4 &model);
+    // Transforms the occluders and rasterizes them, in parallel on the pool when one is given.
+    void rasterize(ThreadPool *pool = nullptr);
+
+    // False when every pixel the box covers on screen holds a closer occluder.
+    // Boxes crossing the near plane are always visible.
+    bool isVisible(const AABB &box) const;
+    // Keeps the entries of visible whose box passes isVisible, in order.
+    void cull(const std::vector<AABB> &boxes, std::vector<uint32_t> &visible,
+              ThreadPool *pool = nullptr);
+
+    // WIDTH * HEIGHT inverse depths, bottom row first like a GL texture.
+    const float *depth() const { return m_Depth.data(); }
+    // TILES_X * TILES_Y farthest inverse depths, same order.
+    const float *tileDepth() const { return m_TileDepth.data(); }
+    const OcclusionStats &stats() const { return m_Stats; }
+
+private:
+    struct ScreenTriangle;
+    struct Occluder
+    {
+        const OccluderMesh *mesh;
+        glm::mat4 model;
+    };
+
+    void setupTriangles(const Occluder &occluder, std::vector<ScreenTriangle> &triangles) const;
+    void rasterizeBand(int band);
+
+    glm::mat4 m_ViewProj{1.f};
+    std::vector<Occluder> m_Occluders;
+    std::vector<std::vector<ScreenTriangle>> m_Triangles; // per occluder
+    std::vector<float> m_Depth;
+    std::vector<float> m_TileDepth; // farthest, so the smallest, inverse depth of each tile
+    std::vector<uint8_t> m_Visibility;
+    OcclusionStats m_Stats;
+};
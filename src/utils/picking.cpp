@@ -0,0 +1,290 @@
+#include "picking.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PICKING_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+inline uint32_t countTrailingZeros(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctz(mask));
+#endif
+}
+
+// interleaves the low 10 bits of x, y and z
+uint32_t mortonCode(const glm::uvec3 &cell)
+{
+    auto spread = [](uint32_t x) {
+        x = (x | (x << 16)) & 0x030000ffu;
+        x = (x | (x << 8)) & 0x0300f00fu;
+        x = (x | (x << 4)) & 0x030c30c3u;
+        x = (x | (x << 2)) & 0x09249249u;
+        return x;
+    };
+    return spread(cell.x) | (spread(cell.y) << 1) | (spread(cell.z) << 2);
+}
+
+// Möller-Trumbore on the triangle of one slot, t of the hit or a negative value
+float intersectTriangle(const TriangleSoA &triangles, size_t slot, const Ray &ray, float maxT,
+                        float &u, float &v)
+{
+    const glm::vec3 v0(triangles.v0x()[slot], triangles.v0y()[slot], triangles.v0z()[slot]);
+    const glm::vec3 e1(triangles.e1x()[slot], triangles.e1y()[slot], triangles.e1z()[slot]);
+    const glm::vec3 e2(triangles.e2x()[slot], triangles.e2y()[slot], triangles.e2z()[slot]);
+    const glm::vec3 p = glm::cross(ray.direction, e2);
+    const float det = glm::dot(e1, p);
+    if (det == 0.f)
+    {
+        return -1.f;
+    }
+    const float inverseDet = 1.f / det;
+    const glm::vec3 s = ray.origin - v0;
+    u = glm::dot(s, p) * inverseDet;
+    const glm::vec3 q = glm::cross(s, e1);
+    v = glm::dot(ray.direction, q) * inverseDet;
+    const float t = glm::dot(e2, q) * inverseDet;
+    if (u < 0.f || v < 0.f || u + v > 1.f || t < 0.f || t >= maxT)
+    {
+        return -1.f;
+    }
+    return t;
+}
+
+#if defined(__AVX__) || defined(PICKING_SSE2)
+#if defined(__AVX__)
+const size_t LANES = 8;
+using Lanes = __m256;
+inline Lanes load(const float *values) { return _mm256_loadu_ps(values); }
+inline Lanes splat(float value) { return _mm256_set1_ps(value); }
+inline Lanes add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+inline Lanes both(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+inline Lanes greaterEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline Lanes less(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline Lanes notEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+inline uint32_t mask(Lanes a) { return uint32_t(_mm256_movemask_ps(a)); }
+inline void store(float *values, Lanes a) { _mm256_storeu_ps(values, a); }
+#else
+const size_t LANES = 4;
+using Lanes = __m128;
+inline Lanes load(const float *values) { return _mm_loadu_ps(values); }
+inline Lanes splat(float value) { return _mm_set1_ps(value); }
+inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes both(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+inline Lanes greaterEqual(Lanes a, Lanes b) { return _mm_cmpge_ps(a, b); }
+inline Lanes less(Lanes a, Lanes b) { return _mm_cmplt_ps(a, b); }
+inline Lanes notEqual(Lanes a, Lanes b) { return _mm_cmpneq_ps(a, b); }
+inline uint32_t mask(Lanes a) { return uint32_t(_mm_movemask_ps(a)); }
+inline void store(float *values, Lanes a) { _mm_storeu_ps(values, a); }
+#endif
+
+// tests LANES triangles from slot, keeps the nearest hit in hit
+void intersectLanes(const TriangleSoA &triangles, size_t slot, const Lanes origin[3],
+                    const Lanes direction[3], TriangleHit &hit)
+{
+    const Lanes e1x = load(triangles.e1x() + slot), e1y = load(triangles.e1y() + slot),
+                e1z = load(triangles.e1z() + slot);
+    const Lanes e2x = load(triangles.e2x() + slot), e2y = load(triangles.e2y() + slot),
+                e2z = load(triangles.e2z() + slot);
+
+    // p = direction x e2, det = e1 . p
+    const Lanes px = sub(mul(direction[1], e2z), mul(direction[2], e2y));
+    const Lanes py = sub(mul(direction[2], e2x), mul(direction[0], e2z));
+    const Lanes pz = sub(mul(direction[0], e2y), mul(direction[1], e2x));
+    const Lanes det = add(add(mul(e1x, px), mul(e1y, py)), mul(e1z, pz));
+    const Lanes zero = splat(0.f);
+    // padding triangles have a null determinant, their lanes are masked out
+    const Lanes inverseDet = div(splat(1.f), det);
+
+    const Lanes sx = sub(origin[0], load(triangles.v0x() + slot));
+    const Lanes sy = sub(origin[1], load(triangles.v0y() + slot));
+    const Lanes sz = sub(origin[2], load(triangles.v0z() + slot));
+    const Lanes u = mul(add(add(mul(sx, px), mul(sy, py)), mul(sz, pz)), inverseDet);
+
+    // q = s x e1
+    const Lanes qx = sub(mul(sy, e1z), mul(sz, e1y));
+    const Lanes qy = sub(mul(sz, e1x), mul(sx, e1z));
+    const Lanes qz = sub(mul(sx, e1y), mul(sy, e1x));
+    const Lanes v =
+        mul(add(add(mul(direction[0], qx), mul(direction[1], qy)), mul(direction[2], qz)),
+            inverseDet);
+    const Lanes t = mul(add(add(mul(e2x, qx), mul(e2y, qy)), mul(e2z, qz)), inverseDet);
+
+    const Lanes inside =
+        both(both(notEqual(det, zero), greaterEqual(u, zero)),
+             both(greaterEqual(v, zero), greaterEqual(splat(1.f), add(u, v))));
+    uint32_t hits = mask(both(inside, both(greaterEqual(t, zero), less(t, splat(hit.t)))));
+    if (!hits)
+    {
+        return;
+    }
+    float ts[LANES], us[LANES], vs[LANES];
+    store(ts, t);
+    store(us, u);
+    store(vs, v);
+    while (hits)
+    {
+        const uint32_t lane = countTrailingZeros(hits);
+        hits &= hits - 1;
+        if (ts[lane] < hit.t)
+        {
+            hit.t = ts[lane];
+            hit.u = us[lane];
+            hit.v = vs[lane];
+            hit.triangle = triangles.triangleId(slot + lane);
+        }
+    }
+}
+#endif
+} // namespace
+
+void TriangleSoA::build(const MeshData &mesh)
+{
+    std::vector<glm::vec3> positions(mesh.vertices.size());
+    for (size_t vertex = 0; vertex < positions.size(); ++vertex)
+    {
+        positions[vertex] = mesh.vertices[vertex].position;
+    }
+    build(positions, mesh.indices);
+}
+
+void TriangleSoA::build(const std::vector<glm::vec3> &positions,
+                        const std::vector<uint32_t> &indices)
+{
+    const size_t triangleCount = indices.size() / 3;
+    AABB bounds;
+    for (const auto &position : positions)
+    {
+        bounds.extend(position);
+    }
+    // sort by the Morton code of the centroids, batches of neighbours have small boxes
+    const glm::vec3 scale = 1023.f / glm::max(bounds.max - bounds.min, glm::vec3(1e-20f));
+    std::vector<std::pair<uint32_t, uint32_t>> order(triangleCount);
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        const glm::vec3 centroid = (positions[indices[3 * triangle]] +
+                                    positions[indices[3 * triangle + 1]] +
+                                    positions[indices[3 * triangle + 2]]) /
+                                   3.f;
+        order[triangle] = {mortonCode(glm::uvec3((centroid - bounds.min) * scale)),
+                           uint32_t(triangle)};
+    }
+    std::sort(begin(order), end(order));
+
+    const size_t batchCount = (triangleCount + BATCH_SIZE - 1) / BATCH_SIZE;
+    const size_t slotCount = batchCount * BATCH_SIZE;
+    for (auto *values : {&m_V0X, &m_V0Y, &m_V0Z, &m_E1X, &m_E1Y, &m_E1Z, &m_E2X, &m_E2Y, &m_E2Z})
+    {
+        values->assign(slotCount, 0.f);
+    }
+    m_BatchBounds.assign(batchCount, AABB());
+    m_TriangleIds.resize(triangleCount);
+    for (size_t slot = 0; slot < triangleCount; ++slot)
+    {
+        const uint32_t triangle = order[slot].second;
+        const glm::vec3 &p0 = positions[indices[3 * triangle]];
+        const glm::vec3 &p1 = positions[indices[3 * triangle + 1]];
+        const glm::vec3 &p2 = positions[indices[3 * triangle + 2]];
+        const glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+        m_V0X[slot] = p0.x, m_V0Y[slot] = p0.y, m_V0Z[slot] = p0.z;
+        m_E1X[slot] = e1.x, m_E1Y[slot] = e1.y, m_E1Z[slot] = e1.z;
+        m_E2X[slot] = e2.x, m_E2Y[slot] = e2.y, m_E2Z[slot] = e2.z;
+        AABB &batchBounds = m_BatchBounds[slot / BATCH_SIZE];
+        batchBounds.extend(p0);
+        batchBounds.extend(p1);
+        batchBounds.extend(p2);
+        m_TriangleIds[slot] = triangle;
+    }
+}
+
+bool intersectTriangles(const TriangleSoA &triangles, const Ray &ray, TriangleHit &hit)
+{
+#if defined(__AVX__) || defined(PICKING_SSE2)
+    const glm::vec3 inverseDirection = 1.f / ray.direction;
+    const Lanes origin[3] = {splat(ray.origin.x), splat(ray.origin.y), splat(ray.origin.z)};
+    const Lanes direction[3] = {splat(ray.direction.x), splat(ray.direction.y),
+                                splat(ray.direction.z)};
+    const float previousT = hit.t;
+    for (size_t batch = 0; batch < triangles.batchCount(); ++batch)
+    {
+        const AABB &box = triangles.batchBounds(batch);
+        if (intersectRayAABB(ray.origin, inverseDirection, box.min, box.max, hit.t) < 0.f)
+        {
+            continue;
+        }
+        for (size_t lane = 0; lane < TriangleSoA::BATCH_SIZE; lane += LANES)
+        {
+            intersectLanes(triangles, batch * TriangleSoA::BATCH_SIZE + lane, origin, direction,
+                           hit);
+        }
+    }
+    return hit.t < previousT;
+#else
+    return intersectTrianglesScalar(triangles, ray, hit);
+#endif
+}
+
+bool intersectTrianglesScalar(const TriangleSoA &triangles, const Ray &ray, TriangleHit &hit)
+{
+    bool found = false;
+    for (size_t slot = 0; slot < triangles.size(); ++slot)
+    {
+        float u, v;
+        const float t = intersectTriangle(triangles, slot, ray, hit.t, u, v);
+        if (t >= 0.f)
+        {
+            hit.triangle = triangles.triangleId(slot);
+            hit.t = t;
+            hit.u = u;
+            hit.v = v;
+            found = true;
+        }
+    }
+    return found;
+}
+
+const char *rayTriangleInstructionSet()
+{
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(PICKING_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+Ray cursorRay(const glm::vec2 &cursor, const glm::vec2 &windowSize, const glm::mat4 &view,
+              const glm::mat4 &projection)
+{
+    const glm::vec2 ndc(2.f * cursor.x / windowSize.x - 1.f, 1.f - 2.f * cursor.y / windowSize.y);
+    const glm::mat4 inverseViewProj = glm::inverse(projection * view);
+    const glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, -1.f, 1.f);
+    const glm::vec4 farPoint = inverseViewProj * glm::vec4(ndc, 1.f, 1.f);
+    Ray ray;
+    // from the eye rather than the near plane, which is close to it anyway
+    ray.origin = glm::vec3(glm::inverse(view)[3]);
+    ray.direction = glm::normalize(glm::vec3(farPoint) / farPoint.w -
+                                   glm::vec3(nearPoint) / nearPoint.w);
+    return ray;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "bvh.hpp"
+#include "mesh_builder.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangles of one mesh for ray casts: first vertex and two edges in structure of arrays,
+// in batches of BATCH_SIZE with their bounds. Triangles are sorted along a Morton curve so
+// the batches are compact and most of them are rejected by their box.
+class TriangleSoA
+{
+public:
+    static const size_t BATCH_SIZE = 8;
+
+    void build(const MeshData &mesh);
+    void build(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices);
+
+    size_t size() const { return m_TriangleIds.size(); }
+    size_t batchCount() const { return m_BatchBounds.size(); }
+    const AABB &batchBounds(size_t batch) const { return m_BatchBounds[batch]; }
+    // index in the source index buffer divided by 3, per sorted triangle
+    uint32_t triangleId(size_t triangle) const { return m_TriangleIds[triangle]; }
+
+    // padded to whole batches with degenerate triangles that are never hit
+    const float *v0x() const { return m_V0X.data(); }
+    const float *v0y() const { return m_V0Y.data(); }
+    const float *v0z() const { return m_V0Z.data(); }
+    const float *e1x() const { return m_E1X.data(); }
+    const float *e1y() const { return m_E1Y.data(); }
+    const float *e1z() const { return m_E1Z.data(); }
+    const float *e2x() const { return m_E2X.data(); }
+    const float *e2y() const { return m_E2Y.data(); }
+    const float *e2z() const { return m_E2Z.data(); }
+
+private:
+    std::vector<float> m_V0X, m_V0Y, m_V0Z;
+    std::vector<float> m_E1X, m_E1Y, m_E1Z;
+    std::vector<float> m_E2X, m_E2Y, m_E2Z;
+    std::vector<AABB> m_BatchBounds;
+    std::vector<uint32_t> m_TriangleIds;
+};
+
+struct TriangleHit
+{
+    uint32_t triangle = ~0u; // source triangle index
+    float t = FLT_MAX;
+    float u = 0.f, v = 0.f; // barycentrics of the second and third vertices
+};
+
+// Nearest triangle closer than hit.t, both faces count. Möller-Trumbore on 8 triangles at a
+// time with AVX, 4 with SSE2, one otherwise. The ray direction doesn't need to be normalized,
+// t is in units of it.
+bool intersectTriangles(const TriangleSoA &triangles, const Ray &ray, TriangleHit &hit);
+// Reference implementation, one triangle at a time.
+bool intersectTrianglesScalar(const TriangleSoA &triangles, const Ray &ray, TriangleHit &hit);
+// Instruction set used by intersectTriangles.
+const char *rayTriangleInstructionSet();
+
+// World ray from the camera through a cursor position in window coordinates (origin at the
+// top left, as GLFW reports it), unprojected through the inverse view projection.
+Ray cursorRay(const glm::vec2 &cursor, const glm::vec2 &windowSize, const glm::mat4 &view,
+              const glm::mat4 &projection);
+
+struct PickHit
+{
+    uint32_t object = ~0u;
+    uint32_t triangle = ~0u;
+    float t = FLT_MAX;
+    glm::vec3 position = glm::vec3(0.f);
+};
+
+// Exact pick of the objects of a BVH: objects are visited front to back by box, their
+// triangles are tested in object space, the ray being moved by the inverse of the model
+// matrix, which keeps t comparable between objects. meshOf(object) returns the TriangleSoA
+// of an object.
+template <typename MeshOf>
+bool pick(const Ray &ray, const BVH &bvh, const std::vector<glm::mat4> &models,
+          const MeshOf &meshOf, PickHit &hit)
+{
+    RayHit boxHit;
+    boxHit.t = hit.t;
+    uint32_t triangle = ~0u;
+    bvh.raycast(ray, boxHit, [&](uint32_t object, float) {
+        const glm::mat4 inverse = glm::affineInverse(models[object]);
+        Ray local;
+        local.origin = glm::vec3(inverse * glm::vec4(ray.origin, 1.f));
+        local.direction = glm::vec3(inverse * glm::vec4(ray.direction, 0.f));
+        TriangleHit triangleHit;
+        triangleHit.t = boxHit.t;
+        if (!intersectTriangles(meshOf(object), local, triangleHit))
+        {
+            return -1.f;
+        }
+        triangle = triangleHit.triangle;
+        return triangleHit.t;
+    });
+    if (boxHit.object == ~0u)
+    {
+        return false;
+    }
+    hit.object = boxHit.object;
+    hit.triangle = triangle;
+    hit.t = boxHit.t;
+    hit.position = ray.origin + boxHit.t * ray.direction;
+    return true;
+}
+
+// Every object shares one mesh.
+inline bool pick(const Ray &ray, const BVH &bvh, const std::vector<glm::mat4> &models,
+                 const TriangleSoA &mesh, PickHit &hit)
+{
+    return pick(
+        ray, bvh, models, [&](uint32_t) -> const TriangleSoA & { return mesh; }, hit);
+}
@@ -0,0 +1,152 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+// C++14 needs a definition of the layout applyVertexLayout() binds to a reference
+constexpr VertexLayout VertexLayoutOf<InstanceData>::value;
+
+uint64_t makeSortKey(GLuint program, uint32_t textureSet, GLuint vao, bool indexed, float depth)
+{
+    const uint64_t depthBits = uint64_t(glm::clamp(depth, 0.f, 1.f) * float((1 << 24) - 1));
+    return (uint64_t(program & 0xFFF) << 52) | (uint64_t(textureSet & 0xFFF) << 40) |
+           (uint64_t(vao & 0xFFF) << 28) | (uint64_t(indexed) << 24) | depthBits;
+}
+
+RenderQueue::RenderQueue(GLRingBuffer &ring, GLStateCache &state, GLuint instanceBinding)
+    : m_Ring(ring), m_State(state), m_nInstanceBinding(instanceBinding)
+{
+}
+
+uint32_t RenderQueue::addTextureSet(const std::vector<GLuint> &textures)
+{
+    m_TextureSets.push_back(textures);
+    return uint32_t(m_TextureSets.size() - 1);
+}
+
+void RenderQueue::setView(const glm::mat4 &view, float zNear, float zFar)
+{
+    m_View = view;
+    m_fNear = zNear;
+    m_fFar = zFar;
+}
+
+void RenderQueue::push(GLuint program, uint32_t textureSet, GLuint vao, const DrawRange &range,
+                       const glm::mat4 &model, uint32_t materialId)
+{
+    m_Packets.push_back(DrawPacket{program, textureSet, vao, range, uint32_t(m_Instances.size())});
+    InstanceData instance = {};
+    instance.model = model;
+    instance.materialId = materialId;
+    m_Instances.push_back(instance);
+}
+
+void RenderQueue::submit()
+{
+    m_Stats = RenderQueueStats();
+    m_Stats.packets = m_Packets.size();
+    if (m_Packets.empty())
+    {
+        return;
+    }
+
+    // front to back inside a state bucket, so early depth test rejects more fragments
+    m_SortKeys.clear();
+    const float depthScale = 1.f / (m_fFar - m_fNear);
+    for (size_t i = 0; i < m_Packets.size(); ++i)
+    {
+        const auto &packet = m_Packets[i];
+        const float viewDepth = -(m_View * m_Instances[packet.instanceIndex].model[3]).z;
+        const auto key = makeSortKey(packet.program, packet.textureSet, packet.vao,
+                                     packet.range.indexType != GL_NONE,
+                                     (viewDepth - m_fNear) * depthScale);
+        m_SortKeys.emplace_back(key, uint32_t(i));
+    }
+    std::sort(begin(m_SortKeys), end(m_SortKeys));
+
+    // commands and instances are written in submission order straight into the mapped ring,
+    // baseInstance selects the instance
+    const auto commandSlice = m_Ring.allocate<IndirectCommand>(m_Packets.size(), 4);
+    const auto instanceSlice = m_Ring.allocate<InstanceData>(m_Packets.size(), 16);
+    auto commands = static_cast<IndirectCommand *>(commandSlice.data);
+    auto instances = static_cast<InstanceData *>(instanceSlice.data);
+    for (size_t i = 0; i < m_SortKeys.size(); ++i)
+    {
+        const auto &packet = m_Packets[m_SortKeys[i].second];
+        instances[i] = m_Instances[packet.instanceIndex];
+        IndirectCommand command;
+        command.count = packet.range.count;
+        command.instanceCount = 1;
+        command.first = packet.range.first;
+        if (packet.range.indexType != GL_NONE)
+        {
+            command.baseVertexOrBaseInstance = GLuint(packet.range.baseVertex);
+            command.baseInstance = GLuint(i);
+        }
+        else
+        {
+            command.baseVertexOrBaseInstance = GLuint(i);
+            command.baseInstance = 0;
+        }
+        commands[i] = command;
+    }
+
+    m_State.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Ring.glId());
+    const DrawPacket *bound = nullptr;
+    size_t runStart = 0;
+    while (runStart < m_SortKeys.size())
+    {
+        const auto &packet = m_Packets[m_SortKeys[runStart].second];
+        size_t runEnd = runStart + 1;
+        while (runEnd < m_SortKeys.size())
+        {
+            const auto &next = m_Packets[m_SortKeys[runEnd].second];
+            if (next.program != packet.program || next.textureSet != packet.textureSet ||
+                next.vao != packet.vao || next.range.indexType != packet.range.indexType)
+            {
+                break;
+            }
+            ++runEnd;
+        }
+
+        if (!bound || bound->program != packet.program)
+        {
+            m_State.useProgram(packet.program);
+            ++m_Stats.programBinds;
+        }
+        if (!bound || bound->textureSet != packet.textureSet)
+        {
+            const auto &textures = m_TextureSets[packet.textureSet];
+            for (size_t unit = 0; unit < textures.size(); ++unit)
+            {
+                m_State.bindTexture(GLuint(unit), textures[unit]);
+            }
+            ++m_Stats.textureSetBinds;
+        }
+        if (!bound || bound->vao != packet.vao)
+        {
+            glVertexArrayVertexBuffer(packet.vao, m_nInstanceBinding, m_Ring.glId(),
+                                      instanceSlice.offset, sizeof(InstanceData));
+            m_State.bindVertexArray(packet.vao);
+            ++m_Stats.vaoBinds;
+        }
+        bound = &packet;
+
+        const auto offset =
+            (const void *)(commandSlice.offset + runStart * sizeof(IndirectCommand));
+        const auto drawCount = GLsizei(runEnd - runStart);
+        if (packet.range.indexType != GL_NONE)
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, packet.range.indexType, offset, drawCount,
+                                        sizeof(IndirectCommand));
+        }
+        else
+        {
+            glMultiDrawArraysIndirect(GL_TRIANGLES, offset, drawCount, sizeof(IndirectCommand));
+        }
+        ++m_Stats.multiDrawCalls;
+        runStart = runEnd;
+    }
+
+    m_Packets.clear();
+    m_Instances.clear();
+}
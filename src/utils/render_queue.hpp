@@ -0,0 +1,113 @@
+#pragma once
+
+#include "gl_state.hpp"
+#include "ring_buffer.hpp"
+#include "vertex_layout.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Index range of one draw. indexType is GL_NONE for non indexed geometry,
+// first is then the first vertex instead of the first index.
+struct DrawRange
+{
+    GLenum indexType;
+    GLuint count;
+    GLuint first;
+    GLint baseVertex;
+};
+
+// Per-instance vertex data: model matrix at locations 3 to 6, material ID at location 7.
+struct InstanceData
+{
+    glm::mat4 model;
+    uint32_t materialId;
+    uint32_t padding[3];
+};
+
+template <>
+struct VertexLayoutOf<InstanceData>
+{
+    static constexpr VertexLayout value = makeVertexLayout<InstanceData>(
+        {VERTEX_ATTRIBUTE(InstanceData, model, 3), VERTEX_ATTRIBUTE(InstanceData, materialId, 7)});
+};
+
+struct DrawPacket
+{
+    GLuint program;
+    uint32_t textureSet;
+    GLuint vao;
+    DrawRange range;
+    uint32_t instanceIndex;
+};
+
+// Shared layout of DrawArraysIndirectCommand (first 4 fields) and
+// DrawElementsIndirectCommand, so both kinds live in the same buffer.
+struct IndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseVertexOrBaseInstance;
+    GLuint baseInstance;
+};
+
+struct RenderQueueStats
+{
+    size_t packets = 0;
+    size_t multiDrawCalls = 0;
+    size_t programBinds = 0;
+    size_t textureSetBinds = 0;
+    size_t vaoBinds = 0;
+};
+
+// 64 bit sort key, most significant first:
+// program (12 bits) | texture set (12 bits) | vao (12 bits) | indexed (1 bit) | depth (24 bits)
+uint64_t makeSortKey(GLuint program, uint32_t textureSet, GLuint vao, bool indexed, float depth);
+
+// Collects draw packets during the frame, sorts them by state and depth, then submits
+// every run of packets sharing program, texture set and VAO with one glMulti*DrawIndirect call.
+// Commands and instance data are streamed through the ring buffer; instance data feeds
+// per-instance attributes and is selected with baseInstance. Materials indexed by ID in the
+// shader (see MaterialTextures) don't split runs, only texture sets bound to units do.
+class RenderQueue
+{
+public:
+    // instanceBinding is the VAO vertex buffer binding read with a divisor of 1 for InstanceData
+    RenderQueue(GLRingBuffer &ring, GLStateCache &state, GLuint instanceBinding);
+
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    // Textures of a set are bound on units 0..n-1, an empty set binds nothing.
+    uint32_t addTextureSet(const std::vector<GLuint> &textures);
+
+    // Depth keys are computed in view space and quantized over [zNear, zFar].
+    void setView(const glm::mat4 &view, float zNear, float zFar);
+
+    void push(GLuint program, uint32_t textureSet, GLuint vao, const DrawRange &range,
+              const glm::mat4 &model, uint32_t materialId = 0);
+
+    // Sorts, uploads and draws everything pushed since the last submit.
+    void submit();
+
+    const RenderQueueStats &stats() const { return m_Stats; }
+
+private:
+    GLRingBuffer &m_Ring;
+    GLStateCache &m_State;
+    GLuint m_nInstanceBinding;
+
+    glm::mat4 m_View{1.f};
+    float m_fNear = 0.1f;
+    float m_fFar = 100.f;
+
+    std::vector<std::vector<GLuint>> m_TextureSets;
+    std::vector<DrawPacket> m_Packets;
+    std::vector<InstanceData> m_Instances;
+    std::vector<std::pair<uint64_t, uint32_t>> m_SortKeys;
+
+    RenderQueueStats m_Stats;
+};
@@ -0,0 +1,85 @@
+#include "ring_buffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+GLRingBuffer::GLRingBuffer(GLsizeiptr regionSize, GLuint regionCount)
+    : m_nRegionSize(regionSize), m_Fences(regionCount, nullptr), m_nRegion(regionCount - 1)
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    m_Buffer.storage(regionSize * regionCount, nullptr, flags);
+    m_pMapping = static_cast<unsigned char *>(m_Buffer.map(0, regionSize * regionCount, flags));
+    if (!m_pMapping)
+    {
+        throw std::runtime_error("Unable to map ring buffer");
+    }
+}
+
+GLRingBuffer::~GLRingBuffer()
+{
+    for (auto fence : m_Fences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    if (m_pMapping)
+    {
+        m_Buffer.unmap();
+    }
+}
+
+void GLRingBuffer::beginFrame()
+{
+    m_nRegion = (m_nRegion + 1) % GLuint(m_Fences.size());
+    m_nRegionHead = 0;
+
+    auto &fence = m_Fences[m_nRegion];
+    if (!fence)
+    {
+        return;
+    }
+    // poll first so a region the GPU already released doesn't count as a stall
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        GLenum status;
+        do
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        ++m_Stats.stalls;
+        m_Stats.lastStallMs = std::chrono::duration<double, std::milli>(
+                                  std::chrono::high_resolution_clock::now() - start)
+                                  .count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void GLRingBuffer::endFrame()
+{
+    m_Fences[m_nRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_Stats.frameBytes = m_nRegionHead;
+    m_Stats.peakBytes = std::max(m_Stats.peakBytes, m_nRegionHead);
+}
+
+RingAllocation GLRingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    const GLsizeiptr regionStart = GLsizeiptr(m_nRegion) * m_nRegionSize;
+    // align the absolute offset, binding points care about it rather than the region's
+    GLsizeiptr offset = regionStart + m_nRegionHead;
+    offset = (offset + alignment - 1) / alignment * alignment;
+    if (offset + size > regionStart + m_nRegionSize)
+    {
+        std::stringstream ss;
+        ss << "Ring buffer region exhausted: " << size << " bytes requested, "
+           << regionStart + m_nRegionSize - offset << " left of " << m_nRegionSize;
+        throw std::runtime_error(ss.str());
+    }
+    m_nRegionHead = offset + size - regionStart;
+    return RingAllocation{m_pMapping + offset, offset, size};
+}
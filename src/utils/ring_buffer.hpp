@@ -0,0 +1,64 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+struct RingAllocation
+{
+    void *data;
+    GLintptr offset; // from the start of the whole buffer, for glBindBufferRange & co
+    GLsizeiptr size;
+};
+
+struct RingBufferStats
+{
+    size_t stalls = 0;         // frames that had to wait on the GPU for their region
+    double lastStallMs = 0.;   // duration of the most recent stall
+    GLsizeiptr frameBytes = 0; // bytes allocated by the previous frame
+    GLsizeiptr peakBytes = 0;  // most bytes allocated by a single frame
+};
+
+// Persistently mapped streaming buffer split in one region per frame in flight.
+// Each region is guarded by a fence placed at the end of the frame that wrote it,
+// so the CPU only waits when it laps the GPU. Allocations are bump-allocated slices
+// of the current region, written directly through the coherent mapping.
+class GLRingBuffer
+{
+public:
+    GLRingBuffer(GLsizeiptr regionSize, GLuint regionCount = 3);
+    ~GLRingBuffer();
+
+    GLRingBuffer(const GLRingBuffer &) = delete;
+    GLRingBuffer &operator=(const GLRingBuffer &) = delete;
+
+    // Moves to the next region, waiting for the GPU to be done with it if needed.
+    void beginFrame();
+    // Fences the current region.
+    void endFrame();
+
+    // Throws std::runtime_error if the current region is exhausted: the ring is undersized.
+    RingAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    template <typename T>
+    RingAllocation allocate(size_t count, GLsizeiptr alignment = alignof(T))
+    {
+        return allocate(GLsizeiptr(count * sizeof(T)), alignment);
+    }
+
+    GLuint glId() const { return m_Buffer.glId(); }
+    GLsizeiptr regionSize() const { return m_nRegionSize; }
+    GLuint regionCount() const { return GLuint(m_Fences.size()); }
+    const RingBufferStats &stats() const { return m_Stats; }
+
+private:
+    GLBuffer m_Buffer;
+    unsigned char *m_pMapping = nullptr;
+    GLsizeiptr m_nRegionSize;
+    std::vector<GLsync> m_Fences;
+    GLuint m_nRegion = 0;
+    GLsizeiptr m_nRegionHead = 0;
+    RingBufferStats m_Stats;
+};
@@ -1,14 +1,21 @@
 #pragma once
 
 #include "filesystem.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class GLShader
 {
@@ -118,11 +125,150 @@ inline GLShader loadShader(const fs::path &shaderPath)
     return shader;
 }
 
+inline GLsizei uniformTypeSize(GLenum type)
+{
+    switch (type)
+    {
+    case GL_FLOAT:
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_BOOL:
+        return 4;
+    case GL_FLOAT_VEC2:
+    case GL_INT_VEC2:
+    case GL_UNSIGNED_INT_VEC2:
+    case GL_BOOL_VEC2:
+        return 8;
+    case GL_FLOAT_VEC3:
+    case GL_INT_VEC3:
+    case GL_UNSIGNED_INT_VEC3:
+    case GL_BOOL_VEC3:
+        return 12;
+    case GL_FLOAT_VEC4:
+    case GL_INT_VEC4:
+    case GL_UNSIGNED_INT_VEC4:
+    case GL_BOOL_VEC4:
+    case GL_FLOAT_MAT2:
+        return 16;
+    case GL_FLOAT_MAT2x3:
+    case GL_FLOAT_MAT3x2:
+        return 24;
+    case GL_FLOAT_MAT2x4:
+    case GL_FLOAT_MAT4x2:
+        return 32;
+    case GL_FLOAT_MAT3:
+        return 36;
+    case GL_FLOAT_MAT3x4:
+    case GL_FLOAT_MAT4x3:
+        return 48;
+    case GL_FLOAT_MAT4:
+        return 64;
+    default:
+        // samplers, images and atomic counters are set as a single int
+        return 4;
+    }
+}
+
+inline bool isSamplerType(GLenum type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_SHADOW:
+    case GL_SAMPLER_2D_SHADOW:
+    case GL_SAMPLER_1D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_1D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE:
+    case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_BUFFER:
+    case GL_SAMPLER_2D_RECT:
+    case GL_SAMPLER_2D_RECT_SHADOW:
+    case GL_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+    case GL_INT_SAMPLER_1D:
+    case GL_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_3D:
+    case GL_INT_SAMPLER_CUBE:
+    case GL_INT_SAMPLER_1D_ARRAY:
+    case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_INT_SAMPLER_2D_MULTISAMPLE:
+    case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_INT_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_2D_RECT:
+    case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_1D:
+    case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_UNSIGNED_INT_SAMPLER_3D:
+    case GL_UNSIGNED_INT_SAMPLER_CUBE:
+    case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+    case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+    case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// FNV-1a, used to key the reflected uniform table
+inline uint32_t hashUniformName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name; ++name)
+    {
+        hash ^= static_cast<unsigned char>(*name);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct GLUniformInfo
+{
+    std::string name;
+    GLenum type;
+    GLint location;
+    GLint arraySize;
+    GLsizei shadowOffset; // byte offset of the last uploaded value
+    GLsizei shadowSize;
+    bool shadowValid;
+};
+
+struct GLBlockInfo
+{
+    std::string name;
+    GLuint index;
+    GLint binding;
+    GLint dataSize;
+};
+
+// index into GLProgram's uniform table, resolved once and reused per draw
+typedef GLint GLUniformHandle;
+
 class GLProgram
 {
     GLuint m_GLId;
     typedef std::unique_ptr<char[]> CharBuffer;
 
+    // reflected state, rebuilt after every successful link
+    std::vector<GLUniformInfo> m_Uniforms;
+    std::vector<GLUniformHandle> m_Samplers;
+    std::vector<GLBlockInfo> m_UniformBlocks;
+    std::vector<GLBlockInfo> m_StorageBlocks;
+    // open addressing table: (name hash, uniform index + 1), 0 means empty slot
+    std::vector<std::pair<uint32_t, GLint>> m_UniformTable;
+    std::vector<unsigned char> m_UniformShadow;
+    mutable size_t m_nUniformCallsIssued = 0;
+    mutable size_t m_nUniformCallsSkipped = 0;
+
 public:
     GLProgram() : m_GLId(glCreateProgram()) {}
     ~GLProgram() { glDeleteProgram(m_GLId); }
@@ -130,12 +276,32 @@ public:
     GLProgram(const GLProgram &) = delete;
     GLProgram &operator=(const GLProgram &) = delete;
 
-    GLProgram(GLProgram &&rvalue) : m_GLId(rvalue.m_GLId) { rvalue.m_GLId = 0; }
+    GLProgram(GLProgram &&rvalue)
+        : m_GLId(rvalue.m_GLId),
+          m_Uniforms(std::move(rvalue.m_Uniforms)),
+          m_Samplers(std::move(rvalue.m_Samplers)),
+          m_UniformBlocks(std::move(rvalue.m_UniformBlocks)),
+          m_StorageBlocks(std::move(rvalue.m_StorageBlocks)),
+          m_UniformTable(std::move(rvalue.m_UniformTable)),
+          m_UniformShadow(std::move(rvalue.m_UniformShadow)),
+          m_nUniformCallsIssued(rvalue.m_nUniformCallsIssued),
+          m_nUniformCallsSkipped(rvalue.m_nUniformCallsSkipped)
+    {
+        rvalue.m_GLId = 0;
+    }
     GLProgram &operator=(GLProgram &&rvalue)
     {
-        this->~GLProgram();
+        glDeleteProgram(m_GLId);
         m_GLId = rvalue.m_GLId;
         rvalue.m_GLId = 0;
+        m_Uniforms = std::move(rvalue.m_Uniforms);
+        m_Samplers = std::move(rvalue.m_Samplers);
+        m_UniformBlocks = std::move(rvalue.m_UniformBlocks);
+        m_StorageBlocks = std::move(rvalue.m_StorageBlocks);
+        m_UniformTable = std::move(rvalue.m_UniformTable);
+        m_UniformShadow = std::move(rvalue.m_UniformShadow);
+        m_nUniformCallsIssued = rvalue.m_nUniformCallsIssued;
+        m_nUniformCallsSkipped = rvalue.m_nUniformCallsSkipped;
         return *this;
     }
 
@@ -148,7 +314,12 @@ public:
     bool link()
     {
         glLinkProgram(m_GLId);
-        return getLinkStatus();
+        if (!getLinkStatus())
+        {
+            return false;
+        }
+        reflect();
+        return true;
     }
     bool getLinkStatus() const
     {
@@ -170,6 +341,12 @@ public:
 
     GLint getUniformLocation(const GLchar *name) const
     {
+        const auto handle = getUniformHandle(name);
+        if (handle >= 0)
+        {
+            return m_Uniforms[handle].location;
+        }
+        // array elements other than the first and struct members are not in the table
         GLint location = glGetUniformLocation(m_GLId, name);
         return location;
     }
@@ -184,6 +361,222 @@ public:
     {
         glBindAttribLocation(m_GLId, index, name);
     }
+
+    // Enumerates active uniforms, samplers and blocks with the program interface query API.
+    // Called by link(), only needs to be called again if the program is relinked by hand.
+    void reflect()
+    {
+        m_Uniforms.clear();
+        m_Samplers.clear();
+        m_UniformBlocks.clear();
+        m_StorageBlocks.clear();
+        m_UniformShadow.clear();
+
+        GLint uniformCount = 0;
+        glGetProgramInterfaceiv(m_GLId, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+        GLint maxNameLength = 0;
+        glGetProgramInterfaceiv(m_GLId, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+        CharBuffer nameBuffer(new char[std::max(maxNameLength, 1)]);
+
+        const GLenum uniformProps[] = {GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX};
+        GLsizei shadowSize = 0;
+        for (GLint i = 0; i < uniformCount; ++i)
+        {
+            GLint values[4];
+            glGetProgramResourceiv(m_GLId, GL_UNIFORM, i, 4, uniformProps, 4, nullptr, values);
+            // members of uniform and storage blocks are reflected through their block
+            if (values[3] != -1 || values[1] < 0)
+            {
+                continue;
+            }
+            glGetProgramResourceName(m_GLId, GL_UNIFORM, i, maxNameLength, nullptr, nameBuffer.get());
+
+            GLUniformInfo info;
+            info.name = nameBuffer.get();
+            // "textures[0]" is registered as "textures"
+            const auto bracket = info.name.find('[');
+            if (bracket != std::string::npos)
+            {
+                info.name.resize(bracket);
+            }
+            info.type = GLenum(values[0]);
+            info.location = values[1];
+            info.arraySize = values[2];
+            info.shadowOffset = shadowSize;
+            info.shadowSize = uniformTypeSize(info.type) * info.arraySize;
+            info.shadowValid = false;
+            shadowSize += info.shadowSize;
+
+            if (isSamplerType(info.type))
+            {
+                m_Samplers.push_back(GLUniformHandle(m_Uniforms.size()));
+            }
+            m_Uniforms.push_back(std::move(info));
+        }
+        m_UniformShadow.resize(shadowSize);
+
+        reflectBlocks(GL_UNIFORM_BLOCK, m_UniformBlocks);
+        reflectBlocks(GL_SHADER_STORAGE_BLOCK, m_StorageBlocks);
+
+        // keep the load factor under 1/2 so probe sequences stay short
+        size_t tableSize = 8;
+        while (tableSize < 2 * m_Uniforms.size())
+        {
+            tableSize *= 2;
+        }
+        m_UniformTable.assign(tableSize, std::make_pair(0u, 0));
+        for (size_t i = 0; i < m_Uniforms.size(); ++i)
+        {
+            const auto hash = hashUniformName(m_Uniforms[i].name.c_str());
+            size_t slot = hash & (tableSize - 1);
+            while (m_UniformTable[slot].second != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            m_UniformTable[slot] = std::make_pair(hash, GLint(i + 1));
+        }
+    }
+
+    // Returns -1 if the uniform is not active in the program.
+    GLUniformHandle getUniformHandle(const GLchar *name) const
+    {
+        if (m_UniformTable.empty())
+        {
+            return -1;
+        }
+        const auto hash = hashUniformName(name);
+        const size_t mask = m_UniformTable.size() - 1;
+        for (size_t slot = hash & mask; m_UniformTable[slot].second != 0; slot = (slot + 1) & mask)
+        {
+            const auto &entry = m_UniformTable[slot];
+            if (entry.first == hash && m_Uniforms[entry.second - 1].name == name)
+            {
+                return entry.second - 1;
+            }
+        }
+        return -1;
+    }
+
+    const std::vector<GLUniformInfo> &getUniforms() const { return m_Uniforms; }
+    const std::vector<GLUniformHandle> &getSamplers() const { return m_Samplers; }
+    const std::vector<GLBlockInfo> &getUniformBlocks() const { return m_UniformBlocks; }
+    const std::vector<GLBlockInfo> &getStorageBlocks() const { return m_StorageBlocks; }
+
+    // Typed setters going through glProgramUniform*, so the program doesn't need to be bound.
+    // The last uploaded value is shadowed and identical values never reach the driver.
+    void setUniform(GLUniformHandle handle, GLint value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform1i(m_GLId, m_Uniforms[handle].location, value);
+    }
+    void setUniform(GLUniformHandle handle, GLuint value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform1ui(m_GLId, m_Uniforms[handle].location, value);
+    }
+    void setUniform(GLUniformHandle handle, float value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform1f(m_GLId, m_Uniforms[handle].location, value);
+    }
+    void setUniform(GLUniformHandle handle, const glm::vec2 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform2fv(m_GLId, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+    void setUniform(GLUniformHandle handle, const glm::vec3 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform3fv(m_GLId, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+    void setUniform(GLUniformHandle handle, const glm::vec4 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform4fv(m_GLId, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+    void setUniform(GLUniformHandle handle, const glm::ivec2 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform2iv(m_GLId, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+    void setUniform(GLUniformHandle handle, const glm::ivec4 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniform4iv(m_GLId, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+    }
+    void setUniform(GLUniformHandle handle, const glm::mat3 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniformMatrix3fv(m_GLId, m_Uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void setUniform(GLUniformHandle handle, const glm::mat4 &value)
+    {
+        if (updateShadow(handle, &value, sizeof(value)))
+            glProgramUniformMatrix4fv(m_GLId, m_Uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+    template <typename T>
+    void setUniform(const GLchar *name, const T &value)
+    {
+        setUniform(getUniformHandle(name), value);
+    }
+
+    size_t getUniformCallsIssued() const { return m_nUniformCallsIssued; }
+    size_t getUniformCallsSkipped() const { return m_nUniformCallsSkipped; }
+    void resetUniformCallCounters() const
+    {
+        m_nUniformCallsIssued = 0;
+        m_nUniformCallsSkipped = 0;
+    }
+
+    // Forget shadowed values, e.g. after uniforms were changed behind the program's back.
+    void invalidateUniformShadow()
+    {
+        for (auto &uniform : m_Uniforms)
+        {
+            uniform.shadowValid = false;
+        }
+    }
+
+private:
+    void reflectBlocks(GLenum interface, std::vector<GLBlockInfo> &blocks)
+    {
+        GLint blockCount = 0;
+        glGetProgramInterfaceiv(m_GLId, interface, GL_ACTIVE_RESOURCES, &blockCount);
+        GLint maxNameLength = 0;
+        glGetProgramInterfaceiv(m_GLId, interface, GL_MAX_NAME_LENGTH, &maxNameLength);
+        CharBuffer nameBuffer(new char[std::max(maxNameLength, 1)]);
+
+        const GLenum blockProps[] = {GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE};
+        for (GLint i = 0; i < blockCount; ++i)
+        {
+            GLint values[2];
+            glGetProgramResourceiv(m_GLId, interface, i, 2, blockProps, 2, nullptr, values);
+            glGetProgramResourceName(m_GLId, interface, i, maxNameLength, nullptr, nameBuffer.get());
+            blocks.push_back(GLBlockInfo{nameBuffer.get(), GLuint(i), values[0], values[1]});
+        }
+    }
+
+    // Returns true if the value differs from the shadow copy and must be sent to GL.
+    bool updateShadow(GLUniformHandle handle, const void *value, GLsizei size)
+    {
+        if (handle < 0)
+        {
+            return false;
+        }
+        auto &uniform = m_Uniforms[handle];
+        assert(size <= uniform.shadowSize);
+        unsigned char *shadow = m_UniformShadow.data() + uniform.shadowOffset;
+        if (uniform.shadowValid && std::memcmp(shadow, value, size) == 0)
+        {
+            ++m_nUniformCallsSkipped;
+            return false;
+        }
+        std::memcpy(shadow, value, size);
+        uniform.shadowValid = true;
+        ++m_nUniformCallsIssued;
+        return true;
+    }
 };
 
 inline GLProgram buildProgram(std::initializer_list<GLShader> shaders)
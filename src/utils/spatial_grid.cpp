@@ -0,0 +1,379 @@
+#include "spatial_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+// coordinates are clamped so the three of them pack in 63 bits without collisions
+const int MAX_CELL_COORD = (1 << 20) - 1;
+
+inline uint64_t cellKey(const glm::ivec3 &coords)
+{
+    const uint64_t mask = (1u << 21) - 1;
+    return (uint64_t(coords.x) & mask) << 42 | (uint64_t(coords.y) & mask) << 21 |
+           (uint64_t(coords.z) & mask);
+}
+
+// -1 when the box is outside a plane, 1 when inside all of them, 0 when crossing one
+int classify(const Frustum &frustum, const glm::vec3 &center, const glm::vec3 &extent)
+{
+    int result = 1;
+    for (const auto &plane : frustum.planes)
+    {
+        const glm::vec3 normal(plane);
+        const float distance = glm::dot(normal, center) + plane.w;
+        const float radius = glm::dot(glm::abs(normal), extent);
+        if (distance + radius < 0.f)
+        {
+            return -1;
+        }
+        if (distance - radius < 0.f)
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+inline float squaredDistance(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                             const glm::vec3 &point)
+{
+    const glm::vec3 d = glm::max(glm::max(boundsMin - point, point - boundsMax), glm::vec3(0.f));
+    return glm::dot(d, d);
+}
+} // namespace
+
+SpatialGrid::SpatialGrid(float cellSize)
+    : m_fCellSize(cellSize), m_fInverseCellSize(1.f / cellSize)
+{
+    if (!(cellSize > 0.f))
+    {
+        std::cerr << "SpatialGrid: cell size must be positive" << std::endl;
+        throw std::runtime_error("SpatialGrid: cell size must be positive");
+    }
+}
+
+glm::ivec3 SpatialGrid::cellCoords(const glm::vec3 &point) const
+{
+    const glm::vec3 coords = glm::floor(point * m_fInverseCellSize);
+    return glm::ivec3(glm::clamp(coords, glm::vec3(-MAX_CELL_COORD), glm::vec3(MAX_CELL_COORD)));
+}
+
+uint32_t SpatialGrid::findCell(const glm::ivec3 &coords) const
+{
+    if (glm::any(glm::lessThan(coords, m_CellMin)) || glm::any(glm::greaterThan(coords, m_CellMax)))
+    {
+        return ~0u;
+    }
+    const auto found = m_CellIndices.find(cellKey(coords));
+    return found == m_CellIndices.end() ? ~0u : found->second;
+}
+
+void SpatialGrid::link(uint32_t object, const AABB &box)
+{
+    Object &o = m_Objects[object];
+    const glm::vec3 extent = box.extent();
+    if (std::max(extent.x, std::max(extent.y, extent.z)) > .5f * m_fCellSize)
+    {
+        o.cell = LARGE_OBJECT;
+    }
+    else
+    {
+        const glm::ivec3 coords = cellCoords(box.center());
+        const auto inserted = m_CellIndices.emplace(cellKey(coords), uint32_t(m_Cells.size()));
+        if (inserted.second)
+        {
+            m_Cells.push_back(Cell{coords, {}, {}});
+            const bool first = glm::any(glm::greaterThan(m_CellMin, m_CellMax));
+            m_CellMin = first ? coords : glm::min(m_CellMin, coords);
+            m_CellMax = first ? coords : glm::max(m_CellMax, coords);
+        }
+        o.cell = inserted.first->second;
+    }
+    Cell &target = cell(o.cell);
+    o.slot = uint32_t(target.objects.size());
+    target.objects.push_back(object);
+    target.boxes.push_back(box);
+}
+
+void SpatialGrid::unlink(uint32_t object)
+{
+    const Object &o = m_Objects[object];
+    Cell &source = cell(o.cell);
+    const uint32_t last = source.objects.back();
+    source.objects[o.slot] = last;
+    source.boxes[o.slot] = source.boxes.back();
+    m_Objects[last].slot = o.slot;
+    source.objects.pop_back();
+    source.boxes.pop_back();
+    if (o.cell == LARGE_OBJECT || !source.objects.empty())
+    {
+        return;
+    }
+
+    // empty cells are removed, the last one takes the freed index
+    const uint32_t index = o.cell;
+    m_CellIndices.erase(cellKey(source.coords));
+    if (index + 1 != m_Cells.size())
+    {
+        m_Cells[index] = std::move(m_Cells.back());
+        m_CellIndices[cellKey(m_Cells[index].coords)] = index;
+        for (const auto moved : m_Cells[index].objects)
+        {
+            m_Objects[moved].cell = index;
+        }
+    }
+    m_Cells.pop_back();
+}
+
+uint32_t SpatialGrid::insert(const AABB &box)
+{
+    uint32_t object;
+    if (!m_FreeObjects.empty())
+    {
+        object = m_FreeObjects.back();
+        m_FreeObjects.pop_back();
+    }
+    else
+    {
+        object = uint32_t(m_Objects.size());
+        m_Objects.emplace_back();
+    }
+    link(object, box);
+    ++m_nObjectCount;
+    return object;
+}
+
+void SpatialGrid::move(uint32_t object, const AABB &box)
+{
+    const Object &o = m_Objects[object];
+    // still small and centered in the same cell, nothing to relink; compared against the cell
+    // corners, cheaper than converting the center to coordinates
+    if (o.cell != LARGE_OBJECT)
+    {
+        Cell &current = m_Cells[o.cell];
+        const glm::vec3 center = box.center(), extent = box.extent();
+        const glm::vec3 cellMin = glm::vec3(current.coords) * m_fCellSize;
+        const float half = .5f * m_fCellSize;
+        if (center.x >= cellMin.x && center.y >= cellMin.y && center.z >= cellMin.z &&
+            center.x < cellMin.x + m_fCellSize && center.y < cellMin.y + m_fCellSize &&
+            center.z < cellMin.z + m_fCellSize && extent.x <= half && extent.y <= half &&
+            extent.z <= half)
+        {
+            current.boxes[o.slot] = box;
+            return;
+        }
+    }
+    unlink(object);
+    link(object, box);
+}
+
+void SpatialGrid::remove(uint32_t object)
+{
+    unlink(object);
+    m_Objects[object].cell = FREE_OBJECT;
+    m_FreeObjects.push_back(object);
+    --m_nObjectCount;
+}
+
+void SpatialGrid::clear()
+{
+    m_Objects.clear();
+    m_FreeObjects.clear();
+    m_LargeObjects.objects.clear();
+    m_LargeObjects.boxes.clear();
+    m_Cells.clear();
+    m_CellIndices.clear();
+    m_CellMin = glm::ivec3(0);
+    m_CellMax = glm::ivec3(-1);
+    m_nObjectCount = 0;
+}
+
+void SpatialGrid::queryFrustum(const Frustum &frustum, std::vector<uint32_t> &result) const
+{
+    result.clear();
+    const auto testObjects = [&](const Cell &cell) {
+        for (size_t i = 0; i < cell.objects.size(); ++i)
+        {
+            if (intersects(frustum, cell.boxes[i]))
+            {
+                result.push_back(cell.objects[i]);
+            }
+        }
+    };
+    testObjects(m_LargeObjects);
+    // a loose cell spans two cell sizes, centered on the cell
+    const glm::vec3 looseExtent(m_fCellSize);
+    for (const auto &cell : m_Cells)
+    {
+        const glm::vec3 center = (glm::vec3(cell.coords) + .5f) * m_fCellSize;
+        const int side = classify(frustum, center, looseExtent);
+        if (side > 0)
+        {
+            result.insert(end(result), begin(cell.objects), end(cell.objects));
+        }
+        else if (side == 0)
+        {
+            testObjects(cell);
+        }
+    }
+}
+
+void SpatialGrid::querySphere(const glm::vec3 &center, float radius,
+                              std::vector<uint32_t> &result) const
+{
+    result.clear();
+    const float radiusSquared = radius * radius;
+    const auto testObjects = [&](const Cell &cell) {
+        for (size_t i = 0; i < cell.objects.size(); ++i)
+        {
+            if (squaredDistance(cell.boxes[i].min, cell.boxes[i].max, center) <= radiusSquared)
+            {
+                result.push_back(cell.objects[i]);
+            }
+        }
+    };
+    testObjects(m_LargeObjects);
+    if (m_Cells.empty())
+    {
+        return;
+    }
+
+    const float reach = radius + .5f * m_fCellSize;
+    const glm::ivec3 first = glm::max(cellCoords(center - reach), m_CellMin);
+    const glm::ivec3 last = glm::min(cellCoords(center + reach), m_CellMax);
+    if (glm::any(glm::greaterThan(first, last)))
+    {
+        return;
+    }
+    const glm::dvec3 range = glm::dvec3(last - first) + 1.;
+    if (range.x * range.y * range.z > double(m_Cells.size()))
+    {
+        // large spheres test the occupied cells rather than looking up every covered one
+        const float margin = .5f * m_fCellSize;
+        for (const auto &cell : m_Cells)
+        {
+            const glm::vec3 cellMin = glm::vec3(cell.coords) * m_fCellSize - margin;
+            if (squaredDistance(cellMin, cellMin + 2.f * m_fCellSize, center) <= radiusSquared)
+            {
+                testObjects(cell);
+            }
+        }
+        return;
+    }
+    for (int z = first.z; z <= last.z; ++z)
+    {
+        for (int y = first.y; y <= last.y; ++y)
+        {
+            for (int x = first.x; x <= last.x; ++x)
+            {
+                const auto found = m_CellIndices.find(cellKey(glm::ivec3(x, y, z)));
+                if (found != m_CellIndices.end())
+                {
+                    testObjects(m_Cells[found->second]);
+                }
+            }
+        }
+    }
+}
+
+bool SpatialGrid::testCell(const Cell &cell, const Ray &ray, const glm::vec3 &inverseDirection,
+                           RayHit &hit) const
+{
+    bool found = false;
+    for (size_t i = 0; i < cell.objects.size(); ++i)
+    {
+        const auto &box = cell.boxes[i];
+        const float t = intersectRayAABB(ray.origin, inverseDirection, box.min, box.max, hit.t);
+        if (t >= 0.f && t < hit.t)
+        {
+            hit.object = cell.objects[i];
+            hit.t = t;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool SpatialGrid::raycast(const Ray &ray, RayHit &hit) const
+{
+    const glm::vec3 inverseDirection = 1.f / ray.direction;
+    bool found = testCell(m_LargeObjects, ray, inverseDirection, hit);
+    if (m_Cells.empty())
+    {
+        return found;
+    }
+
+    // 3D DDA over the cells pierced by the ray (Amanatides & Woo). A box reaches half a cell
+    // out of its own cell, so the cells around the current one are tested too; after a step
+    // only the layer of neighbours entered is new. Hits closer than the next cell are final.
+    const glm::ivec3 walkMin = m_CellMin - 1, walkMax = m_CellMax + 1;
+    const float enter =
+        intersectRayAABB(ray.origin, inverseDirection, glm::vec3(walkMin) * m_fCellSize,
+                         glm::vec3(walkMax + 1) * m_fCellSize, hit.t);
+    if (enter < 0.f)
+    {
+        return found;
+    }
+    glm::ivec3 cell = glm::clamp(cellCoords(ray.origin + enter * ray.direction), walkMin, walkMax);
+    glm::ivec3 step;
+    glm::vec3 nextT, deltaT;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float direction = ray.direction[axis];
+        step[axis] = direction > 0.f ? 1 : (direction < 0.f ? -1 : 0);
+        const float boundary = float(cell[axis] + (direction > 0.f ? 1 : 0)) * m_fCellSize;
+        nextT[axis] = step[axis] ? (boundary - ray.origin[axis]) * inverseDirection[axis] : INFINITY;
+        deltaT[axis] = step[axis] ? m_fCellSize * std::abs(inverseDirection[axis]) : INFINITY;
+    }
+
+    const auto testNeighbour = [&](const glm::ivec3 &coords) {
+        const uint32_t neighbour = findCell(coords);
+        if (neighbour != ~0u)
+        {
+            found |= testCell(m_Cells[neighbour], ray, inverseDirection, hit);
+        }
+    };
+    for (int z = -1; z <= 1; ++z)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                testNeighbour(cell + glm::ivec3(x, y, z));
+            }
+        }
+    }
+    for (;;)
+    {
+        const int axis = nextT.x < nextT.y ? (nextT.x < nextT.z ? 0 : 2)
+                                           : (nextT.y < nextT.z ? 1 : 2);
+        if (nextT[axis] > hit.t)
+        {
+            break;
+        }
+        cell[axis] += step[axis];
+        nextT[axis] += deltaT[axis];
+        if (cell[axis] < walkMin[axis] || cell[axis] > walkMax[axis])
+        {
+            break;
+        }
+        // the layer one further along the stepped axis
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        glm::ivec3 coords;
+        coords[axis] = cell[axis] + step[axis];
+        for (int dv = -1; dv <= 1; ++dv)
+        {
+            for (int du = -1; du <= 1; ++du)
+            {
+                coords[u] = cell[u] + du;
+                coords[v] = cell[v] + dv;
+                testNeighbour(coords);
+            }
+        }
+    }
+    return found;
+}
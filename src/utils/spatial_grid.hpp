@@ -0,0 +1,86 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "bvh.hpp"
+#include "frustum.hpp"
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Hashed loose grid for many moving objects. An object lives in the one cell holding its box
+// center, and cells are queried as if they were half a cell larger on every side, so an
+// object is never stored twice and moving it inside its cell is only a box update. Insert,
+// move and remove are O(1) amortized. Boxes are stored in their cell so queries read them
+// sequentially. Objects larger than half a cell go to a list that every query tests. Cells
+// are found by hashing their integer coordinates: the grid is unbounded and only occupied
+// cells use memory. The cell size should be a few times the typical object size.
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(float cellSize = 4.f);
+
+    // Returns the object identifier, identifiers of removed objects are reused.
+    uint32_t insert(const AABB &box);
+    void move(uint32_t object, const AABB &box);
+    void remove(uint32_t object);
+    void clear();
+
+    const AABB &bounds(uint32_t object) const
+    {
+        return cell(m_Objects[object].cell).boxes[m_Objects[object].slot];
+    }
+    size_t size() const { return m_nObjectCount; }
+    size_t cellCount() const { return m_Cells.size(); }
+    size_t largeObjectCount() const { return m_LargeObjects.objects.size(); }
+    float cellSize() const { return m_fCellSize; }
+
+    // Objects whose box intersects the frustum, in no particular order. Cells fully inside
+    // the frustum are appended without testing their objects.
+    void queryFrustum(const Frustum &frustum, std::vector<uint32_t> &result) const;
+    // Objects whose box intersects the sphere, in no particular order.
+    void querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &result) const;
+    // Nearest box hit closer than hit.t, cells are walked front to back along the ray.
+    bool raycast(const Ray &ray, RayHit &hit) const;
+
+private:
+    struct Cell
+    {
+        glm::ivec3 coords;
+        std::vector<uint32_t> objects;
+        std::vector<AABB> boxes;
+    };
+    struct Object
+    {
+        uint32_t cell; // FREE_OBJECT, LARGE_OBJECT or an index in m_Cells
+        uint32_t slot; // position in the lists of the cell
+    };
+    static const uint32_t FREE_OBJECT = ~0u;
+    static const uint32_t LARGE_OBJECT = ~0u - 1;
+
+    Cell &cell(uint32_t index) { return index == LARGE_OBJECT ? m_LargeObjects : m_Cells[index]; }
+    const Cell &cell(uint32_t index) const
+    {
+        return index == LARGE_OBJECT ? m_LargeObjects : m_Cells[index];
+    }
+    glm::ivec3 cellCoords(const glm::vec3 &point) const;
+    uint32_t findCell(const glm::ivec3 &coords) const;
+    void link(uint32_t object, const AABB &box);
+    void unlink(uint32_t object);
+    bool testCell(const Cell &cell, const Ray &ray, const glm::vec3 &inverseDirection,
+                  RayHit &hit) const;
+
+    float m_fCellSize;
+    float m_fInverseCellSize;
+    std::vector<Object> m_Objects;
+    std::vector<uint32_t> m_FreeObjects;
+    Cell m_LargeObjects;
+    std::vector<Cell> m_Cells;
+    std::unordered_map<uint64_t, uint32_t> m_CellIndices;
+    // coordinates of every cell created since the last clear, bounds the ray walk
+    glm::ivec3 m_CellMin = glm::ivec3(0);
+    glm::ivec3 m_CellMax = glm::ivec3(-1);
+    size_t m_nObjectCount = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Base alignment and size of the types that can mirror a std140 block member.
+// Arrays and structs are left out: they round up to vec4 and are spelled out by hand.
+template <typename T>
+struct Std140;
+
+template <>
+struct Std140<float>
+{
+    static constexpr size_t alignment = 4, size = 4;
+};
+template <>
+struct Std140<int>
+{
+    static constexpr size_t alignment = 4, size = 4;
+};
+template <>
+struct Std140<unsigned int>
+{
+    static constexpr size_t alignment = 4, size = 4;
+};
+template <>
+struct Std140<glm::vec2>
+{
+    static constexpr size_t alignment = 8, size = 8;
+};
+template <>
+struct Std140<glm::ivec2>
+{
+    static constexpr size_t alignment = 8, size = 8;
+};
+template <>
+struct Std140<glm::vec3>
+{
+    static constexpr size_t alignment = 16, size = 12;
+};
+template <>
+struct Std140<glm::vec4>
+{
+    static constexpr size_t alignment = 16, size = 16;
+};
+template <>
+struct Std140<glm::uvec4>
+{
+    static constexpr size_t alignment = 16, size = 16;
+};
+template <>
+struct Std140<glm::mat4>
+{
+    static constexpr size_t alignment = 16, size = 64;
+};
+
+constexpr size_t std140Align(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Offset std140 gives to a member of type T declared right after a member ending at previousEnd.
+template <typename T>
+constexpr size_t std140NextOffset(size_t previousEnd)
+{
+    return std140Align(previousEnd, Std140<T>::alignment);
+}
+
+#define STD140_FIRST_MEMBER(Struct, member)                                                  \
+    static_assert(offsetof(Struct, member) == 0, #Struct "::" #member " must be at offset 0")
+
+// Fails to compile if the C++ mirror of a block drifts from the offsets GLSL computes.
+#define STD140_MEMBER_AFTER(Struct, member, previous)                                        \
+    static_assert(offsetof(Struct, member) ==                                                \
+                      std140NextOffset<decltype(Struct::member)>(                            \
+                          offsetof(Struct, previous) + Std140<decltype(Struct::previous)>::size), \
+                  #Struct "::" #member " does not follow " #previous " with std140 layout")
+
+#define STD140_BLOCK_SIZE(Struct)                                                            \
+    static_assert(sizeof(Struct) % 16 == 0, #Struct " size must be a multiple of vec4")
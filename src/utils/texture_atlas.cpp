@@ -0,0 +1,207 @@
+#include "texture_atlas.hpp"
+#include "texture_cooker.hpp"
+#include "texture_format.hpp"
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+struct Placement
+{
+    uint32_t page;
+    int x, y; // of the rectangle, gutter included
+};
+
+int roundUp(int value, int alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+struct TextureAtlas::Page
+{
+    stbrp_context context;
+    std::vector<stbrp_node> nodes;
+    GLTexture texture;
+};
+
+TextureAtlas::TextureAtlas(int pageSize, int gutter, bool srgb, ThreadPool &pool)
+    : m_Pool(pool), m_nPageSize(pageSize), m_nGutter(std::max(gutter, 0)), m_bSrgb(srgb)
+{
+    if (pageSize <= 0 || (pageSize & (pageSize - 1)) != 0)
+    {
+        std::cerr << "Texture atlas pages must be a power of two, not " << pageSize << std::endl;
+        throw std::runtime_error("Invalid texture atlas page size");
+    }
+    // a level whose texels are as large as the gutter is the last one free of neighbours
+    m_nLevels = m_nGutter > 0 ? GLsizei(std::floor(std::log2(float(m_nGutter)))) + 1 : 1;
+    m_nLevels = std::min(m_nLevels, mipLevelCount(pageSize, pageSize));
+    m_nAlignment = 1 << (m_nLevels - 1);
+}
+
+TextureAtlas::~TextureAtlas() = default;
+
+const GLTexture &TextureAtlas::page(size_t index) const
+{
+    return m_Pages[index]->texture;
+}
+
+TextureAtlas::Page &TextureAtlas::createPage()
+{
+    m_Pages.push_back(std::make_unique<Page>());
+    Page &page = *m_Pages.back();
+    // packed in units of the alignment; a node per column, the skyline never runs out of them
+    const int units = m_nPageSize / m_nAlignment;
+    page.nodes.resize(size_t(units));
+    stbrp_init_target(&page.context, units, units, page.nodes.data(), units);
+
+    page.texture = createTexture2D(textureFormat(4, m_bSrgb), m_nPageSize, m_nPageSize, m_nLevels);
+    for (GLsizei level = 0; level < m_nLevels; ++level)
+    {
+        // free space is transparent black rather than undefined
+        glClearTexImage(page.texture.glId(), level, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    page.texture.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    page.texture.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    page.texture.setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    page.texture.setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return page;
+}
+
+std::vector<uint32_t> TextureAtlas::add(const std::vector<Image> &images)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    // rectangles are packed in units of the alignment, texels of the last level, so every
+    // level's rectangle starts and ends on whole texels
+    std::vector<stbrp_rect> pending(images.size());
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const Image &image = images[i];
+        pending[i].id = int(i);
+        pending[i].w = roundUp(image.width + 2 * m_nGutter, m_nAlignment) / m_nAlignment;
+        pending[i].h = roundUp(image.height + 2 * m_nGutter, m_nAlignment) / m_nAlignment;
+        if (image.width <= 0 || image.height <= 0 || pending[i].w * m_nAlignment > m_nPageSize ||
+            pending[i].h * m_nAlignment > m_nPageSize)
+        {
+            std::stringstream ss;
+            ss << "Texture atlas: a " << image.width << "x" << image.height
+               << " image doesn't fit in " << m_nPageSize << " texel pages";
+            std::cerr << ss.str() << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+    }
+
+    // existing pages first, then as many new ones as needed
+    std::vector<Placement> placements(images.size());
+    std::vector<stbrp_rect> remaining;
+    for (size_t page = 0; !pending.empty(); ++page)
+    {
+        const bool created = page == m_Pages.size();
+        if (created)
+        {
+            createPage();
+        }
+        stbrp_pack_rects(&m_Pages[page]->context, pending.data(), int(pending.size()));
+        remaining.clear();
+        for (const auto &rect : pending)
+        {
+            if (rect.was_packed)
+            {
+                placements[rect.id] = {uint32_t(page), rect.x * m_nAlignment,
+                                       rect.y * m_nAlignment};
+                m_Stats.packedTexels += size_t(rect.w) * size_t(rect.h) * size_t(m_nAlignment) *
+                                        size_t(m_nAlignment);
+            }
+            else
+            {
+                remaining.push_back(rect);
+            }
+        }
+        if (created && remaining.size() == pending.size())
+        {
+            // can't happen for rectangles smaller than a page, but never loop on it
+            throw std::runtime_error("Texture atlas: unable to pack in an empty page");
+        }
+        pending.swap(remaining);
+    }
+
+    // padded images and their mips on the pool, uploads on this thread
+    std::vector<CookedTexture> chains(images.size());
+    m_Pool.parallelFor(0, images.size(), 1, [&](size_t first, size_t last) {
+        std::vector<uint8_t> padded;
+        for (size_t i = first; i < last; ++i)
+        {
+            const Image &image = images[i];
+            const int width = roundUp(image.width + 2 * m_nGutter, m_nAlignment);
+            const int height = roundUp(image.height + 2 * m_nGutter, m_nAlignment);
+            padded.resize(size_t(width) * height * 4);
+            for (int y = 0; y < height; ++y)
+            {
+                // the gutter repeats the edge texels
+                const int sy = std::min(std::max(y - m_nGutter, 0), image.height - 1);
+                for (int x = 0; x < width; ++x)
+                {
+                    const int sx = std::min(std::max(x - m_nGutter, 0), image.width - 1);
+                    const uint8_t *texel =
+                        image.pixels + (size_t(sy) * image.width + sx) * image.channels;
+                    uint8_t *rgba = padded.data() + (size_t(y) * width + x) * 4;
+                    rgba[0] = texel[0];
+                    rgba[1] = image.channels >= 3 ? texel[1] : texel[0];
+                    rgba[2] = image.channels >= 3 ? texel[2] : texel[0];
+                    rgba[3] = image.channels == 4   ? texel[3]
+                              : image.channels == 2 ? texel[1]
+                                                    : 255;
+                }
+            }
+            chains[i] = cookMipChain(padded.data(), width, height, 4, m_bSrgb, m_Pool, m_nLevels);
+        }
+    });
+
+    std::vector<uint32_t> indices(images.size());
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const Placement &placement = placements[i];
+        GLTexture &texture = m_Pages[placement.page]->texture;
+        for (size_t level = 0; level < chains[i].levels.size(); ++level)
+        {
+            const CookedLevel &cooked = chains[i].levels[level];
+            texture.subImage2D(GLint(level), placement.x >> level, placement.y >> level,
+                               cooked.width, cooked.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                               chains[i].data.data() + cooked.offset);
+        }
+
+        AtlasRegion region;
+        region.page = placement.page;
+        region.x = placement.x + m_nGutter;
+        region.y = placement.y + m_nGutter;
+        region.width = images[i].width;
+        region.height = images[i].height;
+        const float texel = 1.f / float(m_nPageSize);
+        region.uvScaleOffset = glm::vec4(region.width * texel, region.height * texel,
+                                         region.x * texel, region.y * texel);
+        indices[i] = uint32_t(m_Regions.size());
+        m_Regions.push_back(region);
+    }
+
+    m_Stats.pages = m_Pages.size();
+    m_Stats.regions = m_Regions.size();
+    m_Stats.fill = float(double(m_Stats.packedTexels) /
+                         (double(m_Pages.size()) * m_nPageSize * m_nPageSize));
+    m_Stats.lastInsertMicroseconds = std::chrono::duration<float, std::micro>(
+                                         std::chrono::high_resolution_clock::now() - start)
+                                         .count();
+    return indices;
+}
+
+uint32_t TextureAtlas::add(const uint8_t *pixels, int width, int height, int channels)
+{
+    return add(std::vector<Image>{{pixels, width, height, channels}}).front();
+}
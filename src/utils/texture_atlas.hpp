@@ -0,0 +1,91 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "thread_pool.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Where an image ended up in a TextureAtlas.
+struct AtlasRegion
+{
+    uint32_t page = 0;
+    int x = 0, y = 0, width = 0, height = 0; // texels of the image in the page, gutter excluded
+    glm::vec4 uvScaleOffset = glm::vec4(1.f, 1.f, 0.f, 0.f); // page uv = uv * xy + zw
+};
+
+struct TextureAtlasStats
+{
+    size_t pages = 0;
+    size_t regions = 0;
+    size_t packedTexels = 0; // gutters included
+    float fill = 0.f;        // packed texels over the texels of all the pages
+    float lastInsertMicroseconds = 0.f;
+};
+
+// Packs many small images in a few large textures, the pages, with stb_rect_pack, so the draws
+// using them can share a texture binding. Images are added at any time: each page keeps its
+// skyline packer, new images go to the first page with room and a new page is created when
+// none has any. Only the rectangles of the new images are uploaded.
+// Every image is surrounded by a gutter of its edge texels repeated, and its rectangle is
+// aligned on the texels of the last mip level the gutter keeps clean: the pages have
+// log2(gutter) + 1 levels, computed per image with cookMipChain(), so neither filtering nor
+// mipmapping mixes neighbouring images.
+// The regions are the UV remap table: a texture coordinate of an image maps to its page with
+// the region's scale and offset.
+class TextureAtlas
+{
+public:
+    struct Image
+    {
+        const uint8_t *pixels;
+        int width, height;
+        int channels; // grey and grey alpha are expanded like the GL_RED and GL_RG swizzles
+    };
+
+    // pageSize is a power of two, srgb for color images.
+    explicit TextureAtlas(int pageSize = 2048, int gutter = 4, bool srgb = false,
+                          ThreadPool &pool = ThreadPool::global());
+    ~TextureAtlas();
+
+    TextureAtlas(const TextureAtlas &) = delete;
+    TextureAtlas &operator=(const TextureAtlas &) = delete;
+
+    // Packs and uploads images, returns the region index of each. Packing a batch at once
+    // fills pages better than one image at a time. Throws if an image can't fit in a page.
+    std::vector<uint32_t> add(const std::vector<Image> &images);
+    uint32_t add(const uint8_t *pixels, int width, int height, int channels);
+
+    const AtlasRegion &region(uint32_t index) const { return m_Regions[index]; }
+    const std::vector<AtlasRegion> &regions() const { return m_Regions; }
+    static glm::vec2 remap(const AtlasRegion &region, const glm::vec2 &uv)
+    {
+        return uv * glm::vec2(region.uvScaleOffset) +
+               glm::vec2(region.uvScaleOffset.z, region.uvScaleOffset.w);
+    }
+
+    size_t pageCount() const { return m_Pages.size(); }
+    const GLTexture &page(size_t index) const;
+    int pageSize() const { return m_nPageSize; }
+    GLsizei levels() const { return m_nLevels; }
+    const TextureAtlasStats &stats() const { return m_Stats; }
+
+private:
+    struct Page;
+
+    Page &createPage();
+
+    ThreadPool &m_Pool;
+    int m_nPageSize;
+    int m_nGutter;
+    bool m_bSrgb;
+    GLsizei m_nLevels;
+    int m_nAlignment; // packing unit of the rectangles, a texel of the last level
+    std::vector<std::unique_ptr<Page>> m_Pages;
+    std::vector<AtlasRegion> m_Regions;
+    TextureAtlasStats m_Stats;
+};
@@ -0,0 +1,349 @@
+#include "texture_cooker.hpp"
+#include "texture_format.hpp"
+
+// stb_dxt calls memcpy without including string.h itself
+#include <cstring>
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+#include <stb_image_resize.h>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+const char COOKED_TEXTURE_MAGIC[4] = {'T', 'T', 'E', 'X'};
+// version 2 stores the channel count, for uncompressed mip chains
+const uint32_t COOKED_TEXTURE_VERSION = 2;
+// block rows compressed by one job
+const size_t COMPRESSION_GRAIN = 4;
+// rows of a mip level resampled by one job
+const int RESAMPLE_BAND = 32;
+
+struct CookedTextureHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t internalFormat;
+    uint32_t channels;
+    uint32_t levelCount;
+};
+
+struct CookedLevelHeader
+{
+    uint64_t size;
+    int32_t width, height;
+};
+
+[[noreturn]] void cookError(const std::string &message)
+{
+    std::cerr << message << std::endl;
+    throw std::runtime_error(message);
+}
+
+bool isCompressedFormat(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isSrgbFormat(GLenum internalFormat)
+{
+    return internalFormat == GL_SRGB8 || internalFormat == GL_SRGB8_ALPHA8 ||
+           internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ||
+           internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+}
+// Whether cookMipChain() or cookCompressedTexture() can produce the format.
+bool isCookedFormat(GLenum internalFormat, int channels)
+{
+    if (channels < 1 || channels > 4)
+    {
+        return false;
+    }
+    if (isCompressedFormat(internalFormat))
+    {
+        return channels == 4;
+    }
+    for (const bool srgb : {false, true})
+    {
+        const TextureFormat format = textureFormat(channels, srgb);
+        if (format.internalFormat == internalFormat && format.channels == channels)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+bool CookedTexture::compressed() const
+{
+    return isCompressedFormat(internalFormat);
+}
+
+CookedTexture cookMipChain(const uint8_t *pixels, int width, int height, int channels, bool srgb,
+                           ThreadPool &pool, GLsizei maxLevels)
+{
+    const TextureFormat format = textureFormat(channels, srgb);
+    CookedTexture texture;
+    texture.internalFormat = format.internalFormat;
+    texture.channels = channels;
+    const GLsizei levelCount = maxLevels > 0 ? std::min(maxLevels, mipLevelCount(width, height))
+                                             : mipLevelCount(width, height);
+    for (GLsizei level = 0; level < levelCount; ++level)
+    {
+        CookedLevel cooked;
+        cooked.width = std::max(width >> level, 1);
+        cooked.height = std::max(height >> level, 1);
+        cooked.offset = texture.data.size();
+        cooked.size = size_t(cooked.width) * cooked.height * channels;
+        texture.levels.push_back(cooked);
+        texture.data.resize(texture.data.size() + cooked.size);
+    }
+    std::memcpy(texture.data.data(), pixels, texture.levels.front().size);
+
+    // sRGB alpha stays linear, grey alpha keeps it in its second channel
+    const int alphaChannel = channels == 4 ? 3 : channels == 2 ? 1 : STBIR_ALPHA_CHANNEL_NONE;
+    const stbir_colorspace space = srgb ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+    for (size_t level = 1; level < texture.levels.size(); ++level)
+    {
+        const CookedLevel &source = texture.levels[level - 1];
+        const CookedLevel &target = texture.levels[level];
+        const size_t bands = size_t((target.height + RESAMPLE_BAND - 1) / RESAMPLE_BAND);
+        pool.parallelFor(0, bands, 1, [&](size_t first, size_t last) {
+            for (size_t band = first; band < last; ++band)
+            {
+                // the band's rows of the target, resampled from the whole source
+                const int y0 = int(band) * RESAMPLE_BAND;
+                const int y1 = std::min(y0 + RESAMPLE_BAND, target.height);
+                stbir_resize_region(
+                    texture.data.data() + source.offset, source.width, source.height,
+                    source.width * channels,
+                    texture.data.data() + target.offset + size_t(y0) * target.width * channels,
+                    target.width, y1 - y0, target.width * channels, STBIR_TYPE_UINT8, channels,
+                    alphaChannel, 0, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT,
+                    STBIR_FILTER_DEFAULT, space, nullptr, 0.f, float(y0) / target.height, 1.f,
+                    float(y1) / target.height);
+            }
+        });
+    }
+    return texture;
+}
+
+CookedTexture cookCompressedTexture(const uint8_t *rgba, int width, int height, bool srgb,
+                                    ThreadPool &pool)
+{
+    bool opaque = true;
+    for (size_t i = 3; i < size_t(width) * height * 4 && opaque; i += 4)
+    {
+        opaque = rgba[i] == 255;
+    }
+    const size_t blockBytes = opaque ? 8 : 16;
+
+    const CookedTexture chain = cookMipChain(rgba, width, height, 4, srgb, pool);
+    CookedTexture texture;
+    texture.channels = 4;
+    texture.internalFormat =
+        opaque ? (srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+               : (srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+    std::vector<const uint8_t *> pixels;
+    for (const auto &level : chain.levels)
+    {
+        CookedLevel cooked = level;
+        cooked.offset = texture.data.size();
+        cooked.size = textureLevelBytes(texture.internalFormat, level.width, level.height);
+        texture.levels.push_back(cooked);
+        texture.data.resize(texture.data.size() + cooked.size);
+        pixels.push_back(chain.data.data() + level.offset);
+    }
+
+    // every block row of every level is independent
+    std::vector<std::pair<uint32_t, uint32_t>> rows;
+    for (size_t level = 0; level < texture.levels.size(); ++level)
+    {
+        for (int row = 0; row < (texture.levels[level].height + 3) / 4; ++row)
+        {
+            rows.emplace_back(uint32_t(level), uint32_t(row));
+        }
+    }
+    pool.parallelFor(0, rows.size(), COMPRESSION_GRAIN, [&](size_t first, size_t last) {
+        uint8_t block[64];
+        for (size_t r = first; r < last; ++r)
+        {
+            const CookedLevel &level = texture.levels[rows[r].first];
+            const uint8_t *source = pixels[rows[r].first];
+            const int blocksWide = (level.width + 3) / 4;
+            uint8_t *target = texture.data.data() + level.offset +
+                              size_t(rows[r].second) * blocksWide * blockBytes;
+            for (int bx = 0; bx < blocksWide; ++bx)
+            {
+                // edge blocks repeat the last texels
+                for (int y = 0; y < 4; ++y)
+                {
+                    const int sy = std::min(int(rows[r].second) * 4 + y, level.height - 1);
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const int sx = std::min(bx * 4 + x, level.width - 1);
+                        std::memcpy(block + (y * 4 + x) * 4,
+                                    source + (size_t(sy) * level.width + sx) * 4, 4);
+                    }
+                }
+                stb_compress_dxt_block(target, block, opaque ? 0 : 1, STB_DXT_NORMAL);
+                target += blockBytes;
+            }
+        }
+    });
+    return texture;
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool loadCookedTexture(const fs::path &path, uint64_t key, CookedTexture &texture)
+{
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    CookedTextureHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != COOKED_TEXTURE_VERSION || header.key != key || header.levelCount == 0 ||
+        header.levelCount > 32)
+    {
+        return false;
+    }
+
+    CookedTexture loaded;
+    loaded.internalFormat = GLenum(header.internalFormat);
+    loaded.channels = int(header.channels);
+    if (!isCookedFormat(loaded.internalFormat, loaded.channels))
+    {
+        // corrupt, or from a cooker writing other formats
+        return false;
+    }
+    for (uint32_t level = 0; level < header.levelCount; ++level)
+    {
+        CookedLevelHeader levelHeader;
+        if (!in.read(reinterpret_cast<char *>(&levelHeader), sizeof(levelHeader)))
+        {
+            return false;
+        }
+        CookedLevel cooked;
+        cooked.width = levelHeader.width;
+        cooked.height = levelHeader.height;
+        cooked.offset = loaded.data.size();
+        cooked.size = size_t(levelHeader.size);
+        const size_t expected =
+            loaded.compressed()
+                ? textureLevelBytes(loaded.internalFormat, cooked.width, cooked.height)
+                : size_t(cooked.width) * cooked.height * loaded.channels;
+        if (cooked.width <= 0 || cooked.height <= 0 || cooked.size != expected)
+        {
+            // truncated or foreign file, better cooked again than uploaded wrong
+            return false;
+        }
+        loaded.levels.push_back(cooked);
+        loaded.data.resize(loaded.data.size() + cooked.size);
+    }
+    if (!in.read(reinterpret_cast<char *>(loaded.data.data()), std::streamsize(loaded.data.size())))
+    {
+        return false;
+    }
+    texture = std::move(loaded);
+    return true;
+}
+
+void saveCookedTexture(const fs::path &path, uint64_t key, const CookedTexture &texture)
+{
+    // written aside then renamed: a concurrent load never sees half a file
+    const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const std::string temporary = path.string() + "." + std::to_string(thread);
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+        {
+            cookError("Unable to create cooked texture " + temporary);
+        }
+        CookedTextureHeader header;
+        std::memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic));
+        header.version = COOKED_TEXTURE_VERSION;
+        header.key = key;
+        header.internalFormat = uint32_t(texture.internalFormat);
+        header.channels = uint32_t(texture.channels);
+        header.levelCount = uint32_t(texture.levels.size());
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &level : texture.levels)
+        {
+            const CookedLevelHeader levelHeader = {uint64_t(level.size), int32_t(level.width),
+                                                   int32_t(level.height)};
+            out.write(reinterpret_cast<const char *>(&levelHeader), sizeof(levelHeader));
+        }
+        out.write(reinterpret_cast<const char *>(texture.data.data()),
+                  std::streamsize(texture.data.size()));
+        if (!out)
+        {
+            cookError("Unable to write cooked texture " + temporary);
+        }
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error)
+    {
+        fs::remove(temporary, error);
+        cookError("Unable to write cooked texture " + path.string());
+    }
+}
+
+GLTexture createCookedTexture(const CookedTexture &texture, const uint8_t *data)
+{
+    const CookedLevel &base = texture.levels.front();
+    if (!texture.compressed())
+    {
+        // same choice as the cooking, swizzle included
+        const TextureFormat format =
+            textureFormat(texture.channels, isSrgbFormat(texture.internalFormat));
+        GLTexture target =
+            createTexture2D(format, base.width, base.height, GLsizei(texture.levels.size()));
+        for (size_t level = 0; level < texture.levels.size(); ++level)
+        {
+            const CookedLevel &cooked = texture.levels[level];
+            uploadTexture2D(target, format, GLint(level), cooked.width, cooked.height,
+                            data + cooked.offset);
+        }
+        return target;
+    }
+    GLTexture target(GL_TEXTURE_2D);
+    target.storage2D(GLsizei(texture.levels.size()), texture.internalFormat, base.width,
+                     base.height);
+    for (size_t level = 0; level < texture.levels.size(); ++level)
+    {
+        const CookedLevel &cooked = texture.levels[level];
+        target.compressedSubImage2D(GLint(level), 0, 0, cooked.width, cooked.height,
+                                    texture.internalFormat, GLsizei(cooked.size),
+                                    data + cooked.offset);
+    }
+    return target;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gl_objects.hpp"
+#include "thread_pool.hpp"
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One mip level of a CookedTexture, a range of its data.
+struct CookedLevel
+{
+    int width = 0, height = 0;
+    size_t offset = 0, size = 0;
+};
+
+// Texture ready for upload: the data of every level of its mip chain, in the GPU format.
+struct CookedTexture
+{
+    GLenum internalFormat = GL_NONE;
+    int channels = 0; // of the pixels, before compression for compressed levels
+    std::vector<CookedLevel> levels;
+    std::vector<uint8_t> data;
+
+    bool empty() const { return levels.empty(); }
+    bool compressed() const;
+};
+
+// Full mip chain of an image of channels 8 bit channels, in the format textureFormat() picks,
+// an alternative to glGenerateMipmap whose quality and cost depend on the driver. Levels are
+// resampled with stb_image_resize: sRGB color is filtered in linear space, and filter weights
+// are scaled by alpha, which is filtering premultiplied colors, so transparent texels don't
+// bleed into their neighbours. Each level is computed from the previous one in bands of rows
+// spread over the pool. maxLevels limits the chain, 0 for all the levels.
+CookedTexture cookMipChain(const uint8_t *pixels, int width, int height, int channels, bool srgb,
+                           ThreadPool &pool = ThreadPool::global(), GLsizei maxLevels = 0);
+
+// Block compresses an RGBA image and its mip chain with stb_dxt: BC1 when every texel is
+// opaque, BC3 otherwise, with the sRGB variants for color. The chain comes from
+// cookMipChain(), then the block rows of all the levels are compressed in parallel on the pool.
+CookedTexture cookCompressedTexture(const uint8_t *rgba, int width, int height, bool srgb,
+                                    ThreadPool &pool = ThreadPool::global());
+
+// 64 bit FNV-1a, chained through seed. Cooked textures are keyed by the hash of their encoded
+// source and of the options changing the result.
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+// Binary cache of a cooked texture: "TTEX" magic, version, key, internal format, channel
+// count and level count, then per level its size and dimensions, then the data of every
+// level. Loading returns false for a missing file, another key or version (older files
+// included) or a truncated file: the caller cooks again.
+bool loadCookedTexture(const fs::path &path, uint64_t key, CookedTexture &texture);
+void saveCookedTexture(const fs::path &path, uint64_t key, const CookedTexture &texture);
+
+// Immutable texture with the storage of a cooked texture, every level uploaded from data: the
+// texture's own data, or an offset in the bound GL_PIXEL_UNPACK_BUFFER.
+GLTexture createCookedTexture(const CookedTexture &texture, const uint8_t *data);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Storage of an image with 8 bit channels, and how its pixels are handed to GL.
+struct TextureFormat
+{
+    GLenum internalFormat = GL_RGBA8;
+    GLenum pixelFormat = GL_RGBA;
+    int channels = 4; // of the uploaded pixels, more than the image has for grey alpha sRGB
+    bool grey = false; // red is replicated to green and blue when sampling
+};
+
+// Tightest format for an image of channels channels, color in sRGB or linear data. Core GL
+// has no sRGB format with less than three channels: a grey sRGB image is read from its
+// single channel into SRGB8, a grey alpha one has to be expanded to four channels.
+inline TextureFormat textureFormat(int channels, bool srgb)
+{
+    TextureFormat format;
+    switch (channels)
+    {
+    case 1:
+        format = {srgb ? GLenum(GL_SRGB8) : GLenum(GL_R8), GL_RED, 1, true};
+        break;
+    case 2:
+        format = srgb ? TextureFormat{GL_SRGB8_ALPHA8, GL_RGBA, 4, false}
+                      : TextureFormat{GL_RG8, GL_RG, 2, true};
+        break;
+    case 3:
+        format = {srgb ? GLenum(GL_SRGB8) : GLenum(GL_RGB8), GL_RGB, 3, false};
+        break;
+    default:
+        format = {srgb ? GLenum(GL_SRGB8_ALPHA8) : GLenum(GL_RGBA8), GL_RGBA, 4, false};
+        break;
+    }
+    return format;
+}
+
+// Largest GL_UNPACK_ALIGNMENT rows of rowBytes bytes satisfy, decoded rows are packed.
+inline GLint unpackAlignment(size_t rowBytes)
+{
+    return rowBytes % 8 == 0 ? 8 : rowBytes % 4 == 0 ? 4 : rowBytes % 2 == 0 ? 2 : 1;
+}
+
+// Immutable 2D texture with storage for levels levels, levels 0 for a full mip chain.
+inline GLTexture createTexture2D(const TextureFormat &format, GLsizei width, GLsizei height,
+                                 GLsizei levels = 0)
+{
+    GLTexture texture(GL_TEXTURE_2D);
+    texture.storage2D(levels > 0 ? levels : mipLevelCount(width, height), format.internalFormat,
+                      width, height);
+    if (format.grey)
+    {
+        const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, format.channels == 2 ? GL_GREEN : GL_ONE};
+        glTextureParameteriv(texture.glId(), GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    return texture;
+}
+
+// Uploads one level from tightly packed pixels of the format, from client memory or from an
+// offset in the bound GL_PIXEL_UNPACK_BUFFER.
+inline void uploadTexture2D(GLTexture &texture, const TextureFormat &format, GLint level,
+                            GLsizei width, GLsizei height, const void *pixels)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment(size_t(width) * size_t(format.channels)));
+    texture.subImage2D(level, 0, 0, width, height, format.pixelFormat, GL_UNSIGNED_BYTE, pixels);
+    // back to the GL default the rest of the code assumes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
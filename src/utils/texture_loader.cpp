@@ -0,0 +1,479 @@
+#include "texture_loader.hpp"
+#include "texture_cooker.hpp"
+#include "texture_format.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+const GLsizeiptr STAGING_ALIGNMENT = 16;
+
+bool usesMipmaps(GLenum minFilter)
+{
+    return minFilter != GL_NEAREST && minFilter != GL_LINEAR;
+}
+} // namespace
+
+struct TextureLoader::Shared
+{
+    std::mutex mutex;
+    std::condition_variable decodedAvailable;
+    std::deque<Decoded> decoded;
+    size_t decoding = 0;
+};
+
+TextureLoader::TextureLoader(ThreadPool &pool, GLsizeiptr stagingSize)
+    : m_Pool(pool), m_Shared(std::make_shared<Shared>()), m_nStagingSize(stagingSize)
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    m_Staging.storage(stagingSize, nullptr, flags);
+    m_pStaging = static_cast<uint8_t *>(m_Staging.map(0, stagingSize, flags));
+    if (!m_pStaging)
+    {
+        std::cerr << "TextureLoader: unable to map the staging buffer" << std::endl;
+        throw std::runtime_error("Unable to map texture staging buffer");
+    }
+
+    // grey checkerboard, visibly not the texture but not distracting either
+    const uint8_t checker[16] = {160, 160, 160, 255, 96, 96, 96, 255,
+                                 96, 96, 96, 255, 160, 160, 160, 255};
+    m_Placeholder = GLTexture(GL_TEXTURE_2D);
+    m_Placeholder.storage2D(1, GL_RGBA8, 2, 2);
+    m_Placeholder.subImage2D(0, 0, 0, 2, 2, GL_RGBA, GL_UNSIGNED_BYTE, checker);
+    m_Placeholder.setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    m_Placeholder.setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+TextureLoader::~TextureLoader()
+{
+    // jobs may read caller memory given to load(), they have to be done before returning
+    {
+        std::unique_lock<std::mutex> lock(m_Shared->mutex);
+        m_Shared->decodedAvailable.wait(lock, [this]() { return m_Shared->decoding == 0; });
+    }
+    for (const auto &upload : m_Uploads)
+    {
+        glDeleteSync(upload.fence);
+    }
+    m_Staging.unmap();
+}
+
+TextureRequest TextureLoader::load(const fs::path &path, const TextureLoadOptions &options)
+{
+    const std::string file = path.string();
+    return enqueue(options, file, [file](std::vector<uint8_t> &storage) {
+        // read whole, the encoded bytes are hashed for the cache before decoding
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        if (in)
+        {
+            storage.resize(size_t(in.tellg()));
+            in.seekg(0);
+            in.read(reinterpret_cast<char *>(storage.data()), std::streamsize(storage.size()));
+        }
+        if (!in)
+        {
+            storage.clear();
+        }
+        return std::make_pair(static_cast<const uint8_t *>(storage.data()), storage.size());
+    });
+}
+
+TextureRequest TextureLoader::load(const uint8_t *data, size_t size,
+                                   const TextureLoadOptions &options)
+{
+    return enqueue(options, "image in memory", [data, size](std::vector<uint8_t> &) {
+        return std::make_pair(data, size);
+    });
+}
+
+TextureRequest TextureLoader::load(std::vector<uint8_t> encoded, const TextureLoadOptions &options)
+{
+    auto owned = std::make_shared<std::vector<uint8_t>>(std::move(encoded));
+    return enqueue(options, "image in memory", [owned](std::vector<uint8_t> &) {
+        return std::make_pair(static_cast<const uint8_t *>(owned->data()), owned->size());
+    });
+}
+
+void TextureLoader::setCacheDirectory(const fs::path &directory)
+{
+    m_CacheDirectory = directory;
+    std::error_code error;
+    if (!directory.empty() && !fs::create_directories(directory, error) && error)
+    {
+        std::cerr << "TextureLoader: unable to create " << directory.string()
+                  << ", textures are cooked on every load" << std::endl;
+        m_CacheDirectory.clear();
+    }
+}
+
+void TextureLoader::decode(const uint8_t *data, size_t size, const Job &job, Decoded &decoded)
+{
+    const TextureLoadOptions &options = job.options;
+    int channels = 0;
+    int desired = 0;
+    if (stbi_info_from_memory(data, int(size), &decoded.width, &decoded.height, &channels))
+    {
+        desired = options.compress ? 4 : textureFormat(channels, options.srgb).channels;
+    }
+    const bool cook = options.compress || (options.cpuMipmaps && usesMipmaps(options.minFilter));
+    if (!cook)
+    {
+        decoded.pixels.reset(stbi_load_from_memory(data, int(size), &decoded.width,
+                                                   &decoded.height, &channels, desired));
+        decoded.channels = desired ? desired : channels;
+        return;
+    }
+
+    // the result depends on the source, the orientation, the color space and compression
+    const uint8_t flags[3] = {uint8_t(options.flipVertically), uint8_t(options.srgb),
+                              uint8_t(options.compress)};
+    const uint64_t key = hashBytes(flags, sizeof(flags), hashBytes(data, size));
+    fs::path cached;
+    if (!job.cacheDirectory.empty())
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.ttex", static_cast<unsigned long long>(key));
+        cached = job.cacheDirectory / name;
+        if (loadCookedTexture(cached, key, decoded.cooked))
+        {
+            decoded.cacheHit = true;
+            return;
+        }
+    }
+
+    std::unique_ptr<uint8_t, void (*)(void *)> pixels(
+        stbi_load_from_memory(data, int(size), &decoded.width, &decoded.height, &channels,
+                              desired),
+        stbi_image_free);
+    if (!pixels)
+    {
+        return;
+    }
+    decoded.channels = desired ? desired : channels;
+    decoded.cooked = options.compress
+                         ? cookCompressedTexture(pixels.get(), decoded.width, decoded.height,
+                                                 options.srgb, job.pool)
+                         : cookMipChain(pixels.get(), decoded.width, decoded.height,
+                                        decoded.channels, options.srgb, job.pool);
+    if (!cached.empty())
+    {
+        try
+        {
+            saveCookedTexture(cached, key, decoded.cooked);
+        }
+        catch (const std::runtime_error &)
+        {
+            // already reported, the texture itself is fine
+        }
+    }
+}
+
+TextureRequest TextureLoader::enqueue(TextureLoadOptions options, const std::string &name,
+                                      std::function<Source(std::vector<uint8_t> &)> source)
+{
+    const TextureRequest request = TextureRequest(m_Requests.size());
+    if (options.compress && !(GLAD_GL_EXT_texture_compression_s3tc &&
+                              (!options.srgb || GLAD_GL_EXT_texture_sRGB)))
+    {
+        options.compress = false;
+    }
+    m_Requests.emplace_back();
+    m_Requests.back().options = options;
+    {
+        std::lock_guard<std::mutex> lock(m_Shared->mutex);
+        ++m_Shared->decoding;
+    }
+
+    const Job job = {options, m_CacheDirectory, m_Pool};
+    std::shared_ptr<Shared> shared = m_Shared;
+    m_Pool.enqueue([shared, request, job, name, source]() {
+        Decoded decoded;
+        decoded.request = request;
+        decoded.pixels = std::unique_ptr<uint8_t, void (*)(void *)>(nullptr, stbi_image_free);
+        // the flip flag is per thread, workers serve requests with either orientation
+        stbi_set_flip_vertically_on_load_thread(job.options.flipVertically ? 1 : 0);
+        std::vector<uint8_t> storage;
+        const Source bytes = source(storage);
+        if (bytes.second > 0)
+        {
+            decode(bytes.first, bytes.second, job, decoded);
+        }
+        if (!decoded.pixels && decoded.cooked.empty())
+        {
+            std::cerr << "TextureLoader: unable to decode " << name << ": "
+                      << (bytes.second > 0 ? stbi_failure_reason() : "unreadable") << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->decoded.push_back(std::move(decoded));
+        --shared->decoding;
+        shared->decodedAvailable.notify_all();
+    });
+    return request;
+}
+
+void TextureLoader::update(GLStateCache &state, size_t uploadBudget)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    retireUploads(false);
+    {
+        std::lock_guard<std::mutex> lock(m_Shared->mutex);
+        for (auto &decoded : m_Shared->decoded)
+        {
+            if (decoded.pixels || !decoded.cooked.empty())
+            {
+                m_Stats.compressed += decoded.cooked.compressed() ? 1 : 0;
+                m_Stats.cpuMipmapped += decoded.cooked.empty() ? 0 : 1;
+                m_Stats.cacheHits += decoded.cacheHit ? 1 : 0;
+                m_Requests[decoded.request].state = State::Waiting;
+                m_Waiting.push_back(std::move(decoded));
+            }
+            else
+            {
+                m_Requests[decoded.request].state = State::Failed;
+            }
+        }
+        m_Shared->decoded.clear();
+    }
+
+    // in request order; the first upload of a frame always goes, whatever its size
+    size_t uploaded = 0;
+    while (!m_Waiting.empty())
+    {
+        Decoded &decoded = m_Waiting.front();
+        const GLsizeiptr size = stagingBytes(decoded);
+        if (uploaded > 0 && uploaded + size_t(size) > uploadBudget)
+        {
+            break;
+        }
+        if (m_nMemoryBudget > 0 && GLTexture::allocatedBytes() + storageBytes(decoded) >
+                                         m_nMemoryBudget)
+        {
+            // stays waiting until textures are released or the budget is raised
+            break;
+        }
+        if (size > m_nStagingSize)
+        {
+            upload(state, decoded, -1);
+        }
+        else
+        {
+            const GLsizeiptr offset = allocateStaging(size);
+            if (offset < 0)
+            {
+                break;
+            }
+            upload(state, decoded, offset);
+        }
+        uploaded += size_t(size);
+        m_Waiting.pop_front();
+    }
+    if (uploaded > 0)
+    {
+        // the rest of the frame uploads from client memory
+        state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    m_Stats.requested = m_Requests.size();
+    m_Stats.residentBytes = 0;
+    m_Stats.decoding = m_Stats.waiting = m_Stats.uploading = 0;
+    m_Stats.resident = m_Stats.failed = 0;
+    for (const auto &request : m_Requests)
+    {
+        switch (request.state)
+        {
+        case State::Decoding:
+            ++m_Stats.decoding;
+            break;
+        case State::Waiting:
+            ++m_Stats.waiting;
+            break;
+        case State::Uploading:
+            ++m_Stats.uploading;
+            break;
+        case State::Resident:
+            ++m_Stats.resident;
+            m_Stats.residentBytes += request.texture.storageBytes();
+            break;
+        case State::Failed:
+            ++m_Stats.failed;
+            break;
+        }
+    }
+    m_Stats.lastUpdateMicroseconds = std::chrono::duration<float, std::micro>(
+                                         std::chrono::high_resolution_clock::now() - start)
+                                         .count();
+}
+
+void TextureLoader::finish(GLStateCache &state)
+{
+    while (true)
+    {
+        update(state, std::numeric_limits<size_t>::max());
+        const bool uploaded = !m_Uploads.empty();
+        retireUploads(true);
+        if (!m_Waiting.empty())
+        {
+            // nothing uploaded with an empty ring: the rest is over the memory budget
+            if (uploaded)
+            {
+                continue;
+            }
+            break;
+        }
+        std::unique_lock<std::mutex> lock(m_Shared->mutex);
+        if (m_Shared->decoding == 0 && m_Shared->decoded.empty())
+        {
+            break;
+        }
+        m_Shared->decodedAvailable.wait(
+            lock, [this]() { return !m_Shared->decoded.empty() || m_Shared->decoding == 0; });
+    }
+    update(state, 0);
+}
+
+bool TextureLoader::resident(TextureRequest request) const
+{
+    return request < m_Requests.size() && m_Requests[request].state == State::Resident;
+}
+
+bool TextureLoader::failed(TextureRequest request) const
+{
+    return request < m_Requests.size() && m_Requests[request].state == State::Failed;
+}
+
+const GLTexture &TextureLoader::glTexture(TextureRequest request) const
+{
+    return resident(request) ? m_Requests[request].texture : m_Placeholder;
+}
+
+GLsizeiptr TextureLoader::stagingBytes(const Decoded &decoded)
+{
+    return decoded.cooked.empty()
+               ? GLsizeiptr(decoded.width) * decoded.height * decoded.channels
+               : GLsizeiptr(decoded.cooked.data.size());
+}
+
+size_t TextureLoader::storageBytes(const Decoded &decoded) const
+{
+    if (!decoded.cooked.empty())
+    {
+        return decoded.cooked.data.size();
+    }
+    const TextureLoadOptions &options = m_Requests[decoded.request].options;
+    const TextureFormat format = textureFormat(decoded.channels, options.srgb);
+    const GLsizei levels =
+        usesMipmaps(options.minFilter) ? mipLevelCount(decoded.width, decoded.height) : 1;
+    size_t bytes = 0;
+    for (GLsizei level = 0; level < levels; ++level)
+    {
+        bytes += textureLevelBytes(format.internalFormat, std::max(decoded.width >> level, 1),
+                                   std::max(decoded.height >> level, 1));
+    }
+    return bytes;
+}
+
+void TextureLoader::retireUploads(bool wait)
+{
+    while (!m_Uploads.empty())
+    {
+        const Upload &upload = m_Uploads.front();
+        GLenum status = glClientWaitSync(upload.fence, 0, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            // later uploads were fenced after this one
+            return;
+        }
+        glDeleteSync(upload.fence);
+        m_Requests[upload.request].state = State::Resident;
+        m_Uploads.pop_front();
+    }
+    m_nStagingHead = 0;
+}
+
+GLsizeiptr TextureLoader::allocateStaging(GLsizeiptr size) const
+{
+    const GLsizeiptr head = (m_nStagingHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT *
+                            STAGING_ALIGNMENT;
+    if (m_Uploads.empty())
+    {
+        return size <= m_nStagingSize ? 0 : -1;
+    }
+    // slices in use are [tail, head), wrapped around the end of the buffer or not
+    const GLsizeiptr tail = m_Uploads.front().offset;
+    if (m_nStagingHead > tail || (m_nStagingHead == tail && m_Uploads.front().size == 0))
+    {
+        if (head + size <= m_nStagingSize)
+        {
+            return head;
+        }
+        return size < tail ? 0 : -1;
+    }
+    return head + size < tail ? head : -1;
+}
+
+void TextureLoader::upload(GLStateCache &state, Decoded &decoded, GLsizeiptr stagingOffset)
+{
+    Request &request = m_Requests[decoded.request];
+    const TextureLoadOptions &options = request.options;
+    const GLsizeiptr size = stagingBytes(decoded);
+    const uint8_t *source =
+        decoded.cooked.empty() ? decoded.pixels.get() : decoded.cooked.data.data();
+    const uint8_t *pixels = source;
+    if (stagingOffset >= 0)
+    {
+        std::memcpy(m_pStaging + stagingOffset, source, size_t(size));
+        state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Staging.glId());
+        pixels = reinterpret_cast<const uint8_t *>(stagingOffset);
+        m_nStagingHead = stagingOffset + size;
+    }
+    else
+    {
+        // larger than the whole ring: the driver copies the pixels before returning
+        state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        ++m_Stats.directUploads;
+    }
+
+    if (!decoded.cooked.empty())
+    {
+        // every level is in the cooked data
+        request.texture = createCookedTexture(decoded.cooked, pixels);
+    }
+    else
+    {
+        const TextureFormat format = textureFormat(decoded.channels, options.srgb);
+        request.texture = createTexture2D(format, decoded.width, decoded.height,
+                                          usesMipmaps(options.minFilter) ? 0 : 1);
+        uploadTexture2D(request.texture, format, 0, decoded.width, decoded.height, pixels);
+        if (request.texture.levels() > 1)
+        {
+            request.texture.generateMipmap();
+        }
+    }
+    GLTexture &texture = request.texture;
+    texture.setParameter(GL_TEXTURE_MIN_FILTER, GLint(options.minFilter));
+    texture.setParameter(GL_TEXTURE_MAG_FILTER, GLint(options.magFilter));
+    texture.setParameter(GL_TEXTURE_WRAP_S, GLint(options.wrapS));
+    texture.setParameter(GL_TEXTURE_WRAP_T, GLint(options.wrapT));
+
+    request.state = State::Uploading;
+    m_Stats.uploadedBytes += size_t(size);
+    // a direct upload holds no staging, an empty slice at the head keeps the ring consistent
+    m_Uploads.push_back(Upload{decoded.request, stagingOffset >= 0 ? stagingOffset : m_nStagingHead,
+                               stagingOffset >= 0 ? size : 0,
+                               glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gl_objects.hpp"
+#include "gl_state.hpp"
+#include "texture_cooker.hpp"
+#include "thread_pool.hpp"
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Handle of a texture requested from a TextureLoader.
+using TextureRequest = uint32_t;
+const TextureRequest NO_TEXTURE_REQUEST = ~0u;
+
+struct TextureLoadOptions
+{
+    bool flipVertically = true; // first row at the bottom, as GL texture coordinates expect
+    bool srgb = false;          // color data, filtered in linear space
+    // block compressed with every mip level cooked on the workers, when the GL supports it
+    bool compress = false;
+    // mip chain computed by the workers, see cookMipChain(), rather than glGenerateMipmap
+    bool cpuMipmaps = true;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+};
+
+struct TextureLoaderStats
+{
+    size_t requested = 0;
+    size_t decoding = 0;  // queued or being decoded by the workers
+    size_t waiting = 0;   // decoded, waiting for staging space or upload budget
+    size_t uploading = 0; // uploaded, fence not signaled yet
+    size_t resident = 0;
+    size_t failed = 0;
+    size_t uploadedBytes = 0;
+    size_t residentBytes = 0; // GPU storage of the resident textures, mips included
+    size_t directUploads = 0; // images larger than the staging buffer, copied by the driver
+    size_t compressed = 0;
+    size_t cpuMipmapped = 0; // mip chains cooked or read from the cache, compressed included
+    size_t cacheHits = 0;    // cooked textures read from the cache instead of cooked again
+    float lastUpdateMicroseconds = 0.f;
+};
+
+// Loads textures without blocking the GL thread. Images are decoded with stb_image by the
+// jobs of a thread pool; update(), called once per frame on the GL thread, copies decoded
+// pixels into a persistently mapped pixel unpack buffer and uploads the texture from it, so
+// the driver reads the pixels asynchronously. The staging buffer is a ring: each upload keeps
+// its slice until the fence placed after it signals, then the texture becomes resident and
+// texture() returns it. Until then texture() returns a checkerboard placeholder, nothing
+// ever waits on a decode or on the GPU.
+// Mip chains and compressed textures are cooked by the same jobs (see texture_cooker.hpp),
+// then uploaded level by level. With a cache directory they are stored there keyed by the
+// hash of their encoded source: later loads read the cooked levels back instead of decoding
+// and cooking again.
+class TextureLoader
+{
+public:
+    explicit TextureLoader(ThreadPool &pool = ThreadPool::global(),
+                           GLsizeiptr stagingSize = 32 << 20);
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+
+    TextureRequest load(const fs::path &path, const TextureLoadOptions &options = {});
+    // Encoded image in memory, which must stay valid until the texture is resident or failed.
+    TextureRequest load(const uint8_t *data, size_t size, const TextureLoadOptions &options = {});
+    // Encoded image owned by the loader until decoded.
+    TextureRequest load(std::vector<uint8_t> encoded, const TextureLoadOptions &options = {});
+
+    // Where cooked textures are kept, created if needed; empty, the default, cooks every time.
+    // Applies to the requests made after the call.
+    void setCacheDirectory(const fs::path &directory);
+
+    // Retires finished uploads and starts new ones for at most uploadBudget bytes, GL thread.
+    // The staging buffer is bound to GL_PIXEL_UNPACK_BUFFER through state, and unbound after.
+    void update(GLStateCache &state, size_t uploadBudget = 16 << 20);
+    // Uploads everything requested so far and waits for it, for loading screens and tools.
+    void finish(GLStateCache &state);
+    // Decoded images wait rather than being uploaded while GLTexture::allocatedBytes() would
+    // exceed the budget. 0, the default, is no budget.
+    void setMemoryBudget(size_t bytes) { m_nMemoryBudget = bytes; }
+    size_t memoryBudget() const { return m_nMemoryBudget; }
+
+    bool resident(TextureRequest request) const;
+    bool failed(TextureRequest request) const;
+    // The texture once resident, the placeholder before and when loading failed.
+    const GLTexture &glTexture(TextureRequest request) const;
+    GLuint texture(TextureRequest request) const { return glTexture(request).glId(); }
+    GLuint placeholder() const { return m_Placeholder.glId(); }
+    const TextureLoaderStats &stats() const { return m_Stats; }
+
+private:
+    enum class State
+    {
+        Decoding,
+        Waiting,
+        Uploading,
+        Resident,
+        Failed
+    };
+
+    struct Request
+    {
+        State state = State::Decoding;
+        TextureLoadOptions options;
+        GLTexture texture;
+    };
+
+    // written by the workers, read by the GL thread
+    struct Decoded
+    {
+        TextureRequest request = NO_TEXTURE_REQUEST;
+        int width = 0, height = 0, channels = 0;
+        std::unique_ptr<uint8_t, void (*)(void *)> pixels{nullptr, nullptr};
+        CookedTexture cooked; // instead of pixels for compressed textures
+        bool cacheHit = false;
+    };
+    // what a decode job needs to know, copied at request time
+    struct Job
+    {
+        TextureLoadOptions options;
+        fs::path cacheDirectory;
+        ThreadPool &pool;
+    };
+    // encoded bytes of a request, read by the job
+    using Source = std::pair<const uint8_t *, size_t>;
+    struct Shared;
+
+    struct Upload
+    {
+        TextureRequest request;
+        GLsizeiptr offset; // staging slice, released when the fence signals
+        GLsizeiptr size;
+        GLsync fence;
+    };
+
+    TextureRequest enqueue(TextureLoadOptions options, const std::string &name,
+                           std::function<Source(std::vector<uint8_t> &storage)> source);
+    // channels of the decoded pixels are the ones of the texture format, see textureFormat()
+    static void decode(const uint8_t *data, size_t size, const Job &job, Decoded &decoded);
+    static GLsizeiptr stagingBytes(const Decoded &decoded);
+    size_t storageBytes(const Decoded &decoded) const;
+    void retireUploads(bool wait);
+    // -1 when the ring has no room for size bytes until older uploads retire
+    GLsizeiptr allocateStaging(GLsizeiptr size) const;
+    void upload(GLStateCache &state, Decoded &decoded, GLsizeiptr stagingOffset);
+
+    ThreadPool &m_Pool;
+    std::shared_ptr<Shared> m_Shared; // outlives the loader while jobs still run
+    std::vector<Request> m_Requests;
+    std::deque<Decoded> m_Waiting;
+    std::deque<Upload> m_Uploads;
+    GLBuffer m_Staging;
+    uint8_t *m_pStaging = nullptr;
+    GLsizeiptr m_nStagingSize;
+    GLsizeiptr m_nStagingHead = 0;
+    size_t m_nMemoryBudget = 0;
+    fs::path m_CacheDirectory;
+    GLTexture m_Placeholder;
+    TextureLoaderStats m_Stats;
+};
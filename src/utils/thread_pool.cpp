@@ -0,0 +1,111 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        const size_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        m_Threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStopping = true;
+    }
+    m_JobAvailable.notify_all();
+    for (auto &thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push(std::move(job));
+    }
+    m_JobAvailable.notify_one();
+}
+
+void ThreadPool::work()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_JobAvailable.wait(lock, [this]() { return m_bStopping || !m_Jobs.empty(); });
+            if (m_Jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop();
+        }
+        job();
+    }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grainSize,
+                             const std::function<void(size_t, size_t)> &body)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+    grainSize = std::max<size_t>(grainSize, 1);
+    const size_t chunkCount = (end - begin + grainSize - 1) / grainSize;
+    if (chunkCount == 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    // chunks are claimed from a shared counter; helpers arriving late find nothing left
+    struct Shared
+    {
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> doneChunks{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto run = [shared, begin, end, grainSize, chunkCount, &body]() {
+        for (size_t chunk = shared->nextChunk++; chunk < chunkCount; chunk = shared->nextChunk++)
+        {
+            const size_t first = begin + chunk * grainSize;
+            body(first, std::min(first + grainSize, end));
+            if (++shared->doneChunks == chunkCount)
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->done.notify_all();
+            }
+        }
+    };
+
+    const size_t helperCount = std::min(m_Threads.size(), chunkCount - 1);
+    for (size_t i = 0; i < helperCount; ++i)
+    {
+        enqueue(run);
+    }
+    run();
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock, [&]() { return shared->doneChunks == chunkCount; });
+}
+
+ThreadPool &ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
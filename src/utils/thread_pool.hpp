@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of jobs.
+class ThreadPool
+{
+public:
+    // 0 picks one thread per hardware thread, minus the calling one.
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t threadCount() const { return m_Threads.size(); }
+
+    void enqueue(std::function<void()> job);
+
+    template <typename F>
+    auto submit(F &&function) -> std::future<decltype(function())>
+    {
+        using Result = decltype(function());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        auto future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    // Calls body(first, last) on chunks of [begin, end) of at most grainSize items, on the
+    // workers and the calling thread, and returns once every chunk is done. The caller takes
+    // part in the work, so parallelFor can be nested inside jobs without deadlocking.
+    void parallelFor(size_t begin, size_t end, size_t grainSize,
+                     const std::function<void(size_t, size_t)> &body);
+
+    // Shared pool, created on first use.
+    static ThreadPool &global();
+
+private:
+    void work();
+
+    std::vector<std::thread> m_Threads;
+    std::queue<std::function<void()>> m_Jobs;
+    std::mutex m_Mutex;
+    std::condition_variable m_JobAvailable;
+    bool m_bStopping = false;
+};
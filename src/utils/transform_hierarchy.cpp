@@ -0,0 +1,250 @@
+#include "transform_hierarchy.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+// levels with more nodes than this are updated on the thread pool
+const size_t PARALLEL_GRAIN_SIZE = 4 * 1024;
+
+template <typename T> void permute(std::vector<T> &values, const std::vector<uint32_t> &order)
+{
+    std::vector<T> sorted(values.size());
+    for (size_t slot = 0; slot < order.size(); ++slot)
+    {
+        sorted[slot] = values[order[slot]];
+    }
+    values.swap(sorted);
+}
+
+glm::mat4 composeTRS(const glm::vec3 &translation, const glm::quat &rotation,
+                     const glm::vec3 &scale)
+{
+    const glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.f), glm::vec4(r[1] * scale.y, 0.f),
+                     glm::vec4(r[2] * scale.z, 0.f), glm::vec4(translation, 1.f));
+}
+} // namespace
+
+glm::mat4 Transform::matrix() const
+{
+    return composeTRS(translation, rotation, scale);
+}
+
+TransformNode TransformHierarchy::create(TransformNode parent, const Transform &local)
+{
+    if (parent != NO_TRANSFORM_NODE && parent >= m_Slots.size())
+    {
+        std::cerr << "TransformHierarchy: unknown parent " << parent << std::endl;
+        throw std::runtime_error("TransformHierarchy: unknown parent");
+    }
+    const TransformNode node = TransformNode(m_Slots.size());
+    const uint32_t parentSlot = parent == NO_TRANSFORM_NODE ? ~0u : m_Slots[parent];
+    const uint32_t depth = parent == NO_TRANSFORM_NODE ? 0 : m_Depths[parentSlot] + 1;
+    // appended at the end, in order only if no shallower node follows
+    m_bSorted &= m_Depths.empty() || depth >= m_Depths.back();
+    m_Slots.push_back(uint32_t(m_Nodes.size()));
+    m_Nodes.push_back(node);
+    m_Parents.push_back(parentSlot);
+    m_Depths.push_back(depth);
+    m_Translations.push_back(local.translation);
+    m_Rotations.push_back(local.rotation);
+    m_Scales.push_back(local.scale);
+    m_World.emplace_back(1.f);
+    m_Dirty.push_back(1);
+    m_UpdateFrames.push_back(0); // not updated until the next update()
+    m_nFirstDirtyLevel = std::min(m_nFirstDirtyLevel, depth);
+    return node;
+}
+
+void TransformHierarchy::clear()
+{
+    m_Nodes.clear();
+    m_Parents.clear();
+    m_Depths.clear();
+    m_Translations.clear();
+    m_Rotations.clear();
+    m_Scales.clear();
+    m_World.clear();
+    m_Dirty.clear();
+    m_UpdateFrames.clear();
+    m_Slots.clear();
+    m_LevelOffsets.clear();
+    m_bSorted = true;
+    m_nFirstDirtyLevel = ~0u;
+}
+
+void TransformHierarchy::reserve(size_t count)
+{
+    m_Nodes.reserve(count);
+    m_Parents.reserve(count);
+    m_Depths.reserve(count);
+    m_Translations.reserve(count);
+    m_Rotations.reserve(count);
+    m_Scales.reserve(count);
+    m_World.reserve(count);
+    m_Dirty.reserve(count);
+    m_UpdateFrames.reserve(count);
+    m_Slots.reserve(count);
+}
+
+void TransformHierarchy::setLocal(TransformNode node, const Transform &local)
+{
+    const uint32_t slot = m_Slots[node];
+    m_Translations[slot] = local.translation;
+    m_Rotations[slot] = local.rotation;
+    m_Scales[slot] = local.scale;
+    m_Dirty[slot] = 1;
+    m_nFirstDirtyLevel = std::min(m_nFirstDirtyLevel, m_Depths[slot]);
+}
+
+void TransformHierarchy::setTranslation(TransformNode node, const glm::vec3 &translation)
+{
+    const uint32_t slot = m_Slots[node];
+    m_Translations[slot] = translation;
+    m_Dirty[slot] = 1;
+    m_nFirstDirtyLevel = std::min(m_nFirstDirtyLevel, m_Depths[slot]);
+}
+
+void TransformHierarchy::setRotation(TransformNode node, const glm::quat &rotation)
+{
+    const uint32_t slot = m_Slots[node];
+    m_Rotations[slot] = rotation;
+    m_Dirty[slot] = 1;
+    m_nFirstDirtyLevel = std::min(m_nFirstDirtyLevel, m_Depths[slot]);
+}
+
+Transform TransformHierarchy::local(TransformNode node) const
+{
+    const uint32_t slot = m_Slots[node];
+    Transform transform;
+    transform.translation = m_Translations[slot];
+    transform.rotation = m_Rotations[slot];
+    transform.scale = m_Scales[slot];
+    return transform;
+}
+
+TransformNode TransformHierarchy::parent(TransformNode node) const
+{
+    const uint32_t parentSlot = m_Parents[m_Slots[node]];
+    return parentSlot == ~0u ? NO_TRANSFORM_NODE : m_Nodes[parentSlot];
+}
+
+void TransformHierarchy::sortByDepth()
+{
+    // stable counting sort, nodes of one level keep their creation order
+    const uint32_t levels =
+        m_Depths.empty() ? 0 : *std::max_element(begin(m_Depths), end(m_Depths)) + 1;
+    m_LevelOffsets.assign(levels + 1, 0);
+    for (const auto depth : m_Depths)
+    {
+        ++m_LevelOffsets[depth + 1];
+    }
+    for (uint32_t level = 0; level < levels; ++level)
+    {
+        m_LevelOffsets[level + 1] += m_LevelOffsets[level];
+    }
+    if (m_bSorted)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> order(m_Nodes.size());
+    {
+        std::vector<size_t> fill(begin(m_LevelOffsets), end(m_LevelOffsets) - 1);
+        for (uint32_t slot = 0; slot < order.size(); ++slot)
+        {
+            order[fill[m_Depths[slot]]++] = slot;
+        }
+    }
+    std::vector<uint32_t> newSlots(order.size());
+    for (uint32_t slot = 0; slot < order.size(); ++slot)
+    {
+        newSlots[order[slot]] = slot;
+    }
+    for (auto &parentSlot : m_Parents)
+    {
+        parentSlot = parentSlot == ~0u ? ~0u : newSlots[parentSlot];
+    }
+    permute(m_Nodes, order);
+    permute(m_Parents, order);
+    permute(m_Depths, order);
+    permute(m_Translations, order);
+    permute(m_Rotations, order);
+    permute(m_Scales, order);
+    permute(m_World, order);
+    permute(m_Dirty, order);
+    permute(m_UpdateFrames, order);
+    for (uint32_t slot = 0; slot < m_Nodes.size(); ++slot)
+    {
+        m_Slots[m_Nodes[slot]] = slot;
+    }
+    m_bSorted = true;
+}
+
+void TransformHierarchy::updateRange(size_t first, size_t last)
+{
+    for (size_t slot = first; slot < last; ++slot)
+    {
+        const uint32_t parentSlot = m_Parents[slot];
+        // the parent level is done, its flag tells whether its world matrix changed
+        if (!m_Dirty[slot] && (parentSlot == ~0u || !m_Dirty[parentSlot]))
+        {
+            continue;
+        }
+        m_Dirty[slot] = 1;
+        m_UpdateFrames[slot] = m_nFrame;
+        const glm::mat4 local =
+            composeTRS(m_Translations[slot], m_Rotations[slot], m_Scales[slot]);
+        m_World[slot] = parentSlot == ~0u ? local : m_World[parentSlot] * local;
+    }
+}
+
+size_t TransformHierarchy::update(ThreadPool *pool)
+{
+    ++m_nFrame;
+    m_Stats.nodes = m_Nodes.size();
+    m_Stats.updated = 0;
+    if (m_nFirstDirtyLevel == ~0u)
+    {
+        m_Stats.updateMicroseconds = 0.f;
+        return 0;
+    }
+    const auto start = std::chrono::high_resolution_clock::now();
+    if (!m_bSorted || m_LevelOffsets.empty() || m_LevelOffsets.back() != m_Nodes.size())
+    {
+        sortByDepth();
+    }
+    m_Stats.levels = m_LevelOffsets.size() - 1;
+
+    // levels above the first flagged one can't change
+    for (size_t level = m_nFirstDirtyLevel; level + 1 < m_LevelOffsets.size(); ++level)
+    {
+        const size_t levelFirst = m_LevelOffsets[level], levelLast = m_LevelOffsets[level + 1];
+        if (pool && levelLast - levelFirst > PARALLEL_GRAIN_SIZE)
+        {
+            pool->parallelFor(levelFirst, levelLast, PARALLEL_GRAIN_SIZE,
+                              [this](size_t first, size_t last) { updateRange(first, last); });
+        }
+        else
+        {
+            updateRange(levelFirst, levelLast);
+        }
+    }
+
+    const size_t firstSlot = m_LevelOffsets[m_nFirstDirtyLevel];
+    for (size_t slot = firstSlot; slot < m_Nodes.size(); ++slot)
+    {
+        m_Stats.updated += m_Dirty[slot];
+    }
+    std::fill(begin(m_Dirty) + firstSlot, end(m_Dirty), uint8_t(0));
+    m_nFirstDirtyLevel = ~0u;
+    m_Stats.updateMicroseconds = std::chrono::duration<float, std::micro>(
+                                     std::chrono::high_resolution_clock::now() - start)
+                                     .count();
+    return m_Stats.updated;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Stable node identifier, unaffected by the reordering of the hierarchy.
+using TransformNode = uint32_t;
+const TransformNode NO_TRANSFORM_NODE = ~0u;
+
+// Local translation, rotation and scale, applied scale first.
+struct Transform
+{
+    glm::vec3 translation = glm::vec3(0.f);
+    glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+    glm::vec3 scale = glm::vec3(1.f);
+
+    // Built directly from the rotation columns, no matrix product.
+    glm::mat4 matrix() const;
+};
+
+struct TransformHierarchyStats
+{
+    size_t nodes = 0;
+    size_t levels = 0;
+    size_t updated = 0; // world matrices recomputed by the last update
+    float updateMicroseconds = 0.f;
+};
+
+// Parent/child transforms stored as structure of arrays, sorted by depth: parents always
+// come before their children, so one pass over the levels in order computes every world
+// matrix. Setting a local transform flags the node, update() recomputes the world matrices
+// of the flagged nodes and of their descendants only, and returns at once when nothing was
+// flagged. Levels larger than a grain are split across the thread pool, each level is
+// finished before the next one starts.
+class TransformHierarchy
+{
+public:
+    // Parents must exist, nodes are only reordered by the next update.
+    TransformNode create(TransformNode parent = NO_TRANSFORM_NODE,
+                         const Transform &local = Transform());
+    void clear();
+    void reserve(size_t count);
+
+    void setLocal(TransformNode node, const Transform &local);
+    void setTranslation(TransformNode node, const glm::vec3 &translation);
+    void setRotation(TransformNode node, const glm::quat &rotation);
+    Transform local(TransformNode node) const;
+    TransformNode parent(TransformNode node) const;
+
+    // Valid after update().
+    const glm::mat4 &world(TransformNode node) const { return m_World[m_Slots[node]]; }
+    // Whether the last update recomputed the world matrix of node.
+    bool updated(TransformNode node) const { return m_UpdateFrames[m_Slots[node]] == m_nFrame; }
+
+    // Returns the number of world matrices recomputed.
+    size_t update(ThreadPool *pool = nullptr);
+
+    size_t size() const { return m_Nodes.size(); }
+    const TransformHierarchyStats &stats() const { return m_Stats; }
+
+private:
+    void sortByDepth();
+    void updateRange(size_t first, size_t last);
+
+    // per slot, in depth order
+    std::vector<TransformNode> m_Nodes;
+    std::vector<uint32_t> m_Parents; // slot of the parent, ~0u for roots
+    std::vector<uint32_t> m_Depths;
+    std::vector<glm::vec3> m_Translations;
+    std::vector<glm::quat> m_Rotations;
+    std::vector<glm::vec3> m_Scales;
+    std::vector<glm::mat4> m_World;
+    std::vector<uint8_t> m_Dirty;
+    std::vector<uint32_t> m_UpdateFrames;
+
+    std::vector<uint32_t> m_Slots;        // per node
+    std::vector<size_t> m_LevelOffsets;   // first slot of each depth, plus the end
+    bool m_bSorted = true;
+    uint32_t m_nFirstDirtyLevel = ~0u;
+    uint32_t m_nFrame = 1; // frame 0 is never updated, new nodes are stamped with it
+    TransformHierarchyStats m_Stats;
+};
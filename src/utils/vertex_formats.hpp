@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mesh_builder.hpp"
+#include "vertex_layout.hpp"
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// GPU vertex formats of Mesh. Attribute locations: 0 position, 1 texture coordinates, 2 normal.
+enum class VertexFormat
+{
+    Float,  // Vertex as is, 32 bytes
+    Compact // CompactVertex, 16 bytes
+};
+
+template <>
+struct VertexLayoutOf<Vertex>
+{
+    static constexpr VertexLayout value = makeVertexLayout<Vertex>(
+        {VERTEX_ATTRIBUTE(Vertex, position, 0), VERTEX_ATTRIBUTE(Vertex, texCoord, 1),
+         VERTEX_ATTRIBUTE(Vertex, normal, 2)});
+};
+
+inline Half3 packHalf3(const glm::vec3 &v)
+{
+    const auto xy = glm::packHalf2x16(glm::vec2(v));
+    return Half3{uint16_t(xy & 0xFFFF), uint16_t(xy >> 16), uint16_t(glm::packHalf1x16(v.z)), 0};
+}
+
+// Octahedral normal encoding. The shader unfolds it with:
+//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+//   n = normalize(n);
+inline OctSnorm16 packOctSnorm16(const glm::vec3 &n)
+{
+    glm::vec2 e = glm::vec2(n) / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    if (n.z < 0.f)
+    {
+        const glm::vec2 sign(e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f);
+        e = (1.f - glm::abs(glm::vec2(e.y, e.x))) * sign;
+    }
+    const auto bits = glm::packSnorm2x16(e);
+    return OctSnorm16{int16_t(bits & 0xFFFF), int16_t(bits >> 16)};
+}
+
+inline glm::vec3 unpackOctSnorm16(const OctSnorm16 &packed)
+{
+    const glm::vec2 e = glm::max(glm::vec2(packed.x, packed.y) / 32767.f, glm::vec2(-1.f));
+    glm::vec3 n(e, 1.f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.f)
+    {
+        const glm::vec2 sign(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+        const glm::vec2 xy = (1.f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+        n.x = xy.x;
+        n.y = xy.y;
+    }
+    return glm::normalize(n);
+}
+
+inline Unorm16x2 packUnorm16x2(const glm::vec2 &v)
+{
+    const auto bits = glm::packUnorm2x16(v);
+    return Unorm16x2{uint16_t(bits & 0xFFFF), uint16_t(bits >> 16)};
+}
+
+inline Snorm10x3 packSnorm10x3(const glm::vec3 &v, float w = 1.f)
+{
+    return Snorm10x3{glm::packSnorm3x10_1x2(glm::vec4(v, w))};
+}
+
+// Half float positions keep about 3 significant digits: fine for unit sized meshes placed by
+// their model matrix, not for large meshes in world space.
+struct CompactVertex
+{
+    Half3 position;
+    Unorm16x2 texCoord; // clamped to [0, 1]
+    OctSnorm16 normal;
+
+    static CompactVertex encode(const Vertex &vertex)
+    {
+        return CompactVertex{packHalf3(vertex.position), packUnorm16x2(vertex.texCoord),
+                             packOctSnorm16(vertex.normal)};
+    }
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex isn't tightly packed");
+
+template <>
+struct VertexLayoutOf<CompactVertex>
+{
+    static constexpr VertexLayout value = makeVertexLayout<CompactVertex>(
+        {VERTEX_ATTRIBUTE(CompactVertex, position, 0),
+         VERTEX_ATTRIBUTE(CompactVertex, texCoord, 1), VERTEX_ATTRIBUTE(CompactVertex, normal, 2)});
+};
+
+template <typename V>
+std::vector<V> encodeVertices(const std::vector<Vertex> &vertices)
+{
+    std::vector<V> encoded;
+    encoded.reserve(vertices.size());
+    for (const auto &vertex : vertices)
+    {
+        encoded.push_back(V::encode(vertex));
+    }
+    return encoded;
+}
+
+// Stride of the vertex buffer of a Mesh in format.
+inline size_t vertexFormatSize(VertexFormat format)
+{
+    return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
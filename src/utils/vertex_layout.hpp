@@ -0,0 +1,171 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// Declarative vertex attribute setup. A vertex struct describes its members once:
+//
+//   template <> struct VertexLayoutOf<MyVertex>
+//   {
+//       static constexpr VertexLayout value = makeVertexLayout<MyVertex>({
+//           VERTEX_ATTRIBUTE(MyVertex, position, 0), VERTEX_ATTRIBUTE(MyVertex, uv, 1)});
+//   };
+//   constexpr VertexLayout VertexLayoutOf<MyVertex>::value; // in one .cpp, for C++14
+//
+// The GL format of each member comes from VertexAttributeTraits of its C++ type and the
+// layout is checked against the struct at compile time; applyVertexLayout<MyVertex>()
+// then issues the glVertexArrayAttrib* calls.
+
+// Compact attribute types, see vertex_formats.hpp for the vertices using them.
+
+// Three half floats, padded to 8 bytes so the next attribute stays 4 byte aligned.
+struct Half3
+{
+    uint16_t x, y, z, padding;
+};
+
+// Unit vector folded on an octahedron, two snorm16. The shader receives the folded
+// vec2 and has to unfold it (see vertex_formats.hpp).
+struct OctSnorm16
+{
+    int16_t x, y;
+};
+
+// Two unorm16, for texture coordinates inside [0, 1].
+struct Unorm16x2
+{
+    uint16_t x, y;
+};
+
+// GL_INT_2_10_10_10_REV: xyz on snorm10, w on snorm2 (a tangent with its bitangent sign).
+struct Snorm10x3
+{
+    uint32_t bits;
+};
+
+template <GLint Components, GLenum Type, GLboolean Normalized, bool Integer, GLuint Locations = 1>
+struct VertexAttributeFormat
+{
+    static constexpr GLint components = Components;
+    static constexpr GLenum type = Type;
+    static constexpr GLboolean normalized = Normalized;
+    static constexpr bool integer = Integer; // read as ivec/uvec in the shader
+    static constexpr GLuint locations = Locations; // matrices take one location per column
+};
+
+template <typename T>
+struct VertexAttributeTraits;
+
+template <> struct VertexAttributeTraits<float> : VertexAttributeFormat<1, GL_FLOAT, GL_FALSE, false> {};
+template <> struct VertexAttributeTraits<glm::vec2> : VertexAttributeFormat<2, GL_FLOAT, GL_FALSE, false> {};
+template <> struct VertexAttributeTraits<glm::vec3> : VertexAttributeFormat<3, GL_FLOAT, GL_FALSE, false> {};
+template <> struct VertexAttributeTraits<glm::vec4> : VertexAttributeFormat<4, GL_FLOAT, GL_FALSE, false> {};
+template <> struct VertexAttributeTraits<glm::mat4> : VertexAttributeFormat<4, GL_FLOAT, GL_FALSE, false, 4> {};
+template <> struct VertexAttributeTraits<uint32_t> : VertexAttributeFormat<1, GL_UNSIGNED_INT, GL_FALSE, true> {};
+template <> struct VertexAttributeTraits<glm::uvec4> : VertexAttributeFormat<4, GL_UNSIGNED_INT, GL_FALSE, true> {};
+template <> struct VertexAttributeTraits<Half3> : VertexAttributeFormat<3, GL_HALF_FLOAT, GL_FALSE, false> {};
+template <> struct VertexAttributeTraits<OctSnorm16> : VertexAttributeFormat<2, GL_SHORT, GL_TRUE, false> {};
+template <> struct VertexAttributeTraits<Unorm16x2> : VertexAttributeFormat<2, GL_UNSIGNED_SHORT, GL_TRUE, false> {};
+template <> struct VertexAttributeTraits<Snorm10x3> : VertexAttributeFormat<4, GL_INT_2_10_10_10_REV, GL_TRUE, false> {};
+
+struct VertexAttribute
+{
+    GLuint location;
+    GLuint locationCount;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;
+    GLuint offset;
+    GLuint size;
+};
+
+template <typename T>
+constexpr VertexAttribute vertexAttribute(GLuint location, size_t offset)
+{
+    using Traits = VertexAttributeTraits<T>;
+    return VertexAttribute{location,         Traits::locations, Traits::components,
+                           Traits::type,     Traits::normalized, Traits::integer,
+                           GLuint(offset),   GLuint(sizeof(T))};
+}
+
+#define VERTEX_ATTRIBUTE(Struct, member, location)                                              \
+    vertexAttribute<decltype(Struct::member)>(location, offsetof(Struct, member))
+
+const size_t MAX_VERTEX_ATTRIBUTES = 16;
+
+struct VertexLayout
+{
+    // a plain array, std::array can't be written in a C++14 constexpr function
+    VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+    size_t count;
+    GLuint stride;
+};
+
+// Throws when a member overflows the struct or two attributes share a location, which
+// fails compilation when evaluated as a constant expression.
+template <typename V, size_t N>
+constexpr VertexLayout makeVertexLayout(const VertexAttribute (&attributes)[N])
+{
+    static_assert(N <= MAX_VERTEX_ATTRIBUTES, "Too many vertex attributes");
+    VertexLayout layout = {};
+    layout.count = N;
+    layout.stride = GLuint(sizeof(V));
+    uint32_t usedLocations = 0;
+    for (size_t i = 0; i < N; ++i)
+    {
+        const auto &attribute = attributes[i];
+        if (attribute.offset + attribute.size > sizeof(V))
+        {
+            throw std::logic_error("Vertex attribute outside of the vertex");
+        }
+        const uint32_t locations = ((1u << attribute.locationCount) - 1) << attribute.location;
+        if (attribute.location + attribute.locationCount > 32 || usedLocations & locations)
+        {
+            throw std::logic_error("Vertex attribute locations overlap");
+        }
+        usedLocations |= locations;
+        layout.attributes[i] = attribute;
+    }
+    return layout;
+}
+
+template <typename V>
+struct VertexLayoutOf;
+
+// Sets the formats of the layout attributes, reading them from the given buffer binding.
+inline void applyVertexLayout(GLuint vao, GLuint binding, const VertexLayout &layout)
+{
+    for (size_t i = 0; i < layout.count; ++i)
+    {
+        const auto &attribute = layout.attributes[i];
+        const GLuint columnSize = attribute.size / attribute.locationCount;
+        for (GLuint column = 0; column < attribute.locationCount; ++column)
+        {
+            const GLuint location = attribute.location + column;
+            const GLuint offset = attribute.offset + column * columnSize;
+            if (attribute.integer)
+            {
+                glVertexArrayAttribIFormat(vao, location, attribute.components, attribute.type,
+                                           offset);
+            }
+            else
+            {
+                glVertexArrayAttribFormat(vao, location, attribute.components, attribute.type,
+                                          attribute.normalized, offset);
+            }
+            glVertexArrayAttribBinding(vao, location, binding);
+            glEnableVertexArrayAttrib(vao, location);
+        }
+    }
+}
+
+template <typename V>
+void applyVertexLayout(GLuint vao, GLuint binding)
+{
+    applyVertexLayout(vao, binding, VertexLayoutOf<V>::value);
+}
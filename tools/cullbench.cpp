@@ -0,0 +1,282 @@
+// Frustum culling benchmark: culls 1M random boxes with the SIMD and the scalar paths
+// and reports the time per object, then occlusion culls the visible boxes against the
+// closest ones, on one thread and on the thread pool. Last, 100k cubes bounce in a box and
+// the loose grid's update and query costs are compared to brute force and to a BVH refit.
+
+#include "utils/bvh.hpp"
+#include "utils/frustum.hpp"
+#include "utils/occlusion_culler.hpp"
+#include "utils/spatial_grid.hpp"
+#include "utils/thread_pool.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+template <typename Cull>
+static double nsPerObject(const Cull &cull, size_t objectCount, int runs)
+{
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        cull();
+        const auto ns = std::chrono::duration<double, std::nano>(
+                            std::chrono::high_resolution_clock::now() - start)
+                            .count();
+        best = std::min(best, ns);
+    }
+    return best / double(objectCount);
+}
+
+template <typename F> static double microseconds(const F &function)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    function();
+    return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() -
+                                                     start)
+        .count();
+}
+
+static float squaredDistance(const AABB &box, const glm::vec3 &point)
+{
+    const glm::vec3 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.f));
+    return glm::dot(d, d);
+}
+
+static int benchmarkMovingObjects(size_t objectCount)
+{
+    const int frames = 30, queries = 64;
+    const float dt = 1.f / 60.f, halfSize = 250.f;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-halfSize, halfSize);
+    std::uniform_real_distribution<float> velocity(-20.f, 20.f);
+    std::uniform_real_distribution<float> size(.5f, 2.f);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    std::vector<glm::vec3> velocities(objectCount), extents(objectCount);
+    std::vector<AABB> boxes(objectCount);
+    SpatialGrid grid(32.f);
+    std::vector<uint32_t> ids(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const glm::vec3 center(position(random), position(random), position(random));
+        extents[i] = glm::vec3(size(random));
+        velocities[i] = glm::vec3(velocity(random), velocity(random), velocity(random));
+        boxes[i] = AABB(center - extents[i], center + extents[i]);
+        ids[i] = grid.insert(boxes[i]);
+    }
+    BVH bvh;
+    bvh.build(boxes);
+
+    const auto projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 400.f);
+    std::vector<uint32_t> gridResult, bruteResult, bvhResult;
+    double gridUpdate = 0., bvhRefit = 0., gridFrustum = 0., bruteFrustum = 0., bvhFrustum = 0.;
+    double gridSphere = 0., bruteSphere = 0., gridRay = 0., bruteRay = 0.;
+    size_t visible = 0, sphereHits = 0, rayHits = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        // bounce off the walls of the box
+        for (size_t i = 0; i < objectCount; ++i)
+        {
+            glm::vec3 center = boxes[i].center() + velocities[i] * dt;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float limit = halfSize - extents[i][axis];
+                if (std::abs(center[axis]) > limit)
+                {
+                    center[axis] = glm::clamp(center[axis], -limit, limit);
+                    velocities[i][axis] = -velocities[i][axis];
+                }
+            }
+            boxes[i] = AABB(center - extents[i], center + extents[i]);
+        }
+        gridUpdate += microseconds([&] {
+            for (size_t i = 0; i < objectCount; ++i)
+            {
+                grid.move(ids[i], boxes[i]);
+            }
+        });
+        bvhRefit += microseconds([&] { bvh.refit(boxes); });
+
+        const float angle = float(frame) * .1f;
+        const auto view = glm::lookAt(glm::vec3(0.f), glm::vec3(std::sin(angle), .1f, -std::cos(angle)),
+                                      glm::vec3(0.f, 1.f, 0.f));
+        const auto frustum = extractFrustum(projection * view);
+        gridFrustum += microseconds([&] { grid.queryFrustum(frustum, gridResult); });
+        bruteFrustum += microseconds([&] {
+            bruteResult.clear();
+            for (size_t i = 0; i < objectCount; ++i)
+            {
+                if (intersects(frustum, boxes[i]))
+                {
+                    bruteResult.push_back(uint32_t(i));
+                }
+            }
+        });
+        bvhFrustum += microseconds([&] { bvh.cull(frustum, bvhResult); });
+        // identifiers equal the indices, nothing was removed
+        std::sort(begin(gridResult), end(gridResult));
+        if (gridResult != bruteResult)
+        {
+            std::cerr << "grid and brute force frustum queries disagree" << std::endl;
+            return 1;
+        }
+        visible += bruteResult.size();
+
+        for (int query = 0; query < queries; ++query)
+        {
+            const glm::vec3 center(position(random), position(random), position(random));
+            const float radius = 10.f;
+            gridSphere += microseconds([&] { grid.querySphere(center, radius, gridResult); });
+            bruteSphere += microseconds([&] {
+                bruteResult.clear();
+                for (size_t i = 0; i < objectCount; ++i)
+                {
+                    if (squaredDistance(boxes[i], center) <= radius * radius)
+                    {
+                        bruteResult.push_back(uint32_t(i));
+                    }
+                }
+            });
+            std::sort(begin(gridResult), end(gridResult));
+            if (gridResult != bruteResult)
+            {
+                std::cerr << "grid and brute force sphere queries disagree" << std::endl;
+                return 1;
+            }
+            sphereHits += bruteResult.size();
+
+            Ray ray;
+            ray.origin = center;
+            ray.direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)));
+            RayHit gridHit, bruteHit;
+            gridRay += microseconds([&] { grid.raycast(ray, gridHit); });
+            bruteRay += microseconds([&] {
+                const glm::vec3 inverseDirection = 1.f / ray.direction;
+                for (size_t i = 0; i < objectCount; ++i)
+                {
+                    const float t = intersectRayAABB(ray.origin, inverseDirection, boxes[i].min,
+                                                     boxes[i].max, bruteHit.t);
+                    if (t >= 0.f && t < bruteHit.t)
+                    {
+                        bruteHit.object = uint32_t(i);
+                        bruteHit.t = t;
+                    }
+                }
+            });
+            if (gridHit.t != bruteHit.t)
+            {
+                std::cerr << "grid and brute force ray casts disagree" << std::endl;
+                return 1;
+            }
+            rayHits += bruteHit.object != ~0u;
+        }
+    }
+
+    const double rayCount = double(frames) * queries;
+    std::cout << objectCount << " moving cubes, " << grid.cellCount() << " cells, "
+              << visible / frames << " visible\n";
+    std::cout << "update: grid " << gridUpdate / frames << " us, BVH refit " << bvhRefit / frames
+              << " us\n";
+    std::cout << "frustum: grid " << gridFrustum / frames << " us, brute force "
+              << bruteFrustum / frames << " us, refitted BVH " << bvhFrustum / frames << " us\n";
+    std::cout << "sphere (" << sphereHits / rayCount << " hits): grid " << gridSphere / rayCount
+              << " us, brute force " << bruteSphere / rayCount << " us\n";
+    std::cout << "ray (" << rayHits << " / " << rayCount << " hit): grid " << gridRay / rayCount
+              << " us, brute force " << bruteRay / rayCount << " us" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t objectCount = argc > 1 ? size_t(std::atoll(argv[1])) : 1000000;
+    const size_t movingCount = argc > 2 ? size_t(std::atoll(argv[2])) : 100000;
+    const int runs = 20;
+
+    // fixed seed, every run culls the same scene
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-500.f, 500.f);
+    std::uniform_real_distribution<float> size(.5f, 5.f);
+    AABBSoA boxes;
+    boxes.reserve(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const glm::vec3 center(position(random), position(random), position(random));
+        const glm::vec3 extent(size(random), size(random), size(random));
+        boxes.push(AABB(center - extent, center + extent));
+    }
+
+    const auto projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 400.f);
+    const auto view = glm::lookAt(glm::vec3(0.f), glm::vec3(1.f, .2f, -1.f), glm::vec3(0, 1, 0));
+    const auto frustum = extractFrustum(projection * view);
+
+    std::vector<uint32_t> simdVisible, scalarVisible;
+    simdVisible.reserve(objectCount);
+    scalarVisible.reserve(objectCount);
+    const double simdNs =
+        nsPerObject([&] { cullAABBs(frustum, boxes, simdVisible); }, objectCount, runs);
+    const double scalarNs =
+        nsPerObject([&] { cullAABBsScalar(frustum, boxes, scalarVisible); }, objectCount, runs);
+
+    std::cout << objectCount << " boxes, " << simdVisible.size() << " visible\n";
+    std::cout << cullingInstructionSet() << ": " << simdNs << " ns/object\n";
+    std::cout << "scalar: " << scalarNs << " ns/object (x" << scalarNs / simdNs << ")"
+              << std::endl;
+    if (simdVisible != scalarVisible)
+    {
+        std::cerr << "SIMD and scalar culling disagree" << std::endl;
+        return 1;
+    }
+
+    std::vector<AABB> worldBoxes(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const glm::vec3 center(boxes.centerX()[i], boxes.centerY()[i], boxes.centerZ()[i]);
+        const glm::vec3 extent(boxes.extentX()[i], boxes.extentY()[i], boxes.extentZ()[i]);
+        worldBoxes[i] = AABB(center - extent, center + extent);
+    }
+    std::vector<std::pair<float, uint32_t>> candidates;
+    for (const auto i : simdVisible)
+    {
+        candidates.emplace_back(glm::length(worldBoxes[i].center()), i);
+    }
+    const size_t occluderCount = std::min<size_t>(candidates.size(), 256);
+    std::nth_element(begin(candidates), begin(candidates) + occluderCount, end(candidates));
+    const auto unitBox = makeBoxOccluder(AABB(glm::vec3(-1.f), glm::vec3(1.f)));
+    std::vector<glm::mat4> occluderTransforms;
+    for (size_t i = 0; i < occluderCount; ++i)
+    {
+        const auto &box = worldBoxes[candidates[i].second];
+        occluderTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.f), box.center()),
+                                                box.extent()));
+    }
+
+    OcclusionCuller culler;
+    std::vector<uint32_t> occlusionVisible;
+    for (ThreadPool *pool : {static_cast<ThreadPool *>(nullptr), &ThreadPool::global()})
+    {
+        float rasterize = 1e30f, test = 1e30f;
+        for (int run = 0; run < runs; ++run)
+        {
+            culler.beginFrame(projection * view);
+            for (const auto &transform : occluderTransforms)
+            {
+                culler.addOccluder(unitBox, transform);
+            }
+            culler.rasterize(pool);
+            occlusionVisible = simdVisible;
+            culler.cull(worldBoxes, occlusionVisible, pool);
+            rasterize = std::min(rasterize, culler.stats().rasterizeMicroseconds);
+            test = std::min(test, culler.stats().testMicroseconds);
+        }
+        std::cout << "occlusion (" << (pool ? pool->threadCount() + 1 : 1) << " threads): "
+                  << culler.stats().triangles << " occluder triangles in " << rasterize
+                  << " us, " << culler.stats().occluded << " / " << culler.stats().tested
+                  << " occluded in " << test << " us" << std::endl;
+    }
+    return benchmarkMovingObjects(movingCount);
+}
@@ -0,0 +1,71 @@
+// Offline mesh optimizer: welds an OBJ (or re-optimizes a .mesh), runs the vertex cache,
+// overdraw and vertex fetch optimizations, generates the LOD chain and writes the binary
+// mesh loaded by the app.
+
+#include "utils/mesh_io.hpp"
+#include "utils/mesh_optimizer.hpp"
+#include "utils/mesh_simplifier.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static bool hasExtension(const std::string &path, const std::string &extension)
+{
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+static void printReport(const MeshData &mesh, const MeshOptimizationReport &report)
+{
+    std::cout << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles\n";
+    std::cout << "ACMR      " << report.cacheBefore.acmr << " -> " << report.cacheAfter.acmr << "\n";
+    std::cout << "ATVR      " << report.cacheBefore.atvr << " -> " << report.cacheAfter.atvr << "\n";
+    std::cout << "overfetch " << report.fetchBefore.overfetch << " -> "
+              << report.fetchAfter.overfetch << "\n";
+    std::cout << "overdraw  " << report.overdrawClusters << " clusters" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " input.obj|input.mesh [output.mesh]" << std::endl;
+        return 1;
+    }
+    const std::string input = argv[1];
+    std::string output = argc > 2 ? argv[2] : input.substr(0, input.find_last_of('.')) + ".mesh";
+    if (output == input)
+    {
+        output += ".opt";
+    }
+
+    try
+    {
+        size_t inputVertices = 0;
+        MeshData mesh = hasExtension(input, ".mesh") ? loadMeshBinary(input)
+                                                     : loadObjMesh(input, &inputVertices);
+        if (inputVertices)
+        {
+            std::cout << "welded " << inputVertices << " corners\n";
+        }
+        const auto report = optimizeMesh(mesh);
+        printReport(mesh, report);
+        const auto lods = generateLODChain(mesh);
+        for (size_t i = 0; i < lods.size(); ++i)
+        {
+            std::cout << "LOD " << i + 1 << ": " << lods[i].indices.size() / 3
+                      << " triangles, error " << lods[i].error << "\n";
+        }
+        saveMeshBinary(output, mesh, lods);
+        std::cout << "wrote " << output << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        // the repo's own errors are reported twice, parsing, allocation and filesystem ones
+        // only here
+        std::cerr << input << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
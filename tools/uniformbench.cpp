@@ -0,0 +1,156 @@
+// Uniform submission benchmark: sets the per draw uniforms of the app's cube program for 10k
+// objects a frame, once looking every location up with glGetUniformLocation and calling
+// glUniform*, once through the program's reflected handles and shadow copies, and reports
+// the CPU time per frame and per object of each path. Needs an OpenGL 4.6 context, the
+// window stays hidden.
+
+#include "utils/glfw.hpp"
+#include "utils/shaders.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+static const char *VERTEX_SHADER = R"(#version 460
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec2 aTexCoord;
+uniform mat4 model;
+out vec2 vTexCoord;
+void main()
+{
+    vTexCoord = aTexCoord;
+    gl_Position = model * vec4(aPosition, 1.0);
+}
+)";
+
+static const char *FRAGMENT_SHADER = R"(#version 460
+in vec2 vTexCoord;
+uniform sampler2D texture1;
+uniform sampler2D texture2;
+uniform float mixParam;
+out vec4 fColor;
+void main()
+{
+    fColor = mix(texture(texture1, vTexCoord), texture(texture2, vTexCoord), mixParam);
+}
+)";
+
+// best of runs, the first one warms the driver's caches up
+template <typename F> static double bestMicroseconds(const F &frame, int runs)
+{
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run)
+    {
+        // the GPU work of the previous run isn't timed
+        glFinish();
+        const auto start = std::chrono::high_resolution_clock::now();
+        frame();
+        best = std::min(best, std::chrono::duration<double, std::micro>(
+                                  std::chrono::high_resolution_clock::now() - start)
+                                  .count());
+    }
+    return best;
+}
+
+int main()
+{
+    if (!glfwInit())
+    {
+        std::cerr << "Unable to init GLFW." << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "uniformbench", nullptr, nullptr);
+    if (!window)
+    {
+        std::cerr << "Unable to create an OpenGL 4.6 context." << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL())
+    {
+        std::cerr << "Unable to init OpenGL." << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+
+    int result = 0;
+    try
+    {
+        const size_t objectCount = 10000;
+        const int runs = 20;
+        GLProgram program = buildProgram(VERTEX_SHADER, FRAGMENT_SHADER);
+        program.use();
+
+        // every object moves each frame, the samplers and the mix factor don't
+        std::vector<glm::mat4> models(objectCount);
+        for (size_t i = 0; i < objectCount; ++i)
+        {
+            const glm::vec3 position(float(i % 100), float(i / 100), 0.f);
+            models[i] = glm::translate(glm::mat4(1.f), position);
+        }
+        const float mixValue = .2f;
+        const char *textureNames[] = {"texture1", "texture2"};
+
+        // the app's submission before the reflected uniform table
+        const auto lookupFrame = [&]() {
+            for (const auto &model : models)
+            {
+                for (GLint unit = 0; unit < 2; ++unit)
+                {
+                    glUniform1i(glGetUniformLocation(program.glId(), textureNames[unit]), unit);
+                }
+                glUniform1f(glGetUniformLocation(program.glId(), "mixParam"), mixValue);
+                glUniformMatrix4fv(glGetUniformLocation(program.glId(), "model"), 1, GL_FALSE,
+                                   glm::value_ptr(model));
+            }
+        };
+
+        // handles resolved once, unchanged values filtered by the shadow copies
+        const GLUniformHandle uTextures[] = {program.getUniformHandle("texture1"),
+                                             program.getUniformHandle("texture2")};
+        const auto uMixParam = program.getUniformHandle("mixParam");
+        const auto uModel = program.getUniformHandle("model");
+        const auto reflectedFrame = [&]() {
+            for (const auto &model : models)
+            {
+                for (GLint unit = 0; unit < 2; ++unit)
+                {
+                    program.setUniform(uTextures[unit], unit);
+                }
+                program.setUniform(uMixParam, mixValue);
+                program.setUniform(uModel, model);
+            }
+        };
+
+        const double lookup = bestMicroseconds(lookupFrame, runs);
+        program.invalidateUniformShadow();
+        program.resetUniformCallCounters();
+        const double reflected = bestMicroseconds(reflectedFrame, runs);
+
+        std::cout << objectCount << " objects, 4 uniforms each, best of " << runs << " frames\n";
+        std::cout << "glGetUniformLocation + glUniform*: " << lookup / 1000. << " ms/frame, "
+                  << 1000. * lookup / objectCount << " ns/object\n";
+        std::cout << "reflected handles + shadow:        " << reflected / 1000. << " ms/frame, "
+                  << 1000. * reflected / objectCount << " ns/object\n";
+        std::cout << "speedup: " << lookup / reflected << "x, glUniform calls issued "
+                  << program.getUniformCallsIssued() << ", skipped "
+                  << program.getUniformCallsSkipped() << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        result = 1;
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}